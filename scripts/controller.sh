@@ -87,7 +87,7 @@ compile_BSEtokens() {
 # Compile ws.cpp
 compile_ws() {
     log_json "Compiling ws.cpp..."
-    g++ -I/usr/local/include/websocketpp -I/usr/local/include -I/usr/include/librdkafka -o "$BIN_DIR/ws" "$SRC_DIR/Websocket/ws.cpp" -std=c++17 -lboost_system -lboost_thread -lssl -lcrypto -lpthread -lrdkafka++
+    g++ -I/usr/local/include/websocketpp -I/usr/local/include -I/usr/include/librdkafka -o "$BIN_DIR/ws" "$SRC_DIR/Websocket/ws.cpp" -std=c++17 -O2 -lboost_system -lboost_thread -lssl -lcrypto -lpthread -lrt -lrdkafka++ -lcurl
     if [ $? -eq 0 ]; then
         log_json "ws.cpp compiled successfully."
     else
@@ -96,6 +96,18 @@ compile_ws() {
     fi
 }
 
+# Compile mock_stream.cpp (local SmartStream stand-in for load tests)
+compile_mock_stream() {
+    log_json "Compiling mock_stream.cpp..."
+    g++ -I/usr/local/include/websocketpp -I/usr/local/include -o "$BIN_DIR/mock_stream" "$SRC_DIR/MockStream/mock_stream.cpp" -std=c++17 -O2 -lboost_system -lssl -lcrypto -lpthread
+    if [ $? -eq 0 ]; then
+        log_json "mock_stream.cpp compiled successfully."
+    else
+        log_json "Failed to compile mock_stream.cpp."
+        return 1
+    fi
+}
+
 # Compile all source files
 compile_all() {
     log_json "Starting compilation of all source files..."
@@ -107,6 +119,9 @@ compile_all() {
 
     compile_ws
     log_json "Finished compiling ws.cpp"
+
+    compile_mock_stream
+    log_json "Finished compiling mock_stream.cpp"
 }
 
 # Run all compiled programs
@@ -0,0 +1,521 @@
+#pragma once
+
+// Session token lifecycle for the AngelOne APIs.
+//
+// A login (loginByPassword with a fresh TOTP) returns a JWT, a refresh token
+// and a feed token. The JWT's exp claim says how long it lasts, so a process
+// starting while the saved JWT still has more than refreshMarginS left
+// reuses it, after one getProfile call confirms the server still accepts it.
+// Inside the margin, or once the server rejects it, the refresh token buys a
+// new JWT through generateTokens; a full login is the last resort. Restarts
+// therefore cost at most one round trip and never reuse a TOTP window.
+//
+// Every change is written to the token file through a temporary and a
+// rename, so bin/ws never reads a half-written file, and the file is only
+// readable by its owner. The temporary is unique to each write and created
+// owner-only, so bin/auth and a refreshing bin/ws never share one and no
+// other user can open it in between. A long-running process can start() a thread that
+// refreshes before expiry and hands the new tokens to a callback.
+//
+// All URLs are relative to baseUrl, which can point at a local stand-in.
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <curl/curl.h>
+#include <nlohmann/json.hpp>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Base32 decoding function
+inline std::string base32Decode(const std::string& encoded) {
+    std::string decoded;
+    std::map<char, int> base32Lookup;
+    static const std::string BASE32_ALPHABET = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+
+    for (int i = 0; i < 32; ++i) {
+        base32Lookup[BASE32_ALPHABET[i]] = i;
+    }
+
+    int buffer = 0, bitsLeft = 0;
+    for (char c : encoded) {
+        if (c == '=') break;
+        buffer <<= 5;
+        buffer |= base32Lookup[c];
+        bitsLeft += 5;
+        if (bitsLeft >= 8) {
+            decoded += static_cast<char>((buffer >> (bitsLeft - 8)) & 0xFF);
+            bitsLeft -= 8;
+        }
+    }
+    return decoded;
+}
+
+// Convert integer to big-endian 8-byte array
+inline std::vector<unsigned char> intToBytes(uint64_t value) {
+    std::vector<unsigned char> bytes(8);
+    for (int i = 7; i >= 0; --i) {
+        bytes[i] = value & 0xFF;
+        value >>= 8;
+    }
+    return bytes;
+}
+
+// TOTP generation function
+inline std::string generateTOTP(const std::string& secret) {
+    uint64_t timeCounter = std::time(nullptr) / 30;
+    std::vector<unsigned char> timeBytes = intToBytes(timeCounter);
+
+    unsigned char* result = HMAC(EVP_sha1(), secret.c_str(), secret.length(), timeBytes.data(), timeBytes.size(), nullptr, nullptr);
+
+    if (!result) {
+        return "";
+    }
+
+    int offset = result[19] & 0xf;
+    uint32_t binaryCode = (result[offset] & 0x7f) << 24 |
+                          (result[offset + 1] & 0xff) << 16 |
+                          (result[offset + 2] & 0xff) << 8 |
+                          (result[offset + 3] & 0xff);
+
+    uint32_t totp = binaryCode % static_cast<uint32_t>(pow(10, 6));
+    std::ostringstream totpStream;
+    totpStream << std::setw(6) << std::setfill('0') << totp;
+
+    return totpStream.str();
+}
+
+struct AuthSettings {
+    std::string baseUrl = "https://apiconnect.angelone.in";
+    std::string tokenFile = "config/AuthTokens.ini";
+    int refreshMarginS = 3600;  // Refresh once the JWT has less than this left
+    int retryS = 60;            // Wait after a failed background refresh
+    long timeoutMs = 10000;
+};
+
+struct SessionTokens {
+    std::string jwtToken;   // As the server returned it, possibly with "Bearer "; see stripBearer()
+    std::string refreshToken;
+    std::string feedToken;
+    int64_t expiresAt = 0;  // JWT exp claim, Unix seconds; 0 if it has none
+};
+
+class TokenManager {
+public:
+    typedef std::function<void(const SessionTokens& tokens)> RenewCallback;
+
+    // credentials: Credentials.env (clientcode, password, base32Secret, API_KEY)
+    TokenManager(const AuthSettings& settings, const std::map<std::string, std::string>& credentials)
+        : settings_(settings), credentials_(credentials) {
+        while (!settings_.baseUrl.empty() && settings_.baseUrl.back() == '/') {
+            settings_.baseUrl.pop_back();
+        }
+    }
+
+    ~TokenManager() {
+        stop();
+    }
+
+    // Leaves usable tokens in memory and in the token file: the saved JWT if
+    // it has more than the margin left and the server accepts it, else a
+    // refreshed one, else a new login. lastAction() says which.
+    bool ensureValid(std::string& error) {
+        SessionTokens saved = readTokenFile(settings_.tokenFile);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tokens_ = saved;
+        }
+        if (!saved.jwtToken.empty() && remainingS(saved) > settings_.refreshMarginS && validate(saved, error)) {
+            lastAction_ = "reused";
+            return true;
+        }
+        if (!saved.refreshToken.empty() && refresh(error)) {
+            error.clear();
+            return true;
+        }
+        if (login(error)) {
+            error.clear();
+            return true;
+        }
+        return false;
+    }
+
+    // generateTokens with the current refresh token
+    bool refresh(std::string& error) {
+        SessionTokens current = tokens();
+        nlohmann::json payload = {{"refreshToken", current.refreshToken}};
+        if (!renew("/rest/auth/angelbroking/jwt/v1/generateTokens", payload.dump(), current.jwtToken, "refreshed", error)) {
+            error = "refresh failed: " + error;
+            return false;
+        }
+        return true;
+    }
+
+    // loginByPassword with a TOTP for the current 30 s window
+    bool login(std::string& error) {
+        std::string totp = generateTOTP(base32Decode(credential("base32Secret")));
+        if (totp.empty()) {
+            error = "failed to generate TOTP";
+            return false;
+        }
+        nlohmann::json payload = {
+            {"clientcode", credential("clientcode")},
+            {"password", credential("password")},
+            {"totp", totp},
+            {"state", "Prod"}
+        };
+        if (!renew("/rest/auth/angelbroking/user/v1/loginByPassword", payload.dump(), "", "logged in", error)) {
+            error = "login failed: " + error;
+            return false;
+        }
+        return true;
+    }
+
+    SessionTokens tokens() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return tokens_;
+    }
+
+    // "reused", "refreshed", "logged in" or "reloaded" (another process
+    // renewed the token file)
+    const char* lastAction() const { return lastAction_.load(); }
+
+    // Called with every renewed set of tokens, on the refresh thread once
+    // start() has been called. Set it before start().
+    void setOnRenew(RenewCallback onRenew) { onRenew_ = std::move(onRenew); }
+
+    // Refreshes refreshMarginS before each expiry until stop(). A failed
+    // refresh is retried every retryS, falling back to a login once the
+    // JWT has expired.
+    void start() {
+        if (running_) {
+            return;
+        }
+        running_ = true;
+        thread_ = std::thread(&TokenManager::run, this);
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!running_) {
+                return;
+            }
+            running_ = false;
+        }
+        wake_.notify_one();
+        thread_.join();
+    }
+
+    // exp claim of a JWT, with or without a "Bearer " prefix; 0 if absent
+    static int64_t jwtExpiry(const std::string& jwt) {
+        std::string token = stripBearer(jwt);
+        size_t first = token.find('.');
+        size_t second = first == std::string::npos ? std::string::npos : token.find('.', first + 1);
+        if (second == std::string::npos) {
+            return 0;
+        }
+        nlohmann::json claims = nlohmann::json::parse(base64UrlDecode(token.substr(first + 1, second - first - 1)), nullptr, false);
+        if (!claims.is_object() || !claims.contains("exp") || !claims["exp"].is_number()) {
+            return 0;
+        }
+        return claims["exp"].get<int64_t>();
+    }
+
+    // The bare JWT, for building an Authorization header
+    static std::string stripBearer(const std::string& jwt) {
+        return jwt.compare(0, 7, "Bearer ") == 0 ? jwt.substr(7) : jwt;
+    }
+
+    static SessionTokens readTokenFile(const std::string& path) {
+        SessionTokens tokens;
+        std::ifstream file(path);
+        std::string line;
+        while (std::getline(file, line)) {
+            size_t delimPos = line.find('=');
+            if (delimPos == std::string::npos) {
+                continue;
+            }
+            std::string key = line.substr(0, delimPos);
+            std::string value = line.substr(delimPos + 1);
+            if (key == "AuthToken") {
+                tokens.jwtToken = value;
+            } else if (key == "refreshToken") {
+                tokens.refreshToken = value;
+            } else if (key == "feedToken") {
+                tokens.feedToken = value;
+            }
+        }
+        tokens.expiresAt = jwtExpiry(tokens.jwtToken);
+        return tokens;
+    }
+
+    // Writes a fresh path + ".XXXXXX" (mkstemp creates it 0600), syncs it
+    // and renames it over path
+    static bool writeTokenFile(const std::string& path, const SessionTokens& tokens, std::string& error) {
+        std::ostringstream contents;
+        contents << "feedToken=" << tokens.feedToken << "\n"
+                 << "AuthToken=" << tokens.jwtToken << "\n"
+                 << "refreshToken=" << tokens.refreshToken << "\n"
+                 << "expiresAt=" << tokens.expiresAt << "\n";
+        std::string data = contents.str();
+
+        std::vector<char> tempPath(path.begin(), path.end());
+        const char suffix[] = ".XXXXXX";
+        tempPath.insert(tempPath.end(), suffix, suffix + sizeof(suffix));
+        int fd = ::mkstemp(tempPath.data());
+        if (fd < 0) {
+            error = "failed to create a temporary next to " + path + ": " + std::strerror(errno);
+            return false;
+        }
+        size_t written = 0;
+        while (written < data.size()) {
+            ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                break;
+            }
+            written += static_cast<size_t>(n);
+        }
+        bool ok = written == data.size() && ::fsync(fd) == 0;
+        ok = ::close(fd) == 0 && ok;
+        if (!ok) {
+            error = std::string("failed to write ") + tempPath.data() + ": " + std::strerror(errno);
+            ::unlink(tempPath.data());
+            return false;
+        }
+        if (std::rename(tempPath.data(), path.c_str()) != 0) {
+            error = std::string("failed to rename ") + tempPath.data() + " to " + path + ": " + std::strerror(errno);
+            ::unlink(tempPath.data());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    AuthSettings settings_;
+    std::map<std::string, std::string> credentials_;
+    std::atomic<const char*> lastAction_{""};
+    RenewCallback onRenew_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    SessionTokens tokens_;
+    bool running_ = false;
+    std::thread thread_;
+
+    struct HttpResult {
+        long status = 0;
+        std::string body;
+        std::string error;  // Transport error, empty if the request completed
+    };
+
+    std::string credential(const std::string& key) const {
+        auto it = credentials_.find(key);
+        return it == credentials_.end() ? "" : it->second;
+    }
+
+    static std::string base64UrlDecode(const std::string& encoded) {
+        std::string decoded;
+        int buffer = 0, bitsLeft = 0;
+        for (char c : encoded) {
+            int value;
+            if (c >= 'A' && c <= 'Z') value = c - 'A';
+            else if (c >= 'a' && c <= 'z') value = c - 'a' + 26;
+            else if (c >= '0' && c <= '9') value = c - '0' + 52;
+            else if (c == '-' || c == '+') value = 62;
+            else if (c == '_' || c == '/') value = 63;
+            else break;
+            buffer = (buffer << 6) | value;
+            bitsLeft += 6;
+            if (bitsLeft >= 8) {
+                decoded += static_cast<char>((buffer >> (bitsLeft - 8)) & 0xFF);
+                bitsLeft -= 8;
+            }
+        }
+        return decoded;
+    }
+
+    static int64_t remainingS(const SessionTokens& tokens) {
+        return tokens.expiresAt == 0 ? INT64_MAX : tokens.expiresAt - static_cast<int64_t>(std::time(nullptr));
+    }
+
+    static size_t writeBody(void* contents, size_t size, size_t nmemb, void* userp) {
+        static_cast<std::string*>(userp)->append(static_cast<char*>(contents), size * nmemb);
+        return size * nmemb;
+    }
+
+    // POST when body is non-empty, GET otherwise
+    HttpResult send(const std::string& path, const std::string& body, const std::string& jwt) const {
+        HttpResult result;
+        std::unique_ptr<CURL, decltype(&curl_easy_cleanup)> curl(curl_easy_init(), curl_easy_cleanup);
+        if (!curl) {
+            result.error = "curl_easy_init failed";
+            return result;
+        }
+        struct curl_slist* headers = NULL;
+        headers = curl_slist_append(headers, "Content-Type: application/json");
+        headers = curl_slist_append(headers, "Accept: application/json");
+        headers = curl_slist_append(headers, "X-UserType: USER");
+        headers = curl_slist_append(headers, "X-SourceID: WEB");
+        headers = curl_slist_append(headers, "X-ClientLocalIP: CLIENT_LOCAL_IP");
+        headers = curl_slist_append(headers, "X-ClientPublicIP: CLIENT_PUBLIC_IP");
+        headers = curl_slist_append(headers, "X-MACAddress: MAC_ADDRESS");
+        headers = curl_slist_append(headers, ("X-PrivateKey: " + credential("API_KEY")).c_str());
+        if (!jwt.empty()) {
+            headers = curl_slist_append(headers, ("Authorization: Bearer " + stripBearer(jwt)).c_str());
+        }
+
+        std::string url = settings_.baseUrl + path;
+        curl_easy_setopt(curl.get(), CURLOPT_URL, url.c_str());
+        curl_easy_setopt(curl.get(), CURLOPT_HTTPHEADER, headers);
+        if (!body.empty()) {
+            curl_easy_setopt(curl.get(), CURLOPT_POSTFIELDS, body.c_str());
+        }
+        curl_easy_setopt(curl.get(), CURLOPT_WRITEFUNCTION, writeBody);
+        curl_easy_setopt(curl.get(), CURLOPT_WRITEDATA, &result.body);
+        curl_easy_setopt(curl.get(), CURLOPT_TIMEOUT_MS, settings_.timeoutMs);
+        curl_easy_setopt(curl.get(), CURLOPT_NOSIGNAL, 1L);
+        CURLcode res = curl_easy_perform(curl.get());
+        curl_slist_free_all(headers);
+        if (res != CURLE_OK) {
+            result.error = curl_easy_strerror(res);
+            return result;
+        }
+        curl_easy_getinfo(curl.get(), CURLINFO_RESPONSE_CODE, &result.status);
+        return result;
+    }
+
+    // Error text from an AngelOne response that did not succeed
+    static std::string failure(const HttpResult& result, const nlohmann::json& response) {
+        if (!result.error.empty()) {
+            return result.error;
+        }
+        std::string message = "HTTP " + std::to_string(result.status);
+        if (response.is_object() && response.contains("message") && response["message"].is_string()) {
+            message += ": " + response["message"].get<std::string>();
+        }
+        if (response.is_object() && response.contains("errorcode") && response["errorcode"].is_string()) {
+            message += " (" + response["errorcode"].get<std::string>() + ")";
+        }
+        return message;
+    }
+
+    static bool succeeded(const HttpResult& result, const nlohmann::json& response) {
+        return result.error.empty() && result.status == 200 && response.is_object() &&
+               response.value("status", false) == true;
+    }
+
+    // getProfile as a cheap check that the server still accepts the JWT
+    bool validate(const SessionTokens& tokens, std::string& error) const {
+        HttpResult result = send("/rest/secure/angelbroking/user/v1/getProfile", "", tokens.jwtToken);
+        nlohmann::json response = nlohmann::json::parse(result.body, nullptr, false);
+        if (!succeeded(result, response)) {
+            error = "saved token rejected: " + failure(result, response);
+            return false;
+        }
+        return true;
+    }
+
+    // Posts to a token-issuing endpoint, then stores, saves and announces
+    // the tokens it returns
+    bool renew(const std::string& path, const std::string& body, const std::string& jwt, const char* action, std::string& error) {
+        HttpResult result = send(path, body, jwt);
+        nlohmann::json response = nlohmann::json::parse(result.body, nullptr, false);
+        if (!succeeded(result, response) || !response.contains("data") || !response["data"].is_object()) {
+            error = failure(result, response);
+            return false;
+        }
+        const nlohmann::json& data = response["data"];
+        SessionTokens renewed = tokens();
+        renewed.jwtToken = data.value("jwtToken", "");
+        renewed.refreshToken = data.value("refreshToken", renewed.refreshToken);
+        renewed.feedToken = data.value("feedToken", renewed.feedToken);
+        renewed.expiresAt = jwtExpiry(renewed.jwtToken);
+        if (renewed.jwtToken.empty()) {
+            error = "response has no jwtToken";
+            return false;
+        }
+        if (!writeTokenFile(settings_.tokenFile, renewed, error)) {
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tokens_ = renewed;
+        }
+        lastAction_ = action;
+        if (onRenew_) {
+            onRenew_(renewed);
+        }
+        return true;
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto nextAttempt = std::chrono::system_clock::from_time_t(tokens_.expiresAt - settings_.refreshMarginS);
+        while (running_) {
+            if (tokens_.expiresAt == 0) {
+                wake_.wait(lock);
+                continue;
+            }
+            if (wake_.wait_until(lock, nextAttempt) != std::cv_status::timeout || !running_) {
+                continue;
+            }
+
+            // Another process (bin/auth) may have renewed the file already
+            SessionTokens saved = readTokenFile(settings_.tokenFile);
+            bool expired = remainingS(tokens_) <= 0;
+            lock.unlock();
+            std::string error;
+            bool renewed = false;
+            if (!saved.jwtToken.empty() && saved.jwtToken != tokens().jwtToken && remainingS(saved) > settings_.refreshMarginS) {
+                {
+                    std::lock_guard<std::mutex> adopt(mutex_);
+                    tokens_ = saved;
+                }
+                lastAction_ = "reloaded";
+                if (onRenew_) {
+                    onRenew_(saved);
+                }
+                renewed = true;
+            } else {
+                renewed = refresh(error) || (expired && login(error));
+            }
+            if (!renewed) {
+                std::cerr << "Token refresh failed, retrying in " << settings_.retryS << " s: " << error << std::endl;
+            }
+            lock.lock();
+
+            // A JWT issued with less than the margin to live is refreshed
+            // every retryS rather than continuously
+            auto retry = std::chrono::system_clock::now() + std::chrono::seconds(settings_.retryS);
+            nextAttempt = renewed
+                ? std::max(retry, std::chrono::system_clock::from_time_t(tokens_.expiresAt - settings_.refreshMarginS))
+                : retry;
+        }
+    }
+};
@@ -3,26 +3,18 @@
 #include <fstream>
 #include <curl/curl.h>
 #include "nlohmann/json.hpp"
-#include <openssl/hmac.h>
-#include <openssl/evp.h>
-#include <openssl/crypto.h>
 #include <ctime>
 #include <iomanip>
-#include <sstream>
-#include <vector>
-#include <cmath>
 #include <map>
-
-using json = nlohmann::json;
+#include "TokenManager.hpp"
 
 // Function declarations
-std::string base32Decode(const std::string& encoded);
-std::vector<unsigned char> intToBytes(uint64_t value);
-std::string generateTOTP(const std::string& secret);
 std::map<std::string, std::string> readConfig(const std::string& filename);
-static size_t WriteCallback(void *contents, size_t size, size_t nmemb, void *userp);
 
-int main() {
+// Leaves a usable session in config/AuthTokens.ini: the saved one if it is
+// still valid, else a refreshed one, else a fresh login.
+// --login forces a fresh login; --base-url points at another API host.
+int main(int argc, char* argv[]) {
     // Load the config
     std::map<std::string, std::string> config = readConfig("config/Credentials.env");
     if (config.empty()) {
@@ -30,135 +22,45 @@ int main() {
         return 1;
     }
 
-    // Generate TOTP
-    std::string secret = base32Decode(config["base32Secret"]);
-    std::string totp = generateTOTP(secret);
-    std::cout << "Generated TOTP: " << totp << std::endl;
-
-    // Prepare JSON payload
-    json payload = {
-        {"clientcode", config["clientcode"]},
-        {"password", config["password"]},
-        {"totp", totp},
-        {"state", "Prod"}       
-    };
-    std::string json_payload = payload.dump();
-
-    // Set up and execute HTTP POST request
-    std::unique_ptr<CURL, decltype(&curl_easy_cleanup)> curl(curl_easy_init(), curl_easy_cleanup);
-    if (curl) {
-        struct curl_slist *headers = NULL;
-        headers = curl_slist_append(headers, "Content-Type: application/json");
-        headers = curl_slist_append(headers, "Accept: application/json");
-        headers = curl_slist_append(headers, "X-UserType: USER");
-        headers = curl_slist_append(headers, "X-SourceID: WEB");
-        headers = curl_slist_append(headers, "X-ClientLocalIP: CLIENT_LOCAL_IP");
-        headers = curl_slist_append(headers, "X-ClientPublicIP: CLIENT_PUBLIC_IP");
-        headers = curl_slist_append(headers, "X-MACAddress: MAC_ADDRESS");
-        headers = curl_slist_append(headers, ("X-PrivateKey: " + config["API_KEY"]).c_str());
-
-        curl_easy_setopt(curl.get(), CURLOPT_URL, "https://apiconnect.angelone.in/rest/auth/angelbroking/user/v1/loginByPassword");
-        curl_easy_setopt(curl.get(), CURLOPT_HTTPHEADER, headers);
-        curl_easy_setopt(curl.get(), CURLOPT_POSTFIELDS, json_payload.c_str());
-
-        std::string response_string;
-        curl_easy_setopt(curl.get(), CURLOPT_WRITEFUNCTION, WriteCallback);
-        curl_easy_setopt(curl.get(), CURLOPT_WRITEDATA, &response_string);
-
-        CURLcode res = curl_easy_perform(curl.get());
-
-        if (res != CURLE_OK) {
-            std::cerr << "curl_easy_perform() failed: " << curl_easy_strerror(res) << std::endl;
-        } else {
-            // Parse and handle response
-            try {
-                json response_json = json::parse(response_string);
-                std::cout << "Response JSON: " << response_json.dump(4) << std::endl;
-
-                // Save tokens to AuthTokens.ini
-                std::ofstream configFile("config/AuthTokens.ini");
-                if (configFile.is_open()) {
-                    configFile << "feedToken=" << response_json["data"]["feedToken"].get<std::string>() << std::endl;
-                    configFile << "AuthToken=" << response_json["data"]["jwtToken"].get<std::string>() << std::endl;
-                    configFile << "refreshToken=" << response_json["data"]["refreshToken"].get<std::string>() << std::endl;
-                    configFile.close();
-                } else {
-                    std::cerr << "Failed to open config/AuthTokens.ini for writing" << std::endl;
-                }
-            } catch (json::parse_error& e) {
-                std::cerr << "Failed to parse JSON: " << e.what() << std::endl;
-            }
-        }
-
-        curl_slist_free_all(headers);
+    AuthSettings settings;
+    std::map<std::string, std::string> authConfig = readConfig("config/settings/Auth.ini");
+    if (!authConfig["base_url"].empty()) {
+        settings.baseUrl = authConfig["base_url"];
     }
-
-    return 0;
-}
-
-// CURL write callback function
-static size_t WriteCallback(void *contents, size_t size, size_t nmemb, void *userp) {
-    ((std::string*)userp)->append((char*)contents, size * nmemb);
-    return size * nmemb;
-}
-
-// Base32 decoding function
-std::string base32Decode(const std::string& encoded) {
-    std::string decoded;
-    std::map<char, int> base32Lookup;
-    static const std::string BASE32_ALPHABET = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
-
-    for (int i = 0; i < 32; ++i) {
-        base32Lookup[BASE32_ALPHABET[i]] = i;
+    if (!authConfig["refresh_margin_s"].empty()) {
+        settings.refreshMarginS = std::stoi(authConfig["refresh_margin_s"]);
+    }
+    if (!authConfig["timeout_ms"].empty()) {
+        settings.timeoutMs = std::stol(authConfig["timeout_ms"]);
     }
 
-    int buffer = 0, bitsLeft = 0;
-    for (char c : encoded) {
-        if (c == '=') break;
-        buffer <<= 5;
-        buffer |= base32Lookup[c];
-        bitsLeft += 5;
-        if (bitsLeft >= 8) {
-            decoded += static_cast<char>((buffer >> (bitsLeft - 8)) & 0xFF);
-            bitsLeft -= 8;
+    bool forceLogin = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--login") {
+            forceLogin = true;
+        } else if (arg == "--base-url" && i + 1 < argc) {
+            settings.baseUrl = argv[++i];
         }
     }
-    return decoded;
-}
 
-// Convert integer to big-endian 8-byte array
-std::vector<unsigned char> intToBytes(uint64_t value) {
-    std::vector<unsigned char> bytes(8);
-    for (int i = 7; i >= 0; --i) {
-        bytes[i] = value & 0xFF;
-        value >>= 8;
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    TokenManager tokenManager(settings, config);
+    std::string error;
+    bool ok = forceLogin ? tokenManager.login(error) : tokenManager.ensureValid(error);
+    if (!ok) {
+        std::cerr << "Authentication failed: " << error << std::endl;
+        return 1;
     }
-    return bytes;
-}
 
-// TOTP generation function
-std::string generateTOTP(const std::string& secret) {
-    uint64_t timeCounter = std::time(nullptr) / 30;
-    std::vector<unsigned char> timeBytes = intToBytes(timeCounter);
-
-    unsigned char* result = HMAC(EVP_sha1(), secret.c_str(), secret.length(), timeBytes.data(), timeBytes.size(), nullptr, nullptr);
-
-    if (!result) {
-        std::cerr << "Failed to generate HMAC" << std::endl;
-        return "";
+    SessionTokens tokens = tokenManager.tokens();
+    std::cout << "Session " << tokenManager.lastAction();
+    if (tokens.expiresAt > 0) {
+        std::time_t expiresAt = static_cast<std::time_t>(tokens.expiresAt);
+        std::cout << ", valid until " << std::put_time(std::localtime(&expiresAt), "%Y-%m-%d %H:%M:%S");
     }
-
-    int offset = result[19] & 0xf;
-    uint32_t binaryCode = (result[offset] & 0x7f) << 24 |
-                          (result[offset + 1] & 0xff) << 16 |
-                          (result[offset + 2] & 0xff) << 8 |
-                          (result[offset + 3] & 0xff);
-
-    uint32_t totp = binaryCode % static_cast<uint32_t>(pow(10, 6));
-    std::ostringstream totpStream;
-    totpStream << std::setw(6) << std::setfill('0') << totp;
-
-    return totpStream.str();
+    std::cout << std::endl;
+    return 0;
 }
 
 // Function to read the config file
@@ -179,4 +81,4 @@ std::map<std::string, std::string> readConfig(const std::string& filename) {
         }
     }
     return configMap;
-}
\ No newline at end of file
+}
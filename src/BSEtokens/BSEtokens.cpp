@@ -2,6 +2,7 @@
 #include <fstream>
 #include <chrono>
 #include <iomanip>
+#include <sstream>
 #include <set>
 #include <thread>
 #include <vector>
@@ -12,6 +13,11 @@
 #include <cctype>
 #include <cstdio> // Include for std::remove
 #include <filesystem> // Include for std::filesystem
+#include "ScripMaster.hpp"
+#include "ScripSnapshot.hpp"
+#include "InstrumentUniverse.hpp"
+#include "HistoricalFetcher.hpp"
+#include "CandleStore.hpp"
 
 #ifdef _WIN32
 #include <winsock2.h>
@@ -28,6 +34,7 @@
 #include <sys/socket.h>
 #include <unistd.h>
 #include <netdb.h> // Added for NI_MAXHOST, getnameinfo, and NI_NUMERICHOST
+#include <sys/resource.h>
 #endif
 
 #ifdef __APPLE__
@@ -192,76 +199,298 @@ int roundOff(double number, const std::string& symbol) {
     return roundedNumber;
 }
 
-// Function to fetch historical data
-void fetchHistoricalData(const std::string& D0_str, const std::vector<nlohmann::json>& amxidxInstruments, std::map<std::string, std::pair<int, int>>& referenceData) {
-    CURL* curl;
-    CURLcode res;
-    std::string readBuffer;
-    curl = curl_easy_init();
+// Function to build the SmartAPI request headers; built once per run and shared by every request
+std::vector<std::string> buildApiHeaders() {
+    std::string apiKey = readValueFromFile("config/Credentials.env", "API_KEY");
+    std::string authToken = readValueFromFile("config/AuthTokens.ini", "AuthToken");
+    std::string localIP = getLocalIP();
+    std::string publicIP = getPublicIP();
+    std::string macAddress = getMACAddress();
+
+    return {
+        "X-PrivateKey: " + apiKey,
+        "Accept: application/json",
+        "X-SourceID: WEB",
+        "X-ClientLocalIP: " + localIP,
+        "X-ClientPublicIP: " + publicIP,
+        "X-MACAddress: " + macAddress,
+        "X-UserType: USER",
+        "Authorization: Bearer " + authToken,
+        "Content-Type: application/json"
+    };
+}
 
-    if (curl) {
-        std::string apiKey = readValueFromFile("config/Credentials.env", "API_KEY");
-        std::string authToken = readValueFromFile("config/AuthTokens.ini", "AuthToken");
-        std::string localIP = getLocalIP();
-        std::string publicIP = getPublicIP();
-        std::string macAddress = getMACAddress();
+struct BackfillInstrument {
+    std::string exchange;
+    std::string token;
+    std::string symbol;
+};
 
-        for (const auto& item : amxidxInstruments) {
-            std::string symbol = item["name"];
-            std::string token = item["token"];
+// One getCandleData request: a span of days for one series
+struct CandleChunk {
+    CandleSeries* series;
+    int32_t fromDate;
+    int32_t toDate;
+    bool below;      // Before the series' covered span rather than after it
+    bool ok = false;
+};
 
-            if (token.empty()) {
-                std::cerr << "Token not found for symbol: " << symbol << std::endl;
+// Function to parse a getCandleData response into candles
+bool parseCandles(const std::string& body, std::vector<Candle>& candles, std::string& error) {
+    try {
+        json j = json::parse(body);
+        if (!j.value("status", false)) {
+            error = j.value("message", std::string("request failed")) + " " + j.value("errorcode", std::string());
+            return false;
+        }
+        if (!j["data"].is_array()) {
+            return true;  // No candles in the span
+        }
+        for (const auto& row : j["data"]) {
+            Candle candle;
+            if (!parseCandleTime(row.at(0).get<std::string>(), candle.time)) {
+                error = "bad candle time " + row.at(0).dump();
+                return false;
+            }
+            candle.open = row.at(1).get<double>();
+            candle.high = row.at(2).get<double>();
+            candle.low = row.at(3).get<double>();
+            candle.close = row.at(4).get<double>();
+            candle.volume = row.at(5).get<int64_t>();
+            candles.push_back(candle);
+        }
+        return true;
+    } catch (const json::exception& e) {
+        error = std::string("JSON Parse Error: ") + e.what();
+        return false;
+    }
+}
+
+// Function to fetch the days each series lacks within [fromDate, toDate] and store them;
+// a series only requests the days outside the span it already covers
+bool backfillCandles(CandleStore& store, const std::vector<BackfillInstrument>& instruments, const std::vector<std::string>& intervals, int32_t fromDate, int32_t toDate, const HistoricalFetcherSettings& settings) {
+    std::vector<CandleChunk> chunks;
+    std::vector<CandleRequest> requests;
+    bool ok = true;
+    for (const auto& interval : intervals) {
+        int maxDays = maxCandleRequestDays(interval);
+        if (maxDays == 0) {
+            std::cerr << "Unknown candle interval: " << interval << std::endl;
+            ok = false;
+            continue;
+        }
+        for (const auto& instrument : instruments) {
+            std::string error;
+            CandleSeries* series = store.series(instrument.exchange, instrument.token, interval, error);
+            if (!series) {
+                std::cerr << "Candle store: " << error << std::endl;
+                ok = false;
                 continue;
             }
 
-            curl_easy_setopt(curl, CURLOPT_URL, "https://apiconnect.angelone.in/rest/secure/angelbroking/historical/v1/getCandleData");
-            std::string payload = "{ \"exchange\": \"BSE\", \"symboltoken\": \"" + token + "\", \"interval\": \"ONE_DAY\", \"fromdate\": \"" + D0_str + " 00:00\", \"todate\": \"" + D0_str + " 15:40\" }";
-            curl_easy_setopt(curl, CURLOPT_POSTFIELDS, payload.c_str());
-
-            struct curl_slist* headers = NULL;
-            headers = curl_slist_append(headers, ("X-PrivateKey: " + apiKey).c_str());
-            headers = curl_slist_append(headers, "Accept: application/json");
-            headers = curl_slist_append(headers, "X-SourceID: WEB");
-            headers = curl_slist_append(headers, ("X-ClientLocalIP: " + localIP).c_str());
-            headers = curl_slist_append(headers, ("X-ClientPublicIP: " + publicIP).c_str());
-            headers = curl_slist_append(headers, ("X-MACAddress: " + macAddress).c_str());
-            headers = curl_slist_append(headers, "X-UserType: USER");
-            headers = curl_slist_append(headers, ("Authorization: Bearer " + authToken).c_str());
-            headers = curl_slist_append(headers, "Content-Type: application/json");
-            curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-
-            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallbackCurl);
-            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
-
-            res = curl_easy_perform(curl);
-
-            if (res != CURLE_OK) {
-                std::cerr << "curl_easy_perform() failed: " << curl_easy_strerror(res) << std::endl;
+            // Missing spans stay adjacent to the covered one so it stays contiguous
+            std::vector<std::pair<std::pair<int32_t, int32_t>, bool>> missing;
+            const CandleFileHeader& header = series->header();
+            if (header.coveredFrom == 0) {
+                missing.push_back({{fromDate, toDate}, false});
             } else {
-                try {
-                    json j = json::parse(readBuffer);
-                    double ltp = j["data"][0][4];
-                    int upperRange = roundOff(ltp * 1.10, symbol);
-                    int lowerRange = roundOff(ltp * 0.90, symbol);
+                if (fromDate < header.coveredFrom) {
+                    missing.push_back({{fromDate, addDays(header.coveredFrom, -1)}, true});
+                }
+                if (toDate > header.coveredTo) {
+                    missing.push_back({{addDays(header.coveredTo, 1), toDate}, false});
+                }
+            }
 
-                    // Store the calculated ranges in the reference data map
-                    referenceData[symbol] = std::make_pair(lowerRange, upperRange);
+            for (const auto& span : missing) {
+                for (int32_t chunkFrom = span.first.first; chunkFrom <= span.first.second; chunkFrom = addDays(chunkFrom, maxDays)) {
+                    int32_t chunkTo = std::min(span.first.second, addDays(chunkFrom, maxDays - 1));
+                    chunks.push_back({series, chunkFrom, chunkTo, span.second});
+                    CandleRequest request;
+                    request.symbol = instrument.symbol;
+                    request.payload = "{ \"exchange\": \"" + instrument.exchange + "\", \"symboltoken\": \"" + instrument.token + "\", \"interval\": \"" + interval + "\", \"fromdate\": \"" + formatIsoDate(chunkFrom) + " 00:00\", \"todate\": \"" + formatIsoDate(chunkTo) + " 15:40\" }";
+                    requests.push_back(std::move(request));
+                }
+            }
+        }
+    }
+    if (requests.empty()) {
+        return ok;
+    }
 
-                    // Print the final calculated ranges and close price
-                    std::cout << "Symbol: " << symbol << ", Close Price: " << ltp << ", Lower Range: " << lowerRange << ", Upper Range: " << upperRange << std::endl;
+    auto fetchStart = std::chrono::steady_clock::now();
+    uint64_t candleCount = 0;
+    HistoricalFetcher fetcher(settings, buildApiHeaders());
+    fetcher.fetch(requests, [&](size_t index, const CandleResponse& response) {
+        CandleChunk& chunk = chunks[index];
+        const std::string& symbol = requests[index].symbol;
+        if (response.result != CURLE_OK) {
+            std::cerr << "curl_easy_perform() failed: " << curl_easy_strerror(response.result) << std::endl;
+            return;
+        }
+        if (response.status != 200) {
+            std::cerr << "Historical data for " << symbol << " failed with HTTP " << response.status
+                      << " after " << response.attempts << " attempt(s)" << std::endl;
+            return;
+        }
+        std::vector<Candle> candles;
+        std::string error;
+        if (!parseCandles(response.body, candles, error) || !chunk.series->append(candles, error)) {
+            std::cerr << "Historical data for " << symbol << ": " << error << std::endl;
+            return;
+        }
+        candleCount += candles.size();
+        chunk.ok = true;
+    });
 
-                } catch (const json::parse_error& e) {
-                    std::cerr << "JSON Parse Error: " << e.what() << std::endl;
+    // Extend each covered span outwards through consecutive successful chunks;
+    // a failed chunk stops it, so its days are requested again next time
+    std::map<CandleSeries*, std::vector<CandleChunk*>> bySeries;
+    for (auto& chunk : chunks) {
+        bySeries[chunk.series].push_back(&chunk);
+    }
+    for (auto& entry : bySeries) {
+        std::vector<CandleChunk*>& seriesChunks = entry.second;
+        if (!entry.first->isOpen()) {
+            ok = false;
+            continue;
+        }
+        for (auto it = seriesChunks.rbegin(); it != seriesChunks.rend(); ++it) {
+            if ((*it)->below) {
+                if (!(*it)->ok) {
+                    break;
                 }
+                entry.first->markCovered((*it)->fromDate, (*it)->toDate);
             }
+        }
+        for (CandleChunk* chunk : seriesChunks) {
+            if (!chunk->below) {
+                if (!chunk->ok) {
+                    break;
+                }
+                entry.first->markCovered(chunk->fromDate, chunk->toDate);
+            }
+        }
+        ok = ok && std::all_of(seriesChunks.begin(), seriesChunks.end(), [](const CandleChunk* chunk) { return chunk->ok; });
+    }
 
-            readBuffer.clear();
-            std::this_thread::sleep_for(std::chrono::milliseconds(250));
+    double fetchSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - fetchStart).count();
+    std::streamsize precision = std::cout.precision();
+    std::cout << "Historical data: " << requests.size() << " requests, " << fetcher.retries() << " retries, "
+              << candleCount << " candles, " << std::fixed << std::setprecision(2) << fetchSeconds << " s" << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout.precision(precision);
+    return ok;
+}
+
+// Function to fetch historical data; D0 candles come from the local candle store,
+// which fetches only the days it has not stored yet
+void fetchHistoricalData(const std::string& D0_str, const std::vector<ScripRecord>& amxidxInstruments, std::map<std::string, std::pair<int, int>>& referenceData, const HistoricalFetcherSettings& settings) {
+    std::vector<BackfillInstrument> instruments;
+    for (const auto& item : amxidxInstruments) {
+        if (item.token.empty()) {
+            std::cerr << "Token not found for symbol: " << item.name << std::endl;
+            continue;
         }
+        instruments.push_back({"BSE", item.token, item.name});
+    }
+    int32_t D0 = parseIsoDate(D0_str);
 
-        curl_easy_cleanup(curl);
+    CandleStore store;
+    backfillCandles(store, instruments, {"ONE_DAY"}, D0, D0, settings);
+
+    for (const auto& instrument : instruments) {
+        const std::string& symbol = instrument.symbol;
+        std::string error;
+        CandleSeries* series = store.series(instrument.exchange, instrument.token, "ONE_DAY", error);
+        if (!series) {
+            continue;
+        }
+        std::pair<size_t, size_t> day = series->days(D0, D0);
+        if (day.first == day.second) {
+            std::cerr << "No " << D0_str << " candle for symbol: " << symbol << std::endl;
+            continue;
+        }
+        double ltp = series->closes()[day.second - 1];
+        int upperRange = roundOff(ltp * 1.10, symbol);
+        int lowerRange = roundOff(ltp * 0.90, symbol);
+
+        // Store the calculated ranges in the reference data map
+        referenceData[symbol] = std::make_pair(lowerRange, upperRange);
+
+        // Print the final calculated ranges and close price
+        std::cout << "Symbol: " << symbol << ", Close Price: " << ltp << ", Lower Range: " << lowerRange << ", Upper Range: " << upperRange << std::endl;
+    }
+}
+
+// Function to split a comma-separated setting, dropping blanks
+std::vector<std::string> splitList(const std::string& value) {
+    std::vector<std::string> items;
+    std::stringstream stream(value);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        item.erase(0, item.find_first_not_of(" \t\r"));
+        item.erase(item.find_last_not_of(" \t\r") + 1);
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+// Function to backfill the candle store for the instruments and intervals in Backfill.ini,
+// over the backfillDays calendar days ending at D0; the AMXIDX instruments are used when
+// no instruments are listed
+bool runBackfill(const std::string& D0_str, const std::vector<ScripRecord>& amxidxInstruments, int backfillDays, const HistoricalFetcherSettings& settings) {
+    const std::string settingsPath = "config/settings/Backfill.ini";
+    std::vector<std::string> intervals = splitList(readValueFromFile(settingsPath, "backfill_intervals"));
+    if (intervals.empty()) {
+        intervals.push_back("ONE_DAY");
+    }
+    if (backfillDays <= 0) {
+        backfillDays = std::atoi(readValueFromFile(settingsPath, "backfill_days").c_str());
+    }
+    if (backfillDays <= 0) {
+        backfillDays = 365;
+    }
+
+    // Instruments are EXCHANGE:TOKEN:SYMBOL
+    std::vector<BackfillInstrument> instruments;
+    for (const auto& entry : splitList(readValueFromFile(settingsPath, "backfill_instruments"))) {
+        size_t first = entry.find(':');
+        size_t second = first == std::string::npos ? std::string::npos : entry.find(':', first + 1);
+        if (second == std::string::npos) {
+            std::cerr << "Ignoring backfill instrument " << entry << " (expected EXCHANGE:TOKEN:SYMBOL)" << std::endl;
+            continue;
+        }
+        instruments.push_back({entry.substr(0, first), entry.substr(first + 1, second - first - 1), entry.substr(second + 1)});
+    }
+    if (instruments.empty()) {
+        for (const auto& item : amxidxInstruments) {
+            instruments.push_back({"BSE", item.token, item.name});
+        }
+    }
+
+    int32_t D0 = parseIsoDate(D0_str);
+    int32_t fromDate = addDays(D0, 1 - backfillDays);
+    std::cout << "Backfilling " << instruments.size() << " instruments x " << intervals.size() << " intervals from "
+              << formatIsoDate(fromDate) << " to " << D0_str << std::endl;
+
+    CandleStore store;
+    bool ok = backfillCandles(store, instruments, intervals, fromDate, D0, settings);
+    for (const auto& interval : intervals) {
+        for (const auto& instrument : instruments) {
+            std::string error;
+            CandleSeries* series = store.series(instrument.exchange, instrument.token, interval, error);
+            if (series) {
+                const CandleFileHeader& header = series->header();
+                std::cout << instrument.symbol << " " << interval << ": " << series->size() << " candles, covered "
+                          << (header.coveredFrom ? formatIsoDate(header.coveredFrom) + " to " + formatIsoDate(header.coveredTo) : std::string("nothing"))
+                          << std::endl;
+            }
+        }
     }
+    return ok;
 }
 
 void saveReferenceDataToCSV(const std::map<std::string, std::pair<int, int>>& referenceData) {
@@ -328,17 +557,288 @@ std::string downloadJsonData(const std::string& url) {
     return readBuffer;
 }
 
-// Function to filter AMXIDX instruments
-void filterAMXIDXInstruments(const nlohmann::json& jsonData, std::vector<nlohmann::json>& amxidxInstruments, const std::string& D0_str, std::map<std::string, std::pair<int, int>>& referenceData) {
-    std::vector<std::string> indexNames = {"BANKEX", "SENSEX"};
+// HTTP validators of a scrip master download, sent back on the next request
+struct ScripValidators {
+    std::string etag;
+    std::string lastModified;
+};
+
+struct ScripTransfer {
+    CURL* curl;
+    ScripMasterParser* parser;
+    ScripValidators received;
+};
+
+// Function to feed downloaded bytes straight into the scrip master parser
+size_t ScripMasterWriteCallback(void* contents, size_t size, size_t nmemb, ScripTransfer* transfer) {
+    size_t newLength = size * nmemb;
+    long status = 0;
+    curl_easy_getinfo(transfer->curl, CURLINFO_RESPONSE_CODE, &status);
+    if (status != 200 && status != 0) {
+        return newLength;  // Error bodies are not scrip master JSON
+    }
+    // Returning short aborts the transfer on a parse error
+    return transfer->parser->feed(static_cast<const char*>(contents), newLength) ? newLength : 0;
+}
+
+// Function to capture the ETag and Last-Modified response headers
+size_t ScripMasterHeaderCallback(char* buffer, size_t size, size_t nitems, ScripTransfer* transfer) {
+    size_t length = size * nitems;
+    std::string line(buffer, length);
+    size_t colon = line.find(':');
+    if (colon != std::string::npos) {
+        std::string name = line.substr(0, colon);
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+        size_t begin = line.find_first_not_of(" \t", colon + 1);
+        size_t end = line.find_last_not_of(" \t\r\n");
+        std::string value = begin == std::string::npos || end < begin ? "" : line.substr(begin, end - begin + 1);
+        if (name == "etag") {
+            transfer->received.etag = value;
+        } else if (name == "last-modified") {
+            transfer->received.lastModified = value;
+        }
+    }
+    return length;
+}
+
+// Function to parse the scrip master while it downloads. When validators
+// from an earlier download are given the request is conditional; a 304 sets
+// notModified and parses nothing. On success validators hold the new ones.
+bool streamScripMaster(const std::string& url, ScripMasterParser& parser, ScripValidators& validators, bool& notModified) {
+    notModified = false;
+    CURL* curl = curl_easy_init();
+    if (!curl) {
+        return false;
+    }
+    ScripTransfer transfer{curl, &parser, {}};
+    struct curl_slist* headers = NULL;
+    if (!validators.etag.empty()) {
+        headers = curl_slist_append(headers, ("If-None-Match: " + validators.etag).c_str());
+    }
+    if (!validators.lastModified.empty()) {
+        headers = curl_slist_append(headers, ("If-Modified-Since: " + validators.lastModified).c_str());
+    }
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");  // Any encoding curl can decode, gzip included
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, ScripMasterWriteCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &transfer);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, ScripMasterHeaderCallback);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, &transfer);
+    CURLcode res = curl_easy_perform(curl);
+    long status = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+    curl_easy_cleanup(curl);
+    curl_slist_free_all(headers);
+
+    if (!parser.error().empty()) {
+        std::cerr << parser.error() << std::endl;
+        return false;
+    }
+    if (res != CURLE_OK) {
+        std::cerr << "Failed to download data: " << curl_easy_strerror(res) << std::endl;
+        return false;
+    }
+    if (status == 304) {
+        notModified = true;
+        return true;
+    }
+    if (status != 200 && status != 0) {
+        std::cerr << "Failed to download data: HTTP " << status << std::endl;
+        return false;
+    }
+    validators = transfer.received;
+    if (!parser.finish()) {
+        std::cerr << parser.error() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Function to parse a local copy of the scrip master in fixed-size chunks
+bool streamScripMasterFile(const std::string& path, ScripMasterParser& parser) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error opening file: " << path << std::endl;
+        return false;
+    }
+    std::vector<char> buffer(1 << 20);
+    while (file) {
+        file.read(buffer.data(), buffer.size());
+        if (!parser.feed(buffer.data(), static_cast<size_t>(file.gcount()))) {
+            break;
+        }
+    }
+    if (!parser.finish()) {
+        std::cerr << parser.error() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Function to get peak resident memory of this process in MB
+double peakResidentMB() {
+#ifdef _WIN32
+    return 0;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / (1024.0 * 1024.0);  // bytes on macOS
+#else
+    return usage.ru_maxrss / 1024.0;  // kilobytes on Linux
+#endif
+#endif
+}
+
+bool isSameLocalDay(std::time_t a, std::time_t b) {
+    std::tm dayA = *std::localtime(&a);
+    std::tm dayB = *std::localtime(&b);
+    return dayA.tm_year == dayB.tm_year && dayA.tm_yday == dayB.tm_yday;
+}
+
+// Function to open the cached scrip master snapshot, refreshing it first
+// unless the server already confirmed it today. A 304 only stamps the
+// snapshot; a changed file is parsed while it downloads and converted once.
+bool loadScripSnapshot(const std::string& url, const std::string& path, bool forceRefresh, ScripSnapshot& snapshot) {
+    std::string error;
+    bool cached = snapshot.open(path, error);
+    std::time_t nowEpoch = std::time(nullptr);
+    if (cached && !forceRefresh && isSameLocalDay(snapshot.header().validatedEpoch, nowEpoch)) {
+        return true;
+    }
+
+    ScripValidators validators;
+    if (cached) {
+        validators.etag = snapshot.header().etag;
+        validators.lastModified = snapshot.header().lastModified;
+    }
+
+    ScripSnapshotBuilder builder;
+    ScripMasterParser parser([&builder](const ScripRecord& item) {
+        builder.add(item);
+    });
+    bool notModified = false;
+    if (!streamScripMaster(url, parser, validators, notModified)) {
+        if (cached) {
+            std::cerr << "Scrip master refresh failed, using the cached snapshot." << std::endl;
+            return true;
+        }
+        return false;
+    }
+    if (notModified && cached) {
+        ScripSnapshot::markValidated(path, nowEpoch);
+        std::cout << "Scrip master not modified since the cached snapshot." << std::endl;
+        return true;
+    }
+
+    snapshot.close();
+    std::filesystem::path snapshotDir = std::filesystem::path(path).parent_path();
+    if (!snapshotDir.empty() && !std::filesystem::exists(snapshotDir)) {
+        std::filesystem::create_directories(snapshotDir);
+    }
+    if (!builder.write(path, validators.etag, validators.lastModified, error) || !snapshot.open(path, error)) {
+        std::cerr << "Scrip master snapshot: " << error << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool isIndexName(const std::string& name) {
+    return name == "BANKEX" || name == "SENSEX";
+}
+
+bool isAMXIDXInstrument(const ScripRecord& item) {
+    return item.instrumenttype == "AMXIDX" && isIndexName(item.name);
+}
+
+bool isOPTIDXInstrument(const ScripRecord& item, const std::string& D1_str, const std::string& D2_str, const std::string& sensexExpiryDateStr) {
+    if (item.instrumenttype != "OPTIDX" || item.exch_seg != "BFO" || !isIndexName(item.name)) {
+        return false;
+    }
+    return (item.name == "BANKEX" && (item.expiry == D1_str || item.expiry == D2_str)) ||
+           (item.name == "SENSEX" && item.expiry == sensexExpiryDateStr);
+}
+
+// Function to filter AMXIDX instruments out of a parsed scrip master DOM
+void filterAMXIDXInstruments(const nlohmann::json& jsonData, std::vector<ScripRecord>& amxidxInstruments) {
+    for (const auto& item : jsonData) {
+        ScripRecord record = ScripRecord::fromJson(item);
+        if (isAMXIDXInstrument(record)) {
+            amxidxInstruments.push_back(std::move(record));
+        }
+    }
+}
+
+// Function to filter OPTIDX instruments out of a parsed scrip master DOM
+void filterOPTIDXInstruments(const nlohmann::json& jsonData, const std::string& D1_str, const std::string& D2_str, const std::string& sensexExpiryDateStr, std::vector<ScripRecord>& optidxInstruments) {
     for (const auto& item : jsonData) {
-        if (item.contains("instrumenttype") && item["instrumenttype"] == "AMXIDX" &&
-            item.contains("name") && std::find(indexNames.begin(), indexNames.end(), item["name"]) != indexNames.end()) {
-            // Store AMXIDX instrument
-            amxidxInstruments.push_back(item);
+        ScripRecord record = ScripRecord::fromJson(item);
+        if (isOPTIDXInstrument(record, D1_str, D2_str, sensexExpiryDateStr)) {
+            optidxInstruments.push_back(std::move(record));
+        }
+    }
+}
+
+// Function to run instrument queries against the snapshot; records come back
+// in scrip master order, as the DOM and streaming filters produce them
+std::vector<ScripRecord> selectInstruments(const InstrumentUniverse& universe, const std::vector<InstrumentQuery>& queries) {
+    std::vector<uint32_t> rows;
+    for (const auto& query : queries) {
+        universe.select(query, rows);
+    }
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+    std::vector<ScripRecord> instruments;
+    instruments.reserve(rows.size());
+    for (uint32_t row : rows) {
+        instruments.push_back(universe.snapshot().record(row));
+    }
+    return instruments;
+}
+
+// Queries matching isAMXIDXInstrument
+std::vector<InstrumentQuery> amxidxQueries() {
+    std::vector<InstrumentQuery> queries;
+    for (const char* name : {"BANKEX", "SENSEX"}) {
+        InstrumentQuery query;
+        query.instrumentType = "AMXIDX";
+        query.name = name;
+        queries.push_back(query);
+    }
+    return queries;
+}
+
+// Queries matching isOPTIDXInstrument, narrowed to each index's strike window
+// when its reference range is known; the window keeps the strikes that
+// checkAndSaveOPTIDXInstruments would keep
+std::vector<InstrumentQuery> optidxQueries(const std::string& D1_str, const std::string& D2_str, const std::string& sensexExpiryDateStr, const std::map<std::string, std::pair<int, int>>& referenceData) {
+    std::vector<std::pair<std::string, std::string>> expiries = {
+        {"BANKEX", D1_str}, {"BANKEX", D2_str}, {"SENSEX", sensexExpiryDateStr}};
+    std::vector<InstrumentQuery> queries;
+    for (const auto& entry : expiries) {
+        int32_t expiry = parseExpiryDate(entry.second);
+        if (expiry == 0) {
+            continue;  // 0 would select the undated rows
+        }
+        InstrumentQuery query;
+        query.instrumentType = "OPTIDX";
+        query.name = entry.first;
+        query.segment = "BFO";
+        query.expiry = expiry;
+        auto range = referenceData.find(entry.first);
+        if (range != referenceData.end()) {
+            query.strikeFrom = range->second.first * 100.0;
+            query.strikeTo = (range->second.second + 1) * 100.0;
         }
+        queries.push_back(query);
     }
+    return queries;
+}
 
+// Function to save AMXIDX instruments and derive reference ranges from their last close
+void saveAMXIDXInstruments(const std::vector<ScripRecord>& amxidxInstruments, const std::string& D0_str, std::map<std::string, std::pair<int, int>>& referenceData, const HistoricalFetcherSettings& historicalSettings) {
     // Save AMXIDX instruments to AMXIDX_Tokens.csv
     std::filesystem::path outputDir = "SocketTokens";
     if (!std::filesystem::exists(outputDir)) {
@@ -349,51 +849,34 @@ void filterAMXIDXInstruments(const nlohmann::json& jsonData, std::vector<nlohman
     amxidxFile << "token,symbol,name,expiry,strike,lotsize,instrumenttype\n";
 
     for (const auto& item : amxidxInstruments) {
-        amxidxFile << item["token"] << ","
-                   << item["symbol"] << ","
-                   << item["name"] << ","
-                   << item["expiry"] << ","
-                   << item["strike"] << ","
-                   << item["lotsize"] << ","
-                   << item["instrumenttype"] << "\n";
+        amxidxFile << jsonQuoted(item.token) << ","
+                   << jsonQuoted(item.symbol) << ","
+                   << jsonQuoted(item.name) << ","
+                   << jsonQuoted(item.expiry) << ","
+                   << jsonQuoted(item.strike) << ","
+                   << jsonQuoted(item.lotsize) << ","
+                   << jsonQuoted(item.instrumenttype) << "\n";
     }
     amxidxFile.close();
 
     // Fetch historical data for AMXIDX instruments
-    fetchHistoricalData(D0_str, amxidxInstruments, referenceData);
+    fetchHistoricalData(D0_str, amxidxInstruments, referenceData, historicalSettings);
 
     // Save the reference data to CSV
     saveReferenceDataToCSV(referenceData);
 }
 
-// Function to filter OPTIDX instruments
-void filterOPTIDXInstruments(const nlohmann::json& jsonData, const std::string& D1_str, const std::string& D2_str, const std::string& sensexExpiryDateStr, std::vector<nlohmann::json>& optidxInstruments) {
-    std::vector<std::string> indexNames = {"BANKEX", "SENSEX"};
-    for (const auto& item : jsonData) {
-        if (item.contains("instrumenttype") && item["instrumenttype"] == "OPTIDX" &&
-            item.contains("exch_seg") && item["exch_seg"] == "BFO" &&
-            item.contains("name") && std::find(indexNames.begin(), indexNames.end(), item["name"]) != indexNames.end()) {
-            std::string expiry = item["expiry"];
-            if ((item["name"] == "BANKEX" && (expiry == D1_str || expiry == D2_str)) ||
-                (item["name"] == "SENSEX" && expiry == sensexExpiryDateStr)) {
-                // Store OPTIDX instrument
-                optidxInstruments.push_back(item);
-            }
-        }
-    }
-}
-
 // Function to check strike prices against reference data and save to CSV
-void checkAndSaveOPTIDXInstruments(const std::vector<nlohmann::json>& optidxInstruments, const std::map<std::string, std::pair<int, int>>& referenceData) {
+void checkAndSaveOPTIDXInstruments(const std::vector<ScripRecord>& optidxInstruments, const std::map<std::string, std::pair<int, int>>& referenceData) {
     std::filesystem::path outputDir = "SocketTokens";
     if (!std::filesystem::exists(outputDir)) {
         std::filesystem::create_directory(outputDir);
     }
 
     // Sort OPTIDX instruments by expiry date (assuming expiry is in "YYYY-MM-DD" format)
-    std::vector<nlohmann::json> sortedOptidxInstruments = optidxInstruments;
-    std::sort(sortedOptidxInstruments.begin(), sortedOptidxInstruments.end(), [](const nlohmann::json& a, const nlohmann::json& b) {
-        return a["expiry"] < b["expiry"];
+    std::vector<ScripRecord> sortedOptidxInstruments = optidxInstruments;
+    std::stable_sort(sortedOptidxInstruments.begin(), sortedOptidxInstruments.end(), [](const ScripRecord& a, const ScripRecord& b) {
+        return a.expiry < b.expiry;
     });
 
     // Save to CSV file
@@ -402,20 +885,20 @@ void checkAndSaveOPTIDXInstruments(const std::vector<nlohmann::json>& optidxInst
 
     bool found = false;
     for (const auto& item : sortedOptidxInstruments) {
-        std::string name = item["name"];
-        double strike = std::stod(item["strike"].get<std::string>());
+        const std::string& name = item.name;
+        double strike = std::stod(item.strike);
         int adjustedStrike = static_cast<int>(strike / 100);
 
         auto range = referenceData.find(name);
         if (range != referenceData.end() && adjustedStrike >= range->second.first && adjustedStrike <= range->second.second) {
             // Save to CSV
-            csvFile << item["token"] << ","
-                    << item["symbol"] << ","
-                    << item["name"] << ","
-                    << item["expiry"] << ","
+            csvFile << jsonQuoted(item.token) << ","
+                    << jsonQuoted(item.symbol) << ","
+                    << jsonQuoted(item.name) << ","
+                    << jsonQuoted(item.expiry) << ","
                     << adjustedStrike << ","
-                    << item["lotsize"] << ","
-                    << item["instrumenttype"] << "\n";
+                    << jsonQuoted(item.lotsize) << ","
+                    << jsonQuoted(item.instrumenttype) << "\n";
             found = true;
         }
     }
@@ -575,7 +1058,44 @@ std::vector<int> generateStrikeSequence(int lowerRange, int upperRange) {
     return sequence;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    // --legacy-dom keeps the full-DOM parse for comparison; --scrip-file reads a local copy;
+    // --no-scrip-cache streams without the snapshot; --refresh-scrip revalidates the snapshot now;
+    // --historical-url and --historical-rate override the candle endpoint and its per-second limit;
+    // --backfill [--backfill-days N] fills the local candle store and exits
+    std::string scripMasterUrl = "https://margincalculator.angelbroking.com/OpenAPI_File/files/OpenAPIScripMaster.json";
+    const std::string scripSnapshotPath = "cache/ScripMaster.snap";
+    bool legacyDom = false;
+    bool useScripCache = true;
+    bool refreshScrip = false;
+    std::string scripFile;
+    HistoricalFetcherSettings historicalSettings;
+    bool backfill = false;
+    int backfillDays = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--legacy-dom") {
+            legacyDom = true;
+        } else if (arg == "--scrip-file" && i + 1 < argc) {
+            scripFile = argv[++i];
+        } else if (arg == "--scrip-url" && i + 1 < argc) {
+            scripMasterUrl = argv[++i];
+        } else if (arg == "--no-scrip-cache") {
+            useScripCache = false;
+        } else if (arg == "--refresh-scrip") {
+            refreshScrip = true;
+        } else if (arg == "--historical-url" && i + 1 < argc) {
+            historicalSettings.url = argv[++i];
+        } else if (arg == "--historical-rate" && i + 1 < argc) {
+            historicalSettings.requestsPerSecond = std::max(0.1, std::atof(argv[++i]));
+            historicalSettings.requestsPerMinute = historicalSettings.requestsPerSecond * 60;
+        } else if (arg == "--backfill") {
+            backfill = true;
+        } else if (arg == "--backfill-days" && i + 1 < argc) {
+            backfillDays = std::atoi(argv[++i]);
+        }
+    }
+
     // Load holidays from config file
     std::vector<Date> holidays = readHolidays("config/settings/Holiday.ini");
 
@@ -613,27 +1133,94 @@ int main() {
     std::string sensexExpiryDateStr = formatDateDDMMMYYYY(sensexExpiryDate);
     std::cout << "SENSEX Expiry Date: " << sensexExpiryDateStr << std::endl;
 
-    // Download JSON data from the provided URL
-    std::string jsonData = downloadJsonData("https://margincalculator.angelbroking.com/OpenAPI_File/files/OpenAPIScripMaster.json");
+    // Vector to store filtered AMXIDX and OPTIDX instruments
+    std::vector<ScripRecord> amxidxInstruments;
+    std::vector<ScripRecord> optidxInstruments;
+
+    auto loadStart = std::chrono::steady_clock::now();
+    uint64_t recordCount = 0;
+    uint64_t byteCount = 0;
+    bool loaded = false;
+    const char* loadPath = legacyDom ? "DOM" : "streaming";
+    ScripSnapshot snapshot;
+
+    if (!legacyDom && scripFile.empty() && useScripCache) {
+        // Cached columnar snapshot, revalidated with a conditional request at most once a day
+        loadPath = "snapshot";
+        loaded = loadScripSnapshot(scripMasterUrl, scripSnapshotPath, refreshScrip, snapshot);
+        if (loaded) {
+            // OPTIDX rows are selected once the reference ranges are known
+            amxidxInstruments = selectInstruments(InstrumentUniverse(snapshot), amxidxQueries());
+            recordCount = snapshot.size();
+            byteCount = snapshot.bytes();
+        }
+    } else if (legacyDom) {
+        // Previous path: download everything, build the full DOM, then filter
+        std::string jsonData;
+        if (!scripFile.empty()) {
+            std::ifstream file(scripFile, std::ios::binary);
+            jsonData.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        } else {
+            jsonData = downloadJsonData(scripMasterUrl);
+        }
+
+        if (!jsonData.empty()) {
+            // Parse the JSON data
+            nlohmann::json jsonObj = nlohmann::json::parse(jsonData);
+            recordCount = jsonObj.size();
+            byteCount = jsonData.size();
 
-    if (!jsonData.empty()) {
-        // Parse the JSON data
-        nlohmann::json jsonObj = nlohmann::json::parse(jsonData);
+            // Create threads
+            std::thread amxidxThread(filterAMXIDXInstruments, std::ref(jsonObj), std::ref(amxidxInstruments));
+            std::thread optidxThread(filterOPTIDXInstruments, std::ref(jsonObj), D1_str, D2_str, sensexExpiryDateStr, std::ref(optidxInstruments));
 
-        // Vector to store filtered AMXIDX and OPTIDX instruments
-        std::vector<nlohmann::json> amxidxInstruments;
-        std::vector<nlohmann::json> optidxInstruments;
+            // Join threads
+            amxidxThread.join();
+            optidxThread.join();
+            loaded = true;
+        }
+    } else {
+        // Filter each record as it is parsed; only matching instruments are kept
+        ScripMasterParser parser([&](const ScripRecord& item) {
+            if (isAMXIDXInstrument(item)) {
+                amxidxInstruments.push_back(item);
+            } else if (isOPTIDXInstrument(item, D1_str, D2_str, sensexExpiryDateStr)) {
+                optidxInstruments.push_back(item);
+            }
+        });
+        if (scripFile.empty()) {
+            ScripValidators validators;
+            bool notModified = false;
+            loaded = streamScripMaster(scripMasterUrl, parser, validators, notModified);
+        } else {
+            loaded = streamScripMasterFile(scripFile, parser);
+        }
+        recordCount = parser.records();
+        byteCount = parser.bytes();
+    }
 
+    double loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+    std::streamsize precision = std::cout.precision();
+    std::cout << "Scrip master (" << loadPath << "): " << recordCount << " records, "
+              << std::fixed << std::setprecision(1) << byteCount / (1024.0 * 1024.0) << " MB, "
+              << std::setprecision(3) << loadSeconds << " s, peak RSS "
+              << std::setprecision(1) << peakResidentMB() << " MB" << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout.precision(precision);
+
+    if (backfill) {
+        return runBackfill(D0_str, amxidxInstruments, backfillDays, historicalSettings) ? 0 : 1;
+    }
+
+    if (loaded) {
         // Map to store reference data
         std::map<std::string, std::pair<int, int>> referenceData;
 
-        // Create threads
-        std::thread amxidxThread(filterAMXIDXInstruments, std::ref(jsonObj), std::ref(amxidxInstruments), D0_str, std::ref(referenceData));
-        std::thread optidxThread(filterOPTIDXInstruments, std::ref(jsonObj), D1_str, D2_str, sensexExpiryDateStr, std::ref(optidxInstruments));
-
-        // Join threads
-        amxidxThread.join();
-        optidxThread.join();
+        // Save AMXIDX instruments and fetch their reference ranges
+        saveAMXIDXInstruments(amxidxInstruments, D0_str, referenceData, historicalSettings);
+        if (snapshot.isOpen()) {
+            optidxInstruments = selectInstruments(InstrumentUniverse(snapshot), optidxQueries(D1_str, D2_str, sensexExpiryDateStr, referenceData));
+        }
 
         // Check and save OPTIDX instruments based on reference data
         checkAndSaveOPTIDXInstruments(optidxInstruments, referenceData);
@@ -643,4 +1230,4 @@ int main() {
     }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,431 @@
+#pragma once
+
+// Local store of historical candles: one memory-mapped file per (exchange,
+// token, interval) at cache/candles/<interval>/<exchange>_<token>.candles.
+//
+// A file is a CandleFileHeader followed by six fixed-capacity columns (time,
+// open, high, low, close, volume), so the candles of a date range are two
+// binary searches over the time column and are read straight from the page
+// cache. Candles newer than the last one are appended in place; anything else
+// (older candles, corrections, a full file) rewrites the file through a
+// temporary and a rename, doubling its capacity when needed.
+//
+// The header also records the days [coveredFrom, coveredTo] that have been
+// fetched completely, including days without candles, so a backfill only
+// requests the days outside that span.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+constexpr char CANDLE_FILE_MAGIC[8] = {'C', 'A', 'N', 'D', 'L', 'E', 'S', 'T'};
+constexpr uint32_t CANDLE_FILE_VERSION = 1;
+constexpr uint64_t CANDLE_DATA_OFFSET = 128;
+constexpr uint64_t CANDLE_MIN_CAPACITY = 256;
+constexpr int64_t IST_OFFSET_SECONDS = 19800;  // Exchange dates are IST days
+
+struct Candle {
+    int64_t time;  // Epoch seconds of the candle open
+    double open;
+    double high;
+    double low;
+    double close;
+    int64_t volume;
+};
+
+enum CandleColumn {
+    CANDLE_TIME,
+    CANDLE_OPEN,
+    CANDLE_HIGH,
+    CANDLE_LOW,
+    CANDLE_CLOSE,
+    CANDLE_VOLUME,
+    CANDLE_COLUMN_COUNT
+};
+
+struct CandleFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t count;
+    uint64_t capacity;     // Slots per column
+    int32_t coveredFrom;   // YYYYMMDD, 0 when nothing has been fetched
+    int32_t coveredTo;     // YYYYMMDD
+    char exchange[16];
+    char token[32];
+    char interval[32];
+};
+
+static_assert(sizeof(CandleFileHeader) <= CANDLE_DATA_OFFSET, "candle header overlaps the columns");
+
+// Days since 1970-01-01 for a proleptic Gregorian date
+inline int64_t daysFromCivil(int year, int month, int day) {
+    year -= month <= 2;
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    int64_t yearOfEra = year - era * 400;
+    int64_t dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+// YYYYMMDD for a count of days since 1970-01-01
+inline int32_t civilFromDays(int64_t days) {
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    int64_t dayOfEra = days - era * 146097;
+    int64_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    int64_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    int64_t monthIndex = (5 * dayOfYear + 2) / 153;
+    int64_t day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+    int64_t month = monthIndex + (monthIndex < 10 ? 3 : -9);
+    int64_t year = yearOfEra + era * 400 + (month <= 2);
+    return static_cast<int32_t>(year * 10000 + month * 100 + day);
+}
+
+inline int64_t dateToDays(int32_t date) {
+    return daysFromCivil(date / 10000, date / 100 % 100, date % 100);
+}
+
+inline int32_t addDays(int32_t date, int64_t days) {
+    return civilFromDays(dateToDays(date) + days);
+}
+
+// Epoch seconds at the start of an IST day
+inline int64_t istDayStart(int32_t date) {
+    return dateToDays(date) * 86400 - IST_OFFSET_SECONDS;
+}
+
+// IST day (YYYYMMDD) containing an epoch second
+inline int32_t istDate(int64_t epoch) {
+    int64_t local = epoch + IST_OFFSET_SECONDS;
+    return civilFromDays(local >= 0 ? local / 86400 : (local - 86399) / 86400);
+}
+
+// "2026-10-15" (optionally followed by a time) to 20261015; 0 if malformed
+inline int32_t parseIsoDate(const std::string& text) {
+    int year = 0, month = 0, day = 0;
+    if (std::sscanf(text.c_str(), "%4d-%2d-%2d", &year, &month, &day) != 3 || month < 1 || month > 12 || day < 1 || day > 31) {
+        return 0;
+    }
+    return year * 10000 + month * 100 + day;
+}
+
+// 20261015 to "2026-10-15"
+inline std::string formatIsoDate(int32_t date) {
+    char text[16];
+    std::snprintf(text, sizeof(text), "%04d-%02d-%02d", date / 10000, date / 100 % 100, date % 100);
+    return text;
+}
+
+// "2026-10-15T09:15:00+05:30" to epoch seconds; false if malformed
+inline bool parseCandleTime(const std::string& text, int64_t& epoch) {
+    int year, month, day, hour, minute, second, offsetHour, offsetMinute;
+    char sign;
+    if (std::sscanf(text.c_str(), "%4d-%2d-%2dT%2d:%2d:%2d%c%2d:%2d",
+                    &year, &month, &day, &hour, &minute, &second, &sign, &offsetHour, &offsetMinute) != 9 ||
+        (sign != '+' && sign != '-')) {
+        return false;
+    }
+    int64_t offset = (offsetHour * 3600 + offsetMinute * 60) * (sign == '+' ? 1 : -1);
+    epoch = daysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second - offset;
+    return true;
+}
+
+// Longest span getCandleData serves in one request for an interval, in days;
+// 0 for an interval it does not know
+inline int maxCandleRequestDays(const std::string& interval) {
+    static const std::map<std::string, int> limits = {
+        {"ONE_MINUTE", 30}, {"THREE_MINUTE", 60}, {"FIVE_MINUTE", 100}, {"TEN_MINUTE", 100},
+        {"FIFTEEN_MINUTE", 200}, {"THIRTY_MINUTE", 200}, {"ONE_HOUR", 400}, {"ONE_DAY", 2000}};
+    auto it = limits.find(interval);
+    return it == limits.end() ? 0 : it->second;
+}
+
+class CandleSeries {
+public:
+    CandleSeries() = default;
+    CandleSeries(const CandleSeries&) = delete;
+    CandleSeries& operator=(const CandleSeries&) = delete;
+
+    ~CandleSeries() {
+        close();
+    }
+
+    // Maps the file at path read-write, creating an empty series if it does
+    // not exist yet
+    bool open(const std::string& path, const std::string& exchange, const std::string& token, const std::string& interval, std::string& error) {
+        close();
+        path_ = path;
+        exchange_ = exchange;
+        token_ = token;
+        interval_ = interval;
+        if (!std::filesystem::exists(path_) && !rewrite({}, CANDLE_MIN_CAPACITY, 0, 0, error)) {
+            return false;
+        }
+        return map(error);
+    }
+
+    void close() {
+        if (base_) {
+            munmap(base_, mappedSize_);
+        }
+        base_ = nullptr;
+        header_ = nullptr;
+        mappedSize_ = 0;
+    }
+
+    bool isOpen() const { return header_ != nullptr; }
+    size_t size() const { return header_->count; }
+    const CandleFileHeader& header() const { return *header_; }
+    const std::string& path() const { return path_; }
+
+    const int64_t* times() const { return column<int64_t>(CANDLE_TIME); }
+    const double* opens() const { return column<double>(CANDLE_OPEN); }
+    const double* highs() const { return column<double>(CANDLE_HIGH); }
+    const double* lows() const { return column<double>(CANDLE_LOW); }
+    const double* closes() const { return column<double>(CANDLE_CLOSE); }
+    const int64_t* volumes() const { return column<int64_t>(CANDLE_VOLUME); }
+
+    Candle at(size_t i) const {
+        return {times()[i], opens()[i], highs()[i], lows()[i], closes()[i], volumes()[i]};
+    }
+
+    // Index of the first candle at or after time
+    size_t lowerBound(int64_t time) const {
+        return std::lower_bound(times(), times() + size(), time) - times();
+    }
+
+    // Index range of the candles on the IST days [fromDate, toDate]
+    std::pair<size_t, size_t> days(int32_t fromDate, int32_t toDate) const {
+        return {lowerBound(istDayStart(fromDate)), lowerBound(istDayStart(addDays(toDate, 1)))};
+    }
+
+    bool covers(int32_t fromDate, int32_t toDate) const {
+        return header_->coveredFrom != 0 && header_->coveredFrom <= fromDate && toDate <= header_->coveredTo;
+    }
+
+    // Merges candles into the series; a candle at an existing time replaces it
+    bool append(std::vector<Candle> candles, std::string& error) {
+        if (!isOpen()) {
+            error = path_ + " is not open";
+            return false;
+        }
+        if (candles.empty()) {
+            return true;
+        }
+        std::stable_sort(candles.begin(), candles.end(), [](const Candle& a, const Candle& b) { return a.time < b.time; });
+        candles.erase(std::unique(candles.begin(), candles.end(), [](const Candle& a, const Candle& b) { return a.time == b.time; }), candles.end());
+
+        uint64_t count = header_->count;
+        if ((count == 0 || candles.front().time > times()[count - 1]) && count + candles.size() <= header_->capacity) {
+            for (size_t i = 0; i < candles.size(); ++i) {
+                const Candle& candle = candles[i];
+                column<int64_t>(CANDLE_TIME)[count + i] = candle.time;
+                column<double>(CANDLE_OPEN)[count + i] = candle.open;
+                column<double>(CANDLE_HIGH)[count + i] = candle.high;
+                column<double>(CANDLE_LOW)[count + i] = candle.low;
+                column<double>(CANDLE_CLOSE)[count + i] = candle.close;
+                column<int64_t>(CANDLE_VOLUME)[count + i] = candle.volume;
+            }
+            header_->count = count + candles.size();  // Published after the rows
+            return true;
+        }
+
+        // New candles first, so they win over stored ones at the same time
+        std::vector<Candle> merged = candles;
+        for (size_t i = 0; i < count; ++i) {
+            merged.push_back(at(i));
+        }
+        std::stable_sort(merged.begin(), merged.end(), [](const Candle& a, const Candle& b) { return a.time < b.time; });
+        merged.erase(std::unique(merged.begin(), merged.end(), [](const Candle& a, const Candle& b) { return a.time == b.time; }), merged.end());
+
+        uint64_t capacity = std::max<uint64_t>(header_->capacity, CANDLE_MIN_CAPACITY);
+        while (capacity < merged.size()) {
+            capacity *= 2;
+        }
+        // The new file is written and mapped beside the old one and only then
+        // renamed over it, so on any failure the series keeps its old mapping
+        std::string tempPath = path_ + ".tmp";
+        char* base = nullptr;
+        size_t mappedSize = 0;
+        if (!writeImage(tempPath, merged, capacity, header_->coveredFrom, header_->coveredTo, error) ||
+            !mapFile(tempPath, base, mappedSize, error)) {
+            std::remove(tempPath.c_str());
+            return false;
+        }
+        if (std::rename(tempPath.c_str(), path_.c_str()) != 0) {
+            munmap(base, mappedSize);
+            std::remove(tempPath.c_str());
+            error = "failed to rename " + tempPath + " to " + path_;
+            return false;
+        }
+        close();
+        base_ = base;
+        mappedSize_ = mappedSize;
+        header_ = reinterpret_cast<CandleFileHeader*>(base_);
+        return true;
+    }
+
+    // Records that every candle on the days [fromDate, toDate] is stored; the
+    // caller keeps the covered span contiguous
+    void markCovered(int32_t fromDate, int32_t toDate) {
+        if (header_->coveredFrom == 0) {
+            header_->coveredFrom = fromDate;
+            header_->coveredTo = toDate;
+            return;
+        }
+        header_->coveredFrom = std::min(header_->coveredFrom, fromDate);
+        header_->coveredTo = std::max(header_->coveredTo, toDate);
+    }
+
+private:
+    std::string path_;
+    std::string exchange_;
+    std::string token_;
+    std::string interval_;
+    char* base_ = nullptr;
+    size_t mappedSize_ = 0;
+    CandleFileHeader* header_ = nullptr;
+
+    template <typename T>
+    T* column(CandleColumn c) const {
+        return reinterpret_cast<T*>(base_ + CANDLE_DATA_OFFSET + static_cast<uint64_t>(c) * header_->capacity * sizeof(int64_t));
+    }
+
+    static uint64_t fileSize(uint64_t capacity) {
+        return CANDLE_DATA_OFFSET + CANDLE_COLUMN_COUNT * capacity * sizeof(int64_t);
+    }
+
+    bool map(std::string& error) {
+        if (!mapFile(path_, base_, mappedSize_, error)) {
+            return false;
+        }
+        header_ = reinterpret_cast<CandleFileHeader*>(base_);
+        return true;
+    }
+
+    // Maps a candle file read-write and checks its header
+    static bool mapFile(const std::string& path, char*& base, size_t& mappedSize, std::string& error) {
+        int fd = ::open(path.c_str(), O_RDWR);
+        if (fd < 0) {
+            error = "cannot open " + path;
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < CANDLE_DATA_OFFSET) {
+            ::close(fd);
+            error = path + " is not a candle file";
+            return false;
+        }
+        void* mapped = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            error = "cannot map " + path;
+            return false;
+        }
+
+        const CandleFileHeader* header = static_cast<const CandleFileHeader*>(mapped);
+        if (std::memcmp(header->magic, CANDLE_FILE_MAGIC, sizeof(header->magic)) != 0 ||
+            header->version != CANDLE_FILE_VERSION || fileSize(header->capacity) != static_cast<size_t>(st.st_size) ||
+            header->count > header->capacity) {
+            munmap(mapped, st.st_size);
+            error = path + " is not a candle file of this version";
+            return false;
+        }
+        base = static_cast<char*>(mapped);
+        mappedSize = st.st_size;
+        return true;
+    }
+
+    bool rewrite(const std::vector<Candle>& candles, uint64_t capacity, int32_t coveredFrom, int32_t coveredTo, std::string& error) {
+        std::string tempPath = path_ + ".tmp";
+        if (!writeImage(tempPath, candles, capacity, coveredFrom, coveredTo, error)) {
+            return false;
+        }
+        if (std::rename(tempPath.c_str(), path_.c_str()) != 0) {
+            error = "failed to rename " + tempPath + " to " + path_;
+            return false;
+        }
+        return true;
+    }
+
+    bool writeImage(const std::string& filePath, const std::vector<Candle>& candles, uint64_t capacity,
+                    int32_t coveredFrom, int32_t coveredTo, std::string& error) const {
+        std::vector<char> image(fileSize(capacity), 0);
+        CandleFileHeader& header = *reinterpret_cast<CandleFileHeader*>(image.data());
+        std::memcpy(header.magic, CANDLE_FILE_MAGIC, sizeof(header.magic));
+        header.version = CANDLE_FILE_VERSION;
+        header.count = candles.size();
+        header.capacity = capacity;
+        header.coveredFrom = coveredFrom;
+        header.coveredTo = coveredTo;
+        std::snprintf(header.exchange, sizeof(header.exchange), "%s", exchange_.c_str());
+        std::snprintf(header.token, sizeof(header.token), "%s", token_.c_str());
+        std::snprintf(header.interval, sizeof(header.interval), "%s", interval_.c_str());
+
+        char* columns = image.data() + CANDLE_DATA_OFFSET;
+        for (size_t i = 0; i < candles.size(); ++i) {
+            const Candle& candle = candles[i];
+            reinterpret_cast<int64_t*>(columns)[i] = candle.time;
+            reinterpret_cast<double*>(columns + 1 * capacity * sizeof(int64_t))[i] = candle.open;
+            reinterpret_cast<double*>(columns + 2 * capacity * sizeof(int64_t))[i] = candle.high;
+            reinterpret_cast<double*>(columns + 3 * capacity * sizeof(int64_t))[i] = candle.low;
+            reinterpret_cast<double*>(columns + 4 * capacity * sizeof(int64_t))[i] = candle.close;
+            reinterpret_cast<int64_t*>(columns + 5 * capacity * sizeof(int64_t))[i] = candle.volume;
+        }
+
+        std::filesystem::path directory = std::filesystem::path(path_).parent_path();
+        if (!directory.empty() && !std::filesystem::exists(directory)) {
+            std::filesystem::create_directories(directory);
+        }
+        std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+        file.write(image.data(), image.size());
+        file.close();
+        if (!file) {
+            error = "failed to write " + filePath;
+            return false;
+        }
+        return true;
+    }
+};
+
+class CandleStore {
+public:
+    explicit CandleStore(std::string root = "cache/candles") : root_(std::move(root)) {}
+
+    std::string path(const std::string& exchange, const std::string& token, const std::string& interval) const {
+        return root_ + "/" + interval + "/" + exchange + "_" + token + ".candles";
+    }
+
+    // Series for a key, opened (or created) on first use and kept open;
+    // nullptr with error set if the file cannot be used
+    CandleSeries* series(const std::string& exchange, const std::string& token, const std::string& interval, std::string& error) {
+        std::string key = path(exchange, token, interval);
+        std::unique_ptr<CandleSeries>& series = series_[key];
+        if (!series) {
+            series.reset(new CandleSeries());
+        }
+        if (!series->isOpen() && !series->open(key, exchange, token, interval, error)) {
+            return nullptr;
+        }
+        return series.get();
+    }
+
+private:
+    std::string root_;
+    std::map<std::string, std::unique_ptr<CandleSeries>> series_;
+};
@@ -0,0 +1,290 @@
+#pragma once
+
+// Concurrent, rate-limited client for AngelOne's historical candle API.
+//
+// All requests run on one curl multi handle with a fixed pool of easy
+// handles, so connections are kept alive and reused (and multiplexed when the
+// server speaks HTTP/2) instead of one blocking perform per instrument. One
+// token bucket per documented limit (getCandleData: 3 requests/s and 180/min)
+// decides when the next request may start, replacing fixed sleeps. HTTP 429,
+// 5xx and transport errors are retried with jittered exponential backoff,
+// honouring Retry-After when the server sends it.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+#include <curl/curl.h>
+
+class TokenBucket {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    TokenBucket(double ratePerSecond, double capacity)
+        : rate_(ratePerSecond), capacity_(capacity), tokens_(capacity), updated_(Clock::now()) {}
+
+    // Time until a token is available; zero when take() would succeed now
+    Clock::duration delay(Clock::time_point now) {
+        refill(now);
+        if (tokens_ >= 1.0) {
+            return Clock::duration::zero();
+        }
+        return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>((1.0 - tokens_) / rate_)) + std::chrono::microseconds(1);
+    }
+
+    bool take(Clock::time_point now) {
+        refill(now);
+        if (tokens_ < 1.0) {
+            return false;
+        }
+        tokens_ -= 1.0;
+        return true;
+    }
+
+private:
+    double rate_;
+    double capacity_;
+    double tokens_;
+    Clock::time_point updated_;
+
+    void refill(Clock::time_point now) {
+        if (now <= updated_) {
+            return;
+        }
+        tokens_ = std::min(capacity_, tokens_ + std::chrono::duration<double>(now - updated_).count() * rate_);
+        updated_ = now;
+    }
+};
+
+struct CandleRequest {
+    std::string symbol;
+    std::string payload;  // JSON body for getCandleData
+};
+
+struct CandleResponse {
+    CURLcode result = CURLE_OK;
+    long status = 0;
+    std::string body;
+    int attempts = 0;
+};
+
+struct HistoricalFetcherSettings {
+    std::string url = "https://apiconnect.angelone.in/rest/secure/angelbroking/historical/v1/getCandleData";
+    double requestsPerSecond = 3;
+    double requestsPerMinute = 180;
+    int maxInFlight = 3;
+    int maxAttempts = 4;
+    long retryBaseMs = 500;
+    long retryMaxMs = 8000;
+    long timeoutMs = 15000;
+};
+
+class HistoricalFetcher {
+public:
+    typedef TokenBucket::Clock Clock;
+    typedef std::function<void(size_t index, const CandleResponse& response)> ResponseCallback;
+
+    // headers are sent with every request; build them once per run
+    HistoricalFetcher(const HistoricalFetcherSettings& settings, const std::vector<std::string>& headers)
+        : settings_(settings),
+          perSecond_(settings.requestsPerSecond, 1),  // Paced, so no sliding second sees a burst
+          perMinute_(settings.requestsPerMinute / 60.0, settings.requestsPerMinute),
+          rng_(std::random_device{}()) {
+        for (const auto& header : headers) {
+            headers_ = curl_slist_append(headers_, header.c_str());
+        }
+        multi_ = curl_multi_init();
+        curl_multi_setopt(multi_, CURLMOPT_MAX_HOST_CONNECTIONS, static_cast<long>(settings_.maxInFlight));
+        slots_.resize(std::max(1, settings_.maxInFlight));
+        for (auto& slot : slots_) {
+            slot.curl = curl_easy_init();
+        }
+    }
+
+    ~HistoricalFetcher() {
+        for (auto& slot : slots_) {
+            if (slot.active) {
+                curl_multi_remove_handle(multi_, slot.curl);
+            }
+            curl_easy_cleanup(slot.curl);
+        }
+        curl_multi_cleanup(multi_);
+        curl_slist_free_all(headers_);
+    }
+
+    HistoricalFetcher(const HistoricalFetcher&) = delete;
+    HistoricalFetcher& operator=(const HistoricalFetcher&) = delete;
+
+    // Runs every request to completion. onResponse is called once per
+    // request, in completion order, with its final response.
+    void fetch(const std::vector<CandleRequest>& requests, ResponseCallback onResponse) {
+        std::deque<size_t> ready;
+        for (size_t i = 0; i < requests.size(); ++i) {
+            ready.push_back(i);
+        }
+        std::vector<int> attempts(requests.size(), 0);
+        std::vector<Retry> retries;
+        size_t remaining = requests.size();
+
+        while (remaining > 0) {
+            Clock::time_point now = Clock::now();
+
+            // Retries whose backoff has elapsed go ahead of untried requests
+            for (auto it = retries.begin(); it != retries.end();) {
+                if (it->due <= now) {
+                    ready.push_front(it->index);
+                    it = retries.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+
+            Clock::duration wait = std::chrono::milliseconds(100);
+            while (!ready.empty()) {
+                Slot* slot = freeSlot();
+                if (!slot) {
+                    break;
+                }
+                Clock::duration limit = std::max(perSecond_.delay(now), perMinute_.delay(now));
+                if (limit > Clock::duration::zero()) {
+                    wait = std::min(wait, limit);
+                    break;
+                }
+                perSecond_.take(now);
+                perMinute_.take(now);
+                size_t index = ready.front();
+                ready.pop_front();
+                ++attempts[index];
+                start(*slot, index, requests[index]);
+            }
+            for (const auto& retry : retries) {
+                wait = std::min(wait, retry.due - now);
+            }
+
+            int running = 0;
+            curl_multi_perform(multi_, &running);
+
+            int queued = 0;
+            while (CURLMsg* message = curl_multi_info_read(multi_, &queued)) {
+                if (message->msg != CURLMSG_DONE) {
+                    continue;
+                }
+                Slot& slot = slotFor(message->easy_handle);
+                CandleResponse response;
+                response.result = message->data.result;
+                curl_easy_getinfo(slot.curl, CURLINFO_RESPONSE_CODE, &response.status);
+                response.attempts = attempts[slot.index];
+                curl_multi_remove_handle(multi_, slot.curl);
+                slot.active = false;
+
+                if (retryable(response) && response.attempts < settings_.maxAttempts) {
+                    ++retried_;
+                    retries.push_back({Clock::now() + backoff(slot, response.attempts), slot.index});
+                    continue;
+                }
+                response.body = std::move(slot.body);
+                --remaining;
+                onResponse(slot.index, response);
+            }
+
+            if (remaining > 0) {
+                int waitMs = static_cast<int>(std::max<int64_t>(1, std::chrono::duration_cast<std::chrono::milliseconds>(wait).count()));
+#if LIBCURL_VERSION_NUM >= 0x074200
+                curl_multi_poll(multi_, nullptr, 0, waitMs, nullptr);
+#else
+                curl_multi_wait(multi_, nullptr, 0, waitMs, nullptr);
+#endif
+            }
+        }
+    }
+
+    // Requests retried after a 429, 5xx or transport error
+    uint64_t retries() const { return retried_; }
+
+private:
+    struct Slot {
+        CURL* curl = nullptr;
+        bool active = false;
+        size_t index = 0;
+        std::string body;
+    };
+
+    struct Retry {
+        Clock::time_point due;
+        size_t index;
+    };
+
+    HistoricalFetcherSettings settings_;
+    TokenBucket perSecond_;
+    TokenBucket perMinute_;
+    std::mt19937 rng_;
+    curl_slist* headers_ = nullptr;
+    CURLM* multi_ = nullptr;
+    std::vector<Slot> slots_;
+    uint64_t retried_ = 0;
+
+    static size_t writeBody(void* contents, size_t size, size_t nmemb, void* userp) {
+        static_cast<std::string*>(userp)->append(static_cast<char*>(contents), size * nmemb);
+        return size * nmemb;
+    }
+
+    static bool retryable(const CandleResponse& response) {
+        return response.result != CURLE_OK || response.status == 429 || response.status >= 500;
+    }
+
+    Slot* freeSlot() {
+        for (auto& slot : slots_) {
+            if (!slot.active) {
+                return &slot;
+            }
+        }
+        return nullptr;
+    }
+
+    Slot& slotFor(CURL* curl) {
+        for (auto& slot : slots_) {
+            if (slot.curl == curl) {
+                return slot;
+            }
+        }
+        return slots_.front();
+    }
+
+    // Options are set on every start because the payload changes; the easy
+    // handle itself is reused, which keeps its connection
+    void start(Slot& slot, size_t index, const CandleRequest& request) {
+        slot.index = index;
+        slot.body.clear();
+        slot.active = true;
+        curl_easy_setopt(slot.curl, CURLOPT_URL, settings_.url.c_str());
+        curl_easy_setopt(slot.curl, CURLOPT_HTTPHEADER, headers_);
+        curl_easy_setopt(slot.curl, CURLOPT_POSTFIELDS, request.payload.c_str());
+        curl_easy_setopt(slot.curl, CURLOPT_WRITEFUNCTION, writeBody);
+        curl_easy_setopt(slot.curl, CURLOPT_WRITEDATA, &slot.body);
+        curl_easy_setopt(slot.curl, CURLOPT_TCP_KEEPALIVE, 1L);
+        curl_easy_setopt(slot.curl, CURLOPT_TIMEOUT_MS, settings_.timeoutMs);
+        curl_easy_setopt(slot.curl, CURLOPT_NOSIGNAL, 1L);
+        curl_multi_add_handle(multi_, slot.curl);
+    }
+
+    // Exponential backoff scaled by a random factor in [0.5, 1.5) so that
+    // retries from parallel requests spread out
+    Clock::duration backoff(const Slot& slot, int attempt) {
+        double base = static_cast<double>(settings_.retryBaseMs) * static_cast<double>(1L << std::min(attempt - 1, 16));
+        base = std::min(base, static_cast<double>(settings_.retryMaxMs));
+        double delayMs = base * std::uniform_real_distribution<double>(0.5, 1.5)(rng_);
+#if LIBCURL_VERSION_NUM >= 0x074200
+        curl_off_t retryAfter = 0;
+        if (curl_easy_getinfo(slot.curl, CURLINFO_RETRY_AFTER, &retryAfter) == CURLE_OK && retryAfter > 0) {
+            delayMs = std::max(delayMs, static_cast<double>(retryAfter) * 1000.0);
+        }
+#else
+        (void)slot;
+#endif
+        return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(delayMs));
+    }
+};
@@ -0,0 +1,194 @@
+#pragma once
+
+// Query engine over a scrip master snapshot.
+//
+// Rows are found through the snapshot's query index, which is sorted by
+// (instrumenttype, name, exch_seg, expiry, strike). A query pins a prefix of
+// those keys, so its rows are one contiguous index range found with two
+// binary searches: selection costs O(log N + result), not O(universe), and a
+// strike window can be re-selected on every index move.
+//
+//   InstrumentQuery query;
+//   query.instrumentType = "OPTIDX";
+//   query.name = "SENSEX";
+//   query.segment = "BFO";
+//   query.expiry = 20261016;
+//   query.strikeFrom = 8100000;   // scrip master strikes are x100
+//   query.strikeTo = 8300000;     // exclusive
+//   universe.select(query, rows);
+//
+// Keys left unset match anything. Set keys after the first unset one (e.g. a
+// fixed expiry with any segment) are checked row by row within the range.
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+#include "ScripSnapshot.hpp"
+
+constexpr int32_t ANY_EXPIRY = std::numeric_limits<int32_t>::min();
+
+struct InstrumentQuery {
+    std::string instrumentType;    // Empty matches any
+    std::string name;              // Empty matches any
+    std::string segment;           // Empty matches any
+    int32_t expiry = ANY_EXPIRY;   // YYYYMMDD; 0 selects rows without an expiry
+    double strikeFrom = -std::numeric_limits<double>::infinity();  // Inclusive
+    double strikeTo = std::numeric_limits<double>::infinity();     // Exclusive
+};
+
+class InstrumentUniverse {
+public:
+    explicit InstrumentUniverse(const ScripSnapshot& snapshot)
+        : snapshot_(snapshot),
+          index_(snapshot.queryIndex()),
+          types_(snapshot.column(SCRIP_INSTRUMENTTYPE)),
+          names_(snapshot.column(SCRIP_NAME)),
+          segments_(snapshot.column(SCRIP_EXCH_SEG)),
+          expiries_(snapshot.expiryDates()),
+          strikes_(snapshot.strikes()) {
+    }
+
+    const ScripSnapshot& snapshot() const { return snapshot_; }
+    uint32_t size() const { return snapshot_.size(); }
+
+    // Appends the snapshot rows matching the query in index order, so strikes
+    // ascend within one expiry. Returns the number of rows appended.
+    size_t select(const InstrumentQuery& query, std::vector<uint32_t>& rows) const {
+        Key key;
+        if (!resolve(query, key)) {
+            return 0;
+        }
+
+        // The pinned prefix bounds the range; the strike range joins the bound
+        // only when every key before it is pinned
+        int fixed = 0;
+        while (fixed < KEY_COUNT && key.set[fixed]) {
+            ++fixed;
+        }
+        bool strikeBound = fixed == KEY_COUNT;
+        uint32_t begin = partitionPoint([&](uint32_t row) {
+            int order = compare(row, key, fixed);
+            return order < 0 || (order == 0 && strikeBound && strikes_[row] < query.strikeFrom);
+        });
+        uint32_t end = partitionPoint([&](uint32_t row) {
+            int order = compare(row, key, fixed);
+            return order < 0 || (order == 0 && (!strikeBound || strikes_[row] < query.strikeTo));
+        });
+
+        bool checkRows = !strikeBound;
+        size_t before = rows.size();
+        for (uint32_t i = begin; i < end; ++i) {
+            uint32_t row = index_[i];
+            if (checkRows && !matches(row, key, query)) {
+                continue;
+            }
+            rows.push_back(row);
+        }
+        return rows.size() - before;
+    }
+
+    // Distinct expiries, ascending, for one instrument type, name and segment
+    std::vector<int32_t> expiries(const std::string& instrumentType, const std::string& name, const std::string& segment) const {
+        std::vector<int32_t> result;
+        InstrumentQuery query;
+        query.instrumentType = instrumentType;
+        query.name = name;
+        query.segment = segment;
+        Key key;
+        if (!resolve(query, key) || !key.set[0] || !key.set[1] || !key.set[2]) {
+            return result;
+        }
+        uint32_t end = partitionPoint([&](uint32_t row) { return compare(row, key, 3) <= 0; });
+        uint32_t i = partitionPoint([&](uint32_t row) { return compare(row, key, 3) < 0; });
+        while (i < end) {
+            key.expiry = expiries_[index_[i]];
+            result.push_back(key.expiry);
+            // Skip every strike of this expiry
+            i = partitionPoint([&](uint32_t row) { return compare(row, key, KEY_COUNT) <= 0; });
+        }
+        return result;
+    }
+
+private:
+    static constexpr int KEY_COUNT = 4;  // instrumenttype, name, exch_seg, expiry
+
+    struct Key {
+        uint32_t ids[3] = {0, 0, 0};
+        int32_t expiry = 0;
+        bool set[KEY_COUNT] = {false, false, false, false};
+    };
+
+    const ScripSnapshot& snapshot_;
+    const uint32_t* index_;
+    const uint32_t* types_;
+    const uint32_t* names_;
+    const uint32_t* segments_;
+    const int32_t* expiries_;
+    const double* strikes_;
+
+    // Maps query strings to snapshot ids; false if a set key names a string
+    // no record uses, since then nothing can match
+    bool resolve(const InstrumentQuery& query, Key& key) const {
+        const std::string* values[3] = {&query.instrumentType, &query.name, &query.segment};
+        for (int i = 0; i < 3; ++i) {
+            if (values[i]->empty()) {
+                continue;
+            }
+            key.ids[i] = snapshot_.findString(*values[i]);
+            if (key.ids[i] == ScripSnapshot::NOT_FOUND) {
+                return false;
+            }
+            key.set[i] = true;
+        }
+        if (query.expiry != ANY_EXPIRY) {
+            key.expiry = query.expiry;
+            key.set[3] = true;
+        }
+        return true;
+    }
+
+    // Orders a row against the first `fixed` keys: <0 before, 0 equal, >0 after
+    int compare(uint32_t row, const Key& key, int fixed) const {
+        const uint32_t ids[3] = {types_[row], names_[row], segments_[row]};
+        for (int i = 0; i < fixed && i < 3; ++i) {
+            if (ids[i] != key.ids[i]) {
+                return ids[i] < key.ids[i] ? -1 : 1;
+            }
+        }
+        if (fixed == KEY_COUNT && expiries_[row] != key.expiry) {
+            return expiries_[row] < key.expiry ? -1 : 1;
+        }
+        return 0;
+    }
+
+    bool matches(uint32_t row, const Key& key, const InstrumentQuery& query) const {
+        const uint32_t ids[3] = {types_[row], names_[row], segments_[row]};
+        for (int i = 0; i < 3; ++i) {
+            if (key.set[i] && ids[i] != key.ids[i]) {
+                return false;
+            }
+        }
+        if (key.set[3] && expiries_[row] != key.expiry) {
+            return false;
+        }
+        return strikes_[row] >= query.strikeFrom && strikes_[row] < query.strikeTo;
+    }
+
+    // First index position whose row fails the predicate; the predicate must
+    // hold for a prefix of the index and fail for the rest
+    template <typename Predicate>
+    uint32_t partitionPoint(Predicate predicate) const {
+        uint32_t low = 0;
+        uint32_t high = snapshot_.size();
+        while (low < high) {
+            uint32_t mid = low + (high - low) / 2;
+            if (predicate(index_[mid])) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        return low;
+    }
+};
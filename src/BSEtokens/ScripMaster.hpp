@@ -0,0 +1,379 @@
+#pragma once
+
+// Streaming reader for OpenAPIScripMaster.json.
+//
+// The scrip master is one JSON array of flat objects whose values are all
+// strings. ScripMasterParser is a push parser: feed() accepts the document in
+// arbitrary chunks (e.g. straight from a curl write callback) and hands each
+// completed object to a callback as a ScripRecord, so memory use is bounded by
+// the largest record rather than the document. Unknown keys and nested values
+// are skipped.
+
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <nlohmann/json.hpp>
+
+struct ScripRecord {
+    std::string token;
+    std::string symbol;
+    std::string name;
+    std::string expiry;
+    std::string strike;
+    std::string lotsize;
+    std::string instrumenttype;
+    std::string exch_seg;
+    std::string tick_size;
+
+    uint32_t tokenId() const { return static_cast<uint32_t>(std::strtoul(token.c_str(), nullptr, 10)); }
+    double strikePrice() const { return std::strtod(strike.c_str(), nullptr); }
+    int lotSize() const { return std::atoi(lotsize.c_str()); }
+
+    void clear() {
+        token.clear();
+        symbol.clear();
+        name.clear();
+        expiry.clear();
+        strike.clear();
+        lotsize.clear();
+        instrumenttype.clear();
+        exch_seg.clear();
+        tick_size.clear();
+    }
+
+    // Field for a scrip master key, or nullptr if the key is not kept
+    std::string* field(const std::string& key) {
+        switch (key.size()) {
+            case 4: return key == "name" ? &name : nullptr;
+            case 5: return key == "token" ? &token : nullptr;
+            case 6: return key == "symbol" ? &symbol : key == "expiry" ? &expiry : key == "strike" ? &strike : nullptr;
+            case 7: return key == "lotsize" ? &lotsize : nullptr;
+            case 8: return key == "exch_seg" ? &exch_seg : nullptr;
+            case 9: return key == "tick_size" ? &tick_size : nullptr;
+            case 14: return key == "instrumenttype" ? &instrumenttype : nullptr;
+            default: return nullptr;
+        }
+    }
+
+    static ScripRecord fromJson(const nlohmann::json& item) {
+        ScripRecord record;
+        for (auto it = item.begin(); it != item.end(); ++it) {
+            if (std::string* value = record.field(it.key())) {
+                *value = it->is_string() ? it->get<std::string>() : it->dump();
+            }
+        }
+        return record;
+    }
+};
+
+// Quotes a value the way nlohmann::json prints a string, so CSVs written from
+// ScripRecords match the ones written from the DOM byte for byte.
+inline std::string jsonQuoted(const std::string& value) {
+    std::string out;
+    out.reserve(value.size() + 2);
+    out += '"';
+    for (unsigned char c : value) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    static const char hex[] = "0123456789abcdef";
+                    out += "\\u00";
+                    out += hex[c >> 4];
+                    out += hex[c & 0xF];
+                } else {
+                    out += static_cast<char>(c);
+                }
+        }
+    }
+    out += '"';
+    return out;
+}
+
+class ScripMasterParser {
+public:
+    typedef std::function<void(const ScripRecord&)> RecordCallback;
+
+    explicit ScripMasterParser(RecordCallback onRecord) : onRecord_(std::move(onRecord)) {}
+
+    // Consumes the next chunk of the document. Returns false on a syntax
+    // error; error() then describes it and further input is ignored.
+    bool feed(const char* data, size_t size) {
+        for (size_t i = 0; i < size && state_ != State::Error; ++i) {
+            step(data[i]);
+            ++offset_;
+        }
+        bytes_ += size;
+        return state_ != State::Error;
+    }
+
+    // True once the closing ']' of the top-level array has been seen.
+    bool finish() {
+        if (state_ != State::Done && state_ != State::Error) {
+            fail("unexpected end of document");
+        }
+        return state_ == State::Done;
+    }
+
+    const std::string& error() const { return error_; }
+    uint64_t records() const { return records_; }
+    uint64_t bytes() const { return bytes_; }
+
+private:
+    enum class State {
+        ArrayStart, ObjectStart, KeyStart, KeyOrObjectEnd, Colon, ValueStart,
+        String, Literal, Nested, ValueEnd, ObjectEnd, Done, Error
+    };
+
+    RecordCallback onRecord_;
+    ScripRecord record_;
+    std::string key_;
+    std::string* target_ = nullptr;  // Field receiving the current value, if kept
+    State state_ = State::ArrayStart;
+    State afterString_ = State::ValueEnd;
+    bool escape_ = false;
+    int unicodeDigits_ = -1;         // Hex digits still expected in a \uXXXX escape
+    uint32_t unicode_ = 0;
+    uint32_t highSurrogate_ = 0;
+    int nestedDepth_ = 0;
+    bool nestedInString_ = false;
+    bool emptyArray_ = true;
+    uint64_t records_ = 0;
+    uint64_t bytes_ = 0;
+    uint64_t offset_ = 0;
+    std::string error_;
+
+    static bool isSpace(char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; }
+
+    void fail(const std::string& message) {
+        error_ = "scrip master parse error at byte " + std::to_string(offset_) + ": " + message;
+        state_ = State::Error;
+    }
+
+    void beginString(std::string* target, State after) {
+        target_ = target;
+        if (target_) {
+            target_->clear();
+        }
+        afterString_ = after;
+        escape_ = false;
+        unicodeDigits_ = -1;
+        highSurrogate_ = 0;
+        state_ = State::String;
+    }
+
+    void append(char c) {
+        if (target_) {
+            *target_ += c;
+        }
+    }
+
+    void appendUtf8(uint32_t cp) {
+        if (cp < 0x80) {
+            append(static_cast<char>(cp));
+        } else if (cp < 0x800) {
+            append(static_cast<char>(0xC0 | (cp >> 6)));
+            append(static_cast<char>(0x80 | (cp & 0x3F)));
+        } else if (cp < 0x10000) {
+            append(static_cast<char>(0xE0 | (cp >> 12)));
+            append(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+            append(static_cast<char>(0x80 | (cp & 0x3F)));
+        } else {
+            append(static_cast<char>(0xF0 | (cp >> 18)));
+            append(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+            append(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+            append(static_cast<char>(0x80 | (cp & 0x3F)));
+        }
+    }
+
+    void stringChar(char c) {
+        if (unicodeDigits_ >= 0) {
+            int digit = (c >= '0' && c <= '9') ? c - '0'
+                      : (c >= 'a' && c <= 'f') ? c - 'a' + 10
+                      : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+            if (digit < 0) {
+                fail("bad \\u escape");
+                return;
+            }
+            unicode_ = (unicode_ << 4) | static_cast<uint32_t>(digit);
+            if (--unicodeDigits_ == 0) {
+                unicodeDigits_ = -1;
+                if (unicode_ >= 0xD800 && unicode_ < 0xDC00) {
+                    highSurrogate_ = unicode_;
+                } else if (unicode_ >= 0xDC00 && unicode_ < 0xE000 && highSurrogate_) {
+                    appendUtf8(0x10000 + ((highSurrogate_ - 0xD800) << 10) + (unicode_ - 0xDC00));
+                    highSurrogate_ = 0;
+                } else {
+                    appendUtf8(unicode_);
+                }
+            }
+            return;
+        }
+        if (escape_) {
+            escape_ = false;
+            switch (c) {
+                case '"': append('"'); break;
+                case '\\': append('\\'); break;
+                case '/': append('/'); break;
+                case 'b': append('\b'); break;
+                case 'f': append('\f'); break;
+                case 'n': append('\n'); break;
+                case 'r': append('\r'); break;
+                case 't': append('\t'); break;
+                case 'u': unicodeDigits_ = 4; unicode_ = 0; break;
+                default: fail("bad escape");
+            }
+            return;
+        }
+        if (c == '\\') {
+            escape_ = true;
+        } else if (c == '"') {
+            state_ = afterString_;
+        } else {
+            append(c);
+        }
+    }
+
+    void endObject() {
+        ++records_;
+        onRecord_(record_);
+        state_ = State::ObjectEnd;
+    }
+
+    void step(char c) {
+        switch (state_) {
+            case State::ArrayStart:
+                if (c == '[') {
+                    state_ = State::ObjectStart;
+                    emptyArray_ = true;
+                } else if (!isSpace(c)) {
+                    fail("expected '['");
+                }
+                break;
+
+            case State::ObjectStart:
+                if (c == '{') {
+                    record_.clear();
+                    state_ = State::KeyOrObjectEnd;
+                } else if (c == ']' && emptyArray_) {
+                    state_ = State::Done;
+                } else if (!isSpace(c)) {
+                    fail("expected '{'");
+                }
+                break;
+
+            case State::KeyOrObjectEnd:
+                if (c == '}') {
+                    endObject();
+                    break;
+                }
+                // fall through
+            case State::KeyStart:
+                if (c == '"') {
+                    key_.clear();
+                    beginString(&key_, State::Colon);
+                } else if (!isSpace(c)) {
+                    fail("expected a key");
+                }
+                break;
+
+            case State::Colon:
+                if (c == ':') {
+                    target_ = record_.field(key_);
+                    state_ = State::ValueStart;
+                } else if (!isSpace(c)) {
+                    fail("expected ':'");
+                }
+                break;
+
+            case State::ValueStart:
+                if (isSpace(c)) {
+                    break;
+                }
+                if (c == '"') {
+                    beginString(target_, State::ValueEnd);
+                } else if (c == '{' || c == '[') {
+                    nestedDepth_ = 1;
+                    nestedInString_ = false;
+                    escape_ = false;
+                    state_ = State::Nested;
+                } else if (c == '-' || (c >= '0' && c <= '9') || c == 't' || c == 'f' || c == 'n') {
+                    if (target_) {
+                        target_->assign(1, c);
+                    }
+                    state_ = State::Literal;
+                } else {
+                    fail("expected a value");
+                }
+                break;
+
+            case State::String:
+                stringChar(c);
+                break;
+
+            case State::Literal:
+                if (c == ',' || c == '}' || isSpace(c)) {
+                    state_ = State::ValueEnd;
+                    step(c);
+                } else {
+                    append(c);
+                }
+                break;
+
+            case State::Nested:
+                if (nestedInString_) {
+                    if (escape_) {
+                        escape_ = false;
+                    } else if (c == '\\') {
+                        escape_ = true;
+                    } else if (c == '"') {
+                        nestedInString_ = false;
+                    }
+                } else if (c == '"') {
+                    nestedInString_ = true;
+                } else if (c == '{' || c == '[') {
+                    ++nestedDepth_;
+                } else if ((c == '}' || c == ']') && --nestedDepth_ == 0) {
+                    state_ = State::ValueEnd;
+                }
+                break;
+
+            case State::ValueEnd:
+                if (c == ',') {
+                    state_ = State::KeyStart;
+                } else if (c == '}') {
+                    endObject();
+                } else if (!isSpace(c)) {
+                    fail("expected ',' or '}'");
+                }
+                break;
+
+            case State::ObjectEnd:
+                if (c == ',') {
+                    emptyArray_ = false;
+                    state_ = State::ObjectStart;
+                } else if (c == ']') {
+                    state_ = State::Done;
+                } else if (!isSpace(c)) {
+                    fail("expected ',' or ']'");
+                }
+                break;
+
+            case State::Done:
+                if (!isSpace(c)) {
+                    fail("trailing data after the array");
+                }
+                break;
+
+            case State::Error:
+                break;
+        }
+    }
+};
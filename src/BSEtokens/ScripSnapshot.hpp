@@ -0,0 +1,348 @@
+#pragma once
+
+// Columnar binary snapshot of the scrip master.
+//
+// One snapshot holds every scrip master record as parallel columns: nine
+// string-id columns (one per ScripRecord field) plus numeric token, expiry
+// (YYYYMMDD), strike and lot size columns. Strings are interned into one
+// sorted pool, so equality filters compare ids and findString() is a binary
+// search. The file is written once per scrip master version and mmapped
+// read-only afterwards, which makes reopening it a few page faults rather
+// than a download and parse.
+//
+// The query index is a row permutation ordered by (instrumenttype, name,
+// exch_seg, expiry date, strike, row), which InstrumentUniverse searches
+// directly, so opening a snapshot needs no index build.
+//
+// Layout: ScripSnapshotHeader, then the columns, the query index and the
+// string pool at the 8-byte aligned offsets recorded in the header.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "ScripMaster.hpp"
+
+constexpr char SCRIP_SNAPSHOT_MAGIC[8] = {'S', 'C', 'R', 'I', 'P', 'S', 'N', 'P'};
+constexpr uint32_t SCRIP_SNAPSHOT_VERSION = 2;
+
+enum ScripColumn {
+    SCRIP_TOKEN,
+    SCRIP_SYMBOL,
+    SCRIP_NAME,
+    SCRIP_EXPIRY,
+    SCRIP_STRIKE,
+    SCRIP_LOTSIZE,
+    SCRIP_INSTRUMENTTYPE,
+    SCRIP_EXCH_SEG,
+    SCRIP_TICK_SIZE,
+    SCRIP_COLUMN_COUNT
+};
+
+struct ScripSnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordCount;
+    uint32_t stringCount;
+    uint32_t reserved;
+    uint64_t fileSize;
+    uint64_t stringColumnOffset[SCRIP_COLUMN_COUNT];  // uint32_t ids
+    uint64_t tokenIdOffset;                           // uint32_t
+    uint64_t expiryDateOffset;                        // int32_t YYYYMMDD, 0 if none
+    uint64_t strikeOffset;                            // double
+    uint64_t lotSizeOffset;                           // int32_t
+    uint64_t queryIndexOffset;                        // uint32_t rows in query order
+    uint64_t stringOffsetsOffset;                     // uint32_t[stringCount + 1]
+    uint64_t stringDataOffset;
+    int64_t fetchedEpoch;                             // When this version was downloaded
+    int64_t validatedEpoch;                           // Last time the server confirmed it unchanged
+    char etag[128];
+    char lastModified[64];
+};
+
+// "18OCT2026" to 20261018; 0 for anything else
+inline int32_t parseExpiryDate(const std::string& expiry) {
+    static const char* months[] = {"JAN", "FEB", "MAR", "APR", "MAY", "JUN", "JUL", "AUG", "SEP", "OCT", "NOV", "DEC"};
+    if (expiry.size() != 9) {
+        return 0;
+    }
+    for (int month = 0; month < 12; ++month) {
+        if (expiry.compare(2, 3, months[month]) == 0) {
+            int day = std::atoi(expiry.substr(0, 2).c_str());
+            int year = std::atoi(expiry.substr(5, 4).c_str());
+            return year * 10000 + (month + 1) * 100 + day;
+        }
+    }
+    return 0;
+}
+
+class ScripSnapshotBuilder {
+public:
+    void add(const ScripRecord& record) {
+        const std::string* fields[SCRIP_COLUMN_COUNT] = {
+            &record.token, &record.symbol, &record.name, &record.expiry, &record.strike,
+            &record.lotsize, &record.instrumenttype, &record.exch_seg, &record.tick_size};
+        for (int column = 0; column < SCRIP_COLUMN_COUNT; ++column) {
+            stringColumns_[column].push_back(intern(*fields[column]));
+        }
+        tokenIds_.push_back(record.tokenId());
+        expiryDates_.push_back(parseExpiryDate(record.expiry));
+        double strike = record.strikePrice();
+        strikes_.push_back(std::isfinite(strike) ? strike : 0);  // Keeps the query index order strict
+        lotSizes_.push_back(record.lotSize());
+    }
+
+    size_t size() const { return tokenIds_.size(); }
+
+    // Writes the snapshot to path + ".tmp" and renames it over path, so a
+    // reader never sees a half-written file.
+    bool write(const std::string& path, const std::string& etag, const std::string& lastModified, std::string& error) {
+        // Sort the pool so readers can binary-search it, then remap the ids
+        std::vector<uint32_t> order(strings_.size());
+        for (uint32_t i = 0; i < order.size(); ++i) {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) { return strings_[a] < strings_[b]; });
+        std::vector<uint32_t> remap(strings_.size());
+        for (uint32_t i = 0; i < order.size(); ++i) {
+            remap[order[i]] = i;
+        }
+
+        ScripSnapshotHeader header{};
+        std::memcpy(header.magic, SCRIP_SNAPSHOT_MAGIC, sizeof(header.magic));
+        header.version = SCRIP_SNAPSHOT_VERSION;
+        header.recordCount = static_cast<uint32_t>(size());
+        header.stringCount = static_cast<uint32_t>(strings_.size());
+        header.fetchedEpoch = std::time(nullptr);
+        header.validatedEpoch = header.fetchedEpoch;
+        std::strncpy(header.etag, etag.c_str(), sizeof(header.etag) - 1);
+        std::strncpy(header.lastModified, lastModified.c_str(), sizeof(header.lastModified) - 1);
+
+        uint64_t offset = sizeof(ScripSnapshotHeader);
+        auto reserve = [&offset](size_t bytes) {
+            uint64_t at = offset;
+            offset = (offset + bytes + 7) & ~uint64_t(7);
+            return at;
+        };
+        size_t rows = size();
+        for (int column = 0; column < SCRIP_COLUMN_COUNT; ++column) {
+            header.stringColumnOffset[column] = reserve(rows * sizeof(uint32_t));
+        }
+        header.tokenIdOffset = reserve(rows * sizeof(uint32_t));
+        header.expiryDateOffset = reserve(rows * sizeof(int32_t));
+        header.strikeOffset = reserve(rows * sizeof(double));
+        header.lotSizeOffset = reserve(rows * sizeof(int32_t));
+        header.queryIndexOffset = reserve(rows * sizeof(uint32_t));
+        header.stringOffsetsOffset = reserve((strings_.size() + 1) * sizeof(uint32_t));
+        size_t stringBytes = 0;
+        for (const auto& value : strings_) {
+            stringBytes += value.size();
+        }
+        header.stringDataOffset = reserve(stringBytes);
+        header.fileSize = offset;
+
+        std::vector<char> image(header.fileSize, 0);
+        std::memcpy(image.data(), &header, sizeof(header));
+        for (int column = 0; column < SCRIP_COLUMN_COUNT; ++column) {
+            uint32_t* ids = reinterpret_cast<uint32_t*>(image.data() + header.stringColumnOffset[column]);
+            for (size_t row = 0; row < rows; ++row) {
+                ids[row] = remap[stringColumns_[column][row]];
+            }
+        }
+        std::memcpy(image.data() + header.tokenIdOffset, tokenIds_.data(), rows * sizeof(uint32_t));
+        std::memcpy(image.data() + header.expiryDateOffset, expiryDates_.data(), rows * sizeof(int32_t));
+        std::memcpy(image.data() + header.strikeOffset, strikes_.data(), rows * sizeof(double));
+        std::memcpy(image.data() + header.lotSizeOffset, lotSizes_.data(), rows * sizeof(int32_t));
+
+        uint32_t* queryIndex = reinterpret_cast<uint32_t*>(image.data() + header.queryIndexOffset);
+        for (uint32_t row = 0; row < rows; ++row) {
+            queryIndex[row] = row;
+        }
+        const std::vector<uint32_t>& types = stringColumns_[SCRIP_INSTRUMENTTYPE];
+        const std::vector<uint32_t>& names = stringColumns_[SCRIP_NAME];
+        const std::vector<uint32_t>& segments = stringColumns_[SCRIP_EXCH_SEG];
+        std::sort(queryIndex, queryIndex + rows, [&](uint32_t a, uint32_t b) {
+            if (types[a] != types[b]) return remap[types[a]] < remap[types[b]];
+            if (names[a] != names[b]) return remap[names[a]] < remap[names[b]];
+            if (segments[a] != segments[b]) return remap[segments[a]] < remap[segments[b]];
+            if (expiryDates_[a] != expiryDates_[b]) return expiryDates_[a] < expiryDates_[b];
+            if (strikes_[a] != strikes_[b]) return strikes_[a] < strikes_[b];
+            return a < b;
+        });
+
+        uint32_t* stringOffsets = reinterpret_cast<uint32_t*>(image.data() + header.stringOffsetsOffset);
+        char* stringData = image.data() + header.stringDataOffset;
+        uint32_t position = 0;
+        for (uint32_t i = 0; i < order.size(); ++i) {
+            const std::string& value = strings_[order[i]];
+            stringOffsets[i] = position;
+            std::memcpy(stringData + position, value.data(), value.size());
+            position += static_cast<uint32_t>(value.size());
+        }
+        stringOffsets[order.size()] = position;
+
+        std::string tempPath = path + ".tmp";
+        {
+            std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+            if (!file.write(image.data(), image.size())) {
+                error = "failed to write " + tempPath;
+                return false;
+            }
+        }
+        if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+            error = "failed to rename " + tempPath + " to " + path;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    std::unordered_map<std::string, uint32_t> ids_;
+    std::vector<std::string> strings_;
+    std::vector<uint32_t> stringColumns_[SCRIP_COLUMN_COUNT];
+    std::vector<uint32_t> tokenIds_;
+    std::vector<int32_t> expiryDates_;
+    std::vector<double> strikes_;
+    std::vector<int32_t> lotSizes_;
+
+    uint32_t intern(const std::string& value) {
+        auto it = ids_.find(value);
+        if (it != ids_.end()) {
+            return it->second;
+        }
+        uint32_t id = static_cast<uint32_t>(strings_.size());
+        strings_.push_back(value);
+        ids_.emplace(value, id);
+        return id;
+    }
+};
+
+class ScripSnapshot {
+public:
+    static constexpr uint32_t NOT_FOUND = UINT32_MAX;
+
+    ScripSnapshot() = default;
+    ScripSnapshot(const ScripSnapshot&) = delete;
+    ScripSnapshot& operator=(const ScripSnapshot&) = delete;
+
+    ~ScripSnapshot() {
+        close();
+    }
+
+    bool open(const std::string& path, std::string& error) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            error = "cannot open " + path;
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(ScripSnapshotHeader)) {
+            ::close(fd);
+            error = path + " is not a scrip snapshot";
+            return false;
+        }
+        void* base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (base == MAP_FAILED) {
+            error = "cannot map " + path;
+            return false;
+        }
+        base_ = static_cast<const char*>(base);
+        mappedSize_ = st.st_size;
+        header_ = reinterpret_cast<const ScripSnapshotHeader*>(base_);
+
+        if (std::memcmp(header_->magic, SCRIP_SNAPSHOT_MAGIC, sizeof(header_->magic)) != 0 ||
+            header_->version != SCRIP_SNAPSHOT_VERSION || header_->fileSize != mappedSize_) {
+            close();
+            error = path + " is not a scrip snapshot of this version";
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        if (base_) {
+            munmap(const_cast<char*>(base_), mappedSize_);
+        }
+        base_ = nullptr;
+        header_ = nullptr;
+        mappedSize_ = 0;
+    }
+
+    bool isOpen() const { return header_ != nullptr; }
+    uint32_t size() const { return header_->recordCount; }
+    uint32_t stringCount() const { return header_->stringCount; }
+    size_t bytes() const { return mappedSize_; }
+    const ScripSnapshotHeader& header() const { return *header_; }
+
+    const uint32_t* column(ScripColumn column) const { return at<uint32_t>(header_->stringColumnOffset[column]); }
+    const uint32_t* tokenIds() const { return at<uint32_t>(header_->tokenIdOffset); }
+    const int32_t* expiryDates() const { return at<int32_t>(header_->expiryDateOffset); }
+    const double* strikes() const { return at<double>(header_->strikeOffset); }
+    const int32_t* lotSizes() const { return at<int32_t>(header_->lotSizeOffset); }
+    const uint32_t* queryIndex() const { return at<uint32_t>(header_->queryIndexOffset); }
+
+    std::string_view string(uint32_t id) const {
+        const uint32_t* offsets = at<uint32_t>(header_->stringOffsetsOffset);
+        return std::string_view(base_ + header_->stringDataOffset + offsets[id], offsets[id + 1] - offsets[id]);
+    }
+
+    // Id of an interned string, or NOT_FOUND if no record uses it
+    uint32_t findString(std::string_view value) const {
+        uint32_t low = 0;
+        uint32_t high = header_->stringCount;
+        while (low < high) {
+            uint32_t mid = low + (high - low) / 2;
+            if (string(mid) < value) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        return low < header_->stringCount && string(low) == value ? low : NOT_FOUND;
+    }
+
+    ScripRecord record(uint32_t row) const {
+        ScripRecord record;
+        std::string* fields[SCRIP_COLUMN_COUNT] = {
+            &record.token, &record.symbol, &record.name, &record.expiry, &record.strike,
+            &record.lotsize, &record.instrumenttype, &record.exch_seg, &record.tick_size};
+        for (int c = 0; c < SCRIP_COLUMN_COUNT; ++c) {
+            *fields[c] = std::string(string(column(static_cast<ScripColumn>(c))[row]));
+        }
+        return record;
+    }
+
+    // Records that the server confirmed the snapshot is still current
+    static bool markValidated(const std::string& path, int64_t epoch) {
+        int fd = ::open(path.c_str(), O_WRONLY);
+        if (fd < 0) {
+            return false;
+        }
+        bool ok = pwrite(fd, &epoch, sizeof(epoch), offsetof(ScripSnapshotHeader, validatedEpoch)) == sizeof(epoch);
+        ::close(fd);
+        return ok;
+    }
+
+private:
+    const char* base_ = nullptr;
+    size_t mappedSize_ = 0;
+    const ScripSnapshotHeader* header_ = nullptr;
+
+    template <typename T>
+    const T* at(uint64_t offset) const { return reinterpret_cast<const T*>(base_ + offset); }
+};
@@ -0,0 +1,380 @@
+// Local stand-in for the SmartStream websocket, used to load-test ws without
+// touching the broker. It speaks the same TLS websocket protocol: checks the
+// auth headers, accepts subscribe/unsubscribe requests, answers "ping" and
+// streams synthetic binary ticks for the subscribed tokens at a configurable
+// rate, with optional bursts and injected disconnects.
+//
+// Every tick carries the server's wall-clock send time (ns) in
+// last_traded_timestamp so the client can measure end-to-end latency.
+
+#include <websocketpp/config/asio.hpp>
+#include <websocketpp/server.hpp>
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../Websocket/smartstream.hpp"
+
+using json = nlohmann::json;
+
+typedef websocketpp::server<websocketpp::config::asio_tls> tls_server;
+
+struct MockSettings {
+    uint16_t port = 8443;
+    std::string cert_file = "config/mock/server.crt";
+    std::string key_file = "config/mock/server.key";
+    double rate = 10000;            // Ticks per second per connection
+    double burst_factor = 1;        // Rate multiplier while a burst is active
+    int burst_every_s = 0;          // Start a burst every N seconds (0 = never)
+    int burst_length_s = 1;
+    int disconnect_every_s = 0;     // Drop every connection every N seconds (0 = never)
+    bool hard_disconnect = false;   // Close the TCP socket instead of sending a close frame
+    int duration_s = 0;             // Stop after N seconds (0 = run until killed)
+    size_t max_buffered_bytes = 8 << 20;
+};
+
+class MockStreamServer {
+public:
+    explicit MockStreamServer(const MockSettings& settings)
+        : settings_(settings), rng_(12345) {
+    }
+
+    int run() {
+        ws_server_.init_asio();
+        ws_server_.set_reuse_addr(true);
+        ws_server_.clear_access_channels(websocketpp::log::alevel::all);
+
+        ws_server_.set_tls_init_handler([this](websocketpp::connection_hdl) {
+            auto context = websocketpp::lib::make_shared<websocketpp::lib::asio::ssl::context>(websocketpp::lib::asio::ssl::context::sslv23);
+            context->use_certificate_chain_file(settings_.cert_file);
+            context->use_private_key_file(settings_.key_file, websocketpp::lib::asio::ssl::context::pem);
+            return context;
+        });
+        ws_server_.set_validate_handler(std::bind(&MockStreamServer::on_validate, this, std::placeholders::_1));
+        ws_server_.set_open_handler(std::bind(&MockStreamServer::on_open, this, std::placeholders::_1));
+        ws_server_.set_close_handler(std::bind(&MockStreamServer::on_close, this, std::placeholders::_1));
+        ws_server_.set_message_handler(std::bind(&MockStreamServer::on_message, this, std::placeholders::_1, std::placeholders::_2));
+
+        websocketpp::lib::error_code ec;
+        ws_server_.listen(settings_.port, ec);
+        if (ec) {
+            std::cerr << "Could not listen on port " << settings_.port << ": " << ec.message() << std::endl;
+            return 1;
+        }
+        ws_server_.start_accept(ec);
+        if (ec) {
+            std::cerr << "Could not accept connections: " << ec.message() << std::endl;
+            return 1;
+        }
+
+        std::cout << "Mock SmartStream listening on wss://localhost:" << settings_.port << "/smart-stream, "
+                  << settings_.rate << " ticks/s per connection" << std::endl;
+
+        start_ = std::chrono::steady_clock::now();
+        last_step_ = start_;
+        last_report_ = start_;
+        last_disconnect_ = start_;
+        timer_.reset(new websocketpp::lib::asio::steady_timer(ws_server_.get_io_service()));
+        schedule_step();
+
+        ws_server_.run();
+        return 0;
+    }
+
+private:
+    struct Session {
+        int mode = MODE_SNAP_QUOTE;
+        std::vector<std::pair<uint8_t, uint32_t>> subscribed;
+        std::set<std::pair<uint8_t, uint32_t>> subscribed_set;
+        std::map<uint32_t, int64_t> last_price;
+        size_t cursor = 0;
+        int64_t sequence = 0;
+        double credit = 0;
+    };
+
+    tls_server ws_server_;
+    MockSettings settings_;
+    std::map<websocketpp::connection_hdl, Session, std::owner_less<websocketpp::connection_hdl>> sessions_;
+    std::unique_ptr<websocketpp::lib::asio::steady_timer> timer_;
+    std::mt19937 rng_;
+
+    std::chrono::steady_clock::time_point start_;
+    std::chrono::steady_clock::time_point last_step_;
+    std::chrono::steady_clock::time_point last_report_;
+    std::chrono::steady_clock::time_point last_disconnect_;
+    uint64_t ticks_sent_ = 0;
+    uint64_t ticks_reported_ = 0;
+    uint64_t send_errors_ = 0;
+    uint64_t throttled_ = 0;
+    uint64_t connections_total_ = 0;
+
+    // Same headers the real endpoint requires; values are not checked.
+    bool on_validate(websocketpp::connection_hdl hdl) {
+        tls_server::connection_ptr con = ws_server_.get_con_from_hdl(hdl);
+        for (const char* header : {"Authorization", "x-api-key", "x-client-code", "x-feed-token"}) {
+            if (con->get_request_header(header).empty()) {
+                std::cout << "Rejected connection without " << header << " header" << std::endl;
+                con->set_status(websocketpp::http::status_code::unauthorized);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void on_open(websocketpp::connection_hdl hdl) {
+        sessions_[hdl] = Session();
+        ++connections_total_;
+        std::cout << "Client connected (" << sessions_.size() << " open)" << std::endl;
+    }
+
+    void on_close(websocketpp::connection_hdl hdl) {
+        sessions_.erase(hdl);
+        std::cout << "Client disconnected (" << sessions_.size() << " open)" << std::endl;
+    }
+
+    void on_message(websocketpp::connection_hdl hdl, tls_server::message_ptr msg) {
+        auto it = sessions_.find(hdl);
+        if (it == sessions_.end()) {
+            return;
+        }
+        const std::string& payload = msg->get_payload();
+        websocketpp::lib::error_code ec;
+        if (payload == "ping") {
+            ws_server_.send(hdl, "pong", websocketpp::frame::opcode::text, ec);
+            return;
+        }
+
+        json request = json::parse(payload, nullptr, false);
+        if (request.is_discarded() || !request.contains("action") || !request.contains("params")) {
+            json error;
+            error["correlationID"] = request.is_object() ? request.value("correlationID", "") : "";
+            error["errorCode"] = "E1002";
+            error["errorMessage"] = "Invalid Request Payload.";
+            ws_server_.send(hdl, error.dump(), websocketpp::frame::opcode::text, ec);
+            return;
+        }
+
+        Session& session = it->second;
+        int action = request["action"].get<int>();
+        const json& params = request["params"];
+        session.mode = params.value("mode", session.mode);
+
+        for (const auto& entry : params.value("tokenList", json::array())) {
+            uint8_t exchange_type = static_cast<uint8_t>(entry.value("exchangeType", 0));
+            for (const auto& token_json : entry.value("tokens", json::array())) {
+                std::string token_text = token_json.is_string() ? token_json.get<std::string>() : token_json.dump();
+                uint32_t token = static_cast<uint32_t>(std::strtoul(token_text.c_str(), nullptr, 10));
+                if (token == 0) {
+                    continue;
+                }
+                auto key = std::make_pair(exchange_type, token);
+                if (action == 1 && session.subscribed_set.insert(key).second) {
+                    session.subscribed.push_back(key);
+                    session.last_price[token] = 1000000 + static_cast<int64_t>(rng_() % 9000000);
+                } else if (action == 0 && session.subscribed_set.erase(key) != 0) {
+                    session.subscribed.erase(std::find(session.subscribed.begin(), session.subscribed.end(), key));
+                }
+            }
+        }
+    }
+
+    void schedule_step() {
+        timer_->expires_after(std::chrono::milliseconds(1));
+        timer_->async_wait([this](const websocketpp::lib::asio::error_code& ec) {
+            if (!ec) {
+                step();
+            }
+        });
+    }
+
+    double current_rate(double elapsed_s) const {
+        if (settings_.burst_every_s > 0 && settings_.burst_factor != 1) {
+            double phase = std::fmod(elapsed_s, settings_.burst_every_s);
+            if (phase < settings_.burst_length_s) {
+                return settings_.rate * settings_.burst_factor;
+            }
+        }
+        return settings_.rate;
+    }
+
+    void step() {
+        auto now = std::chrono::steady_clock::now();
+        double elapsed_s = std::chrono::duration<double>(now - start_).count();
+        double dt = std::chrono::duration<double>(now - last_step_).count();
+        last_step_ = now;
+
+        if (settings_.duration_s > 0 && elapsed_s >= settings_.duration_s) {
+            shutdown();
+            return;
+        }
+
+        if (settings_.disconnect_every_s > 0 &&
+            now - last_disconnect_ >= std::chrono::seconds(settings_.disconnect_every_s)) {
+            last_disconnect_ = now;
+            inject_disconnect();
+        }
+
+        // Accumulate fractional credit so low rates and 1 ms steps still average
+        // out; cap it so a stalled loop does not fire one giant catch-up burst.
+        double rate = current_rate(elapsed_s);
+        for (auto& [hdl, session] : sessions_) {
+            if (session.subscribed.empty()) {
+                continue;
+            }
+            session.credit = std::min(session.credit + rate * dt, rate * 0.05 + 1);
+            size_t due = static_cast<size_t>(session.credit);
+            session.credit -= due;
+            send_ticks(hdl, session, due);
+        }
+
+        if (now - last_report_ >= std::chrono::seconds(1)) {
+            double interval = std::chrono::duration<double>(now - last_report_).count();
+            std::cout << std::fixed << std::setprecision(0)
+                      << "Connections: " << sessions_.size()
+                      << ", sent: " << (ticks_sent_ - ticks_reported_) / interval << " ticks/s"
+                      << ", total: " << ticks_sent_
+                      << ", send errors: " << send_errors_
+                      << ", throttled: " << throttled_ << std::endl;
+            ticks_reported_ = ticks_sent_;
+            last_report_ = now;
+        }
+
+        schedule_step();
+    }
+
+    void send_ticks(websocketpp::connection_hdl hdl, Session& session, size_t count) {
+        websocketpp::lib::error_code ec;
+        tls_server::connection_ptr con = ws_server_.get_con_from_hdl(hdl, ec);
+        if (ec) {
+            return;
+        }
+        // A slow client is throttled here rather than buffered without bound
+        if (con->get_buffered_amount() > settings_.max_buffered_bytes) {
+            throttled_ += count;
+            return;
+        }
+
+        char packet[MAX_PACKET_SIZE];
+        std::uniform_int_distribution<int> step(-5, 5);
+        for (size_t i = 0; i < count; ++i) {
+            const auto& [exchange_type, token] = session.subscribed[session.cursor++ % session.subscribed.size()];
+            int64_t& price = session.last_price[token];
+            price = std::max<int64_t>(5, price + step(rng_) * 5);
+
+            Tick tick{};
+            tick.token = token;
+            tick.mode = static_cast<uint8_t>(session.mode);
+            tick.exchange_type = exchange_type;
+            tick.sequence = ++session.sequence;
+            tick.ltp = price;
+            tick.last_traded_qty = 1 + rng_() % 100;
+            tick.avg_traded_price = price;
+            tick.volume = session.sequence * 10;
+            tick.total_buy_qty = 1000;
+            tick.total_sell_qty = 1000;
+            tick.open = tick.high = tick.low = tick.close = price;
+            tick.open_interest = 100000;
+            for (int level = 0; level < DEPTH_LEVELS; ++level) {
+                tick.bids[level] = DepthLevel{price - 5 * (level + 1), 10 * (level + 1), level + 1, 0};
+                tick.asks[level] = DepthLevel{price + 5 * (level + 1), 10 * (level + 1), level + 1, 0};
+            }
+            tick.upper_circuit = price * 2;
+            tick.lower_circuit = price / 2;
+            tick.high_52_week = price * 2;
+            tick.low_52_week = price / 2;
+
+            int64_t sent_ns = wall_now_ns();
+            tick.exchange_timestamp = sent_ns / 1000000;
+            tick.last_traded_timestamp = sent_ns;
+
+            size_t size = encode_tick(tick, packet);
+            ws_server_.send(hdl, packet, size, websocketpp::frame::opcode::binary, ec);
+            if (ec) {
+                ++send_errors_;
+                return;
+            }
+            ++ticks_sent_;
+        }
+    }
+
+    void inject_disconnect() {
+        std::vector<websocketpp::connection_hdl> handles;
+        for (const auto& session : sessions_) {
+            handles.push_back(session.first);
+        }
+        std::cout << "Injecting " << (settings_.hard_disconnect ? "hard" : "clean")
+                  << " disconnect of " << handles.size() << " connection(s)" << std::endl;
+
+        for (const auto& hdl : handles) {
+            websocketpp::lib::error_code ec;
+            if (settings_.hard_disconnect) {
+                tls_server::connection_ptr con = ws_server_.get_con_from_hdl(hdl, ec);
+                if (!ec) {
+                    boost::system::error_code close_ec;
+                    con->get_raw_socket().close(close_ec);
+                }
+            } else {
+                ws_server_.close(hdl, websocketpp::close::status::going_away, "injected disconnect", ec);
+            }
+        }
+    }
+
+    void shutdown() {
+        websocketpp::lib::error_code ec;
+        ws_server_.stop_listening(ec);
+        for (const auto& session : sessions_) {
+            ws_server_.close(session.first, websocketpp::close::status::going_away, "server shutdown", ec);
+        }
+        std::cout << "Mock stream finished: " << ticks_sent_ << " ticks sent over "
+                  << connections_total_ << " connection(s)" << std::endl;
+    }
+};
+
+int main(int argc, char* argv[]) {
+    MockSettings settings;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next = [&]() -> std::string { return i + 1 < argc ? argv[++i] : ""; };
+        if (arg == "--port") {
+            settings.port = static_cast<uint16_t>(std::stoi(next()));
+        } else if (arg == "--cert") {
+            settings.cert_file = next();
+        } else if (arg == "--key") {
+            settings.key_file = next();
+        } else if (arg == "--rate") {
+            settings.rate = std::stod(next());
+        } else if (arg == "--burst-factor") {
+            settings.burst_factor = std::stod(next());
+        } else if (arg == "--burst-every") {
+            settings.burst_every_s = std::stoi(next());
+        } else if (arg == "--burst-length") {
+            settings.burst_length_s = std::stoi(next());
+        } else if (arg == "--disconnect-every") {
+            settings.disconnect_every_s = std::stoi(next());
+        } else if (arg == "--hard-disconnect") {
+            settings.hard_disconnect = true;
+        } else if (arg == "--duration") {
+            settings.duration_s = std::stoi(next());
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            std::cerr << "Usage: mock_stream [--port N] [--cert file] [--key file] [--rate N] "
+                         "[--burst-factor F --burst-every S --burst-length S] "
+                         "[--disconnect-every S [--hard-disconnect]] [--duration S]" << std::endl;
+            return 1;
+        }
+    }
+
+    MockStreamServer server(settings);
+    return server.run();
+}
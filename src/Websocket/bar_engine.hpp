@@ -0,0 +1,299 @@
+#pragma once
+
+// Real-time OHLCV bars built from the decoded tick stream.
+//
+// The engine is a TickSink. For every configured interval it keeps one
+// struct-of-arrays slot per instrument table index: open bar start, OHLC,
+// volume baseline, open interest and tick count. A tick updates each interval
+// in O(1) with no allocation and no lock, because every token is only ever
+// handled by the consumer thread that owns it.
+//
+// Bars follow exchange time, not the local clock. Buckets are aligned to the
+// 09:15 IST open and the last one is cut short at 15:30; ticks outside the
+// session, on weekends or on holidays from config/settings/Holiday.ini are
+// not aggregated. A bar closes when its token ticks in a later bucket, or
+// when the newest trading-day exchange time seen on any consumer passes its
+// end by grace_ms, so illiquid strikes still close on time. A tick for a bar that
+// has already closed is counted as late and left out. Once the wall clock is
+// past the close of the session the exchange clock is in, idle consumers move
+// that clock on from wall time, so the day's last bars close even when no
+// token ticks after 15:30. flush() closes whatever is still open at shutdown.
+//
+// Closed bars go to every sink through TickDispatcher::publish_bar() on the
+// owning consumer thread, so a token's bars stay ordered with its ticks.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "instrument_table.hpp"
+#include "market_clock.hpp"
+#include "metrics.hpp"
+#include "smartstream.hpp"
+#include "tick_dispatcher.hpp"
+
+struct BarEngineSettings {
+    std::vector<int> intervals_s = {1, 60, 300};
+    int64_t grace_ms = 500;  // How far exchange time must pass a bar's end before it closes without a tick
+    bool wall_clock_close = true;  // Off for replays, whose exchange time is not today's
+};
+
+class BarEngine : public TickSink {
+public:
+    BarEngine(const InstrumentTable& instruments, const TradingCalendar& calendar, TickDispatcher& dispatcher,
+              const BarEngineSettings& settings)
+        : instruments_(instruments), calendar_(calendar), dispatcher_(dispatcher), grace_ms_(settings.grace_ms),
+          wall_clock_close_(settings.wall_clock_close),
+          consumers_(new ConsumerState[dispatcher.consumer_count()]),
+          volume_day_(instruments.size(), -1), cumulative_volume_(instruments.size(), 0) {
+        for (int interval_s : settings.intervals_s) {
+            if (interval_s > 0 && interval_s <= 65535) {
+                intervals_.emplace_back(new IntervalState(interval_s, instruments.size(), dispatcher.consumer_count()));
+                sweep_step_ms_ = std::min(sweep_step_ms_, intervals_.back()->interval_ms);
+            }
+        }
+        late_ticks_.reset(new LocalCounter[dispatcher.consumer_count()]);
+        out_of_session_.reset(new LocalCounter[dispatcher.consumer_count()]);
+    }
+
+    bool enabled() const { return !intervals_.empty(); }
+
+    void on_tick(const Tick& tick, int32_t instrument_index) override {
+        if (intervals_.empty() || tick.exchange_timestamp <= 0 || tick.ltp <= 0) {
+            return;
+        }
+        size_t consumer = dispatcher_.consumer_of(instrument_index);
+        ConsumerState& state = consumers_[consumer];
+        ThreadConsumer& thread_consumer = this_thread_consumer();
+        thread_consumer.engine = this;
+        thread_consumer.consumer = consumer;
+
+        int64_t day = ist_day_number(tick.exchange_timestamp);
+        if (day != state.day) {
+            state.day = day;
+            state.trading_day = calendar_.is_trading_day(day);
+        }
+        if (!state.trading_day) {
+            out_of_session_[consumer].add();
+            return;
+        }
+
+        // Ticks after 15:30 still move the clock, which closes the last bars
+        advance_clock(tick.exchange_timestamp);
+        sweep_if_due(consumer);
+        int64_t ms_of_day = tick.exchange_timestamp - (day * MS_PER_DAY - IST_OFFSET_MS);
+        if (ms_of_day < SESSION_OPEN_MS || ms_of_day >= SESSION_CLOSE_MS) {
+            out_of_session_[consumer].add();
+            return;
+        }
+
+        // Volume before this tick; the day's first tick starts from its own trade
+        int64_t previous_volume = volume_day_[instrument_index] == day
+            ? cumulative_volume_[instrument_index]
+            : std::max<int64_t>(0, tick.volume - tick.last_traded_qty);
+
+        int64_t since_open = ms_of_day - SESSION_OPEN_MS;
+        bool late = false;
+        for (auto& interval : intervals_) {
+            IntervalState& bars = *interval;
+            int64_t start = tick.exchange_timestamp - since_open % bars.interval_ms;
+            int64_t& open_start = bars.start_ms[instrument_index];
+            if (open_start == start) {
+                int64_t price = tick.ltp;
+                bars.high[instrument_index] = std::max(bars.high[instrument_index], price);
+                bars.low[instrument_index] = std::min(bars.low[instrument_index], price);
+                bars.close[instrument_index] = price;
+                bars.open_interest[instrument_index] = tick.open_interest;
+                ++bars.ticks[instrument_index];
+                continue;
+            }
+            if (start < open_start || start < bars.closed_end_ms[instrument_index]) {
+                late = true;
+                continue;
+            }
+            if (open_start != 0) {
+                close_bar(bars, instrument_index, consumer);
+            }
+            open_start = start;
+            bars.open[instrument_index] = tick.ltp;
+            bars.high[instrument_index] = tick.ltp;
+            bars.low[instrument_index] = tick.ltp;
+            bars.close[instrument_index] = tick.ltp;
+            bars.volume_base[instrument_index] = previous_volume;
+            bars.open_interest[instrument_index] = tick.open_interest;
+            bars.ticks[instrument_index] = 1;
+        }
+        if (late) {
+            late_ticks_[consumer].add();
+        }
+        volume_day_[instrument_index] = day;
+        cumulative_volume_[instrument_index] = std::max(tick.volume, previous_volume);
+    }
+
+    void on_idle() override {
+        ThreadConsumer& thread_consumer = this_thread_consumer();
+        if (thread_consumer.engine != this) {
+            return;
+        }
+        // Out of session on the wall clock: past the close of the exchange
+        // clock's day, or before today's open
+        int64_t clock = clock_ms_.load(std::memory_order_relaxed);
+        if (wall_clock_close_ && clock > 0) {
+            int64_t wall_ms = wall_now_ns() / 1000000;
+            int64_t session_close = ist_day_number(clock) * MS_PER_DAY - IST_OFFSET_MS + SESSION_CLOSE_MS;
+            if (wall_ms >= session_close || ist_ms_of_day(wall_ms) < SESSION_OPEN_MS) {
+                advance_clock(wall_ms);
+            }
+        }
+        sweep_if_due(thread_consumer.consumer);
+    }
+
+    // Closes every open bar. Only once the dispatcher has stopped, since it
+    // publishes each token's bars from the calling thread.
+    void flush() {
+        for (auto& interval : intervals_) {
+            IntervalState& bars = *interval;
+            for (size_t i = 0; i < instruments_.size(); ++i) {
+                if (bars.start_ms[i] != 0) {
+                    close_bar(bars, static_cast<int32_t>(i), dispatcher_.consumer_of(static_cast<int32_t>(i)));
+                }
+            }
+        }
+    }
+
+    size_t interval_count() const { return intervals_.size(); }
+    int interval_s(size_t interval) const { return static_cast<int>(intervals_[interval]->interval_ms / 1000); }
+
+    uint64_t bars_closed(size_t interval) const {
+        uint64_t total = 0;
+        for (size_t i = 0; i < dispatcher_.consumer_count(); ++i) {
+            total += intervals_[interval]->closed[i].load();
+        }
+        return total;
+    }
+
+    uint64_t late_ticks() const { return sum(late_ticks_); }
+    uint64_t out_of_session_ticks() const { return sum(out_of_session_); }
+
+    // Newest exchange time seen, or wall time once the session has ended; epoch ms
+    int64_t exchange_clock_ms() const { return clock_ms_.load(std::memory_order_relaxed); }
+
+private:
+    struct IntervalState {
+        IntervalState(int interval_s, size_t instruments, size_t consumers)
+            : interval_ms(interval_s * 1000LL), start_ms(instruments, 0), closed_end_ms(instruments, 0),
+              open(instruments), high(instruments), low(instruments), close(instruments),
+              volume_base(instruments), open_interest(instruments), ticks(instruments, 0),
+              closed(new LocalCounter[consumers]) {}
+
+        const int64_t interval_ms;
+        std::vector<int64_t> start_ms;       // Open bar, 0 if none
+        std::vector<int64_t> closed_end_ms;  // End of the last closed bar
+        std::vector<int64_t> open;
+        std::vector<int64_t> high;
+        std::vector<int64_t> low;
+        std::vector<int64_t> close;
+        std::vector<int64_t> volume_base;    // Cumulative day volume before the bar's first tick
+        std::vector<int64_t> open_interest;
+        std::vector<uint32_t> ticks;
+        std::unique_ptr<LocalCounter[]> closed;  // Per consumer
+    };
+
+    struct alignas(64) ConsumerState {
+        int64_t day = -1;
+        bool trading_day = false;
+        int64_t next_sweep_ms = 0;
+    };
+
+    // Lets on_idle(), which is not told its consumer, sweep the right tokens
+    struct ThreadConsumer {
+        const BarEngine* engine = nullptr;
+        size_t consumer = 0;
+    };
+
+    static ThreadConsumer& this_thread_consumer() {
+        static thread_local ThreadConsumer thread_consumer;
+        return thread_consumer;
+    }
+
+    const InstrumentTable& instruments_;
+    const TradingCalendar& calendar_;
+    TickDispatcher& dispatcher_;
+    const int64_t grace_ms_;
+    const bool wall_clock_close_;
+    std::vector<std::unique_ptr<IntervalState>> intervals_;
+    int64_t sweep_step_ms_ = 1000LL * 65535;
+    std::unique_ptr<ConsumerState[]> consumers_;
+    std::vector<int64_t> volume_day_;        // IST day of cumulative_volume_
+    std::vector<int64_t> cumulative_volume_;
+    std::unique_ptr<LocalCounter[]> late_ticks_;
+    std::unique_ptr<LocalCounter[]> out_of_session_;
+    alignas(64) std::atomic<int64_t> clock_ms_{0};
+
+    // Exchange clock shared by all consumers; it only moves forward and
+    // changes at most once per millisecond, so the line is rarely written
+    void advance_clock(int64_t exchange_timestamp) {
+        int64_t current = clock_ms_.load(std::memory_order_relaxed);
+        while (exchange_timestamp > current &&
+               !clock_ms_.compare_exchange_weak(current, exchange_timestamp, std::memory_order_relaxed)) {
+        }
+    }
+
+    static int64_t bar_end_ms(const IntervalState& bars, int64_t start) {
+        return start + std::min(bars.interval_ms, SESSION_CLOSE_MS - ist_ms_of_day(start));
+    }
+
+    void close_bar(IntervalState& bars, int32_t instrument_index, size_t consumer) {
+        const Instrument& instrument = instruments_.at(instrument_index);
+        Bar bar{};
+        bar.token = instrument.token;
+        bar.exchange_type = instrument.exchange_type;
+        bar.interval_s = static_cast<uint16_t>(bars.interval_ms / 1000);
+        bar.start_ms = bars.start_ms[instrument_index];
+        bar.open = bars.open[instrument_index];
+        bar.high = bars.high[instrument_index];
+        bar.low = bars.low[instrument_index];
+        bar.close = bars.close[instrument_index];
+        bar.volume = std::max<int64_t>(0, cumulative_volume_[instrument_index] - bars.volume_base[instrument_index]);
+        bar.open_interest = bars.open_interest[instrument_index];
+        bar.ticks = bars.ticks[instrument_index];
+
+        bars.closed_end_ms[instrument_index] = bar_end_ms(bars, bar.start_ms);
+        bars.start_ms[instrument_index] = 0;
+        bars.closed[consumer].add();
+        dispatcher_.publish_bar(bar, instrument_index);
+    }
+
+    // Closes this consumer's bars that exchange time has moved past. Runs at
+    // most once per step of the shortest interval.
+    void sweep_if_due(size_t consumer) {
+        ConsumerState& state = consumers_[consumer];
+        int64_t cutoff = clock_ms_.load(std::memory_order_relaxed) - grace_ms_;
+        if (cutoff < state.next_sweep_ms) {
+            return;
+        }
+        state.next_sweep_ms = cutoff - cutoff % sweep_step_ms_ + sweep_step_ms_;
+
+        size_t step = dispatcher_.consumer_count();
+        size_t count = instruments_.size();
+        for (auto& interval : intervals_) {
+            IntervalState& bars = *interval;
+            for (size_t i = consumer; i < count; i += step) {
+                int64_t start = bars.start_ms[i];
+                if (start != 0 && bar_end_ms(bars, start) <= cutoff) {
+                    close_bar(bars, static_cast<int32_t>(i), consumer);
+                }
+            }
+        }
+    }
+
+    uint64_t sum(const std::unique_ptr<LocalCounter[]>& counters) const {
+        uint64_t total = 0;
+        for (size_t i = 0; i < dispatcher_.consumer_count(); ++i) {
+            total += counters[i].load();
+        }
+        return total;
+    }
+};
@@ -0,0 +1,256 @@
+#pragma once
+
+// Live implied volatility and Greeks for every subscribed option.
+//
+// Each option in the instrument table is paired with the AMXIDX index of the
+// same name (SENSEX, BANKEX) as its underlying. on_tick() only stores the
+// latest LTP per instrument and the newest exchange time, so the consumer
+// threads pay two relaxed stores per tick.
+//
+// An analytics thread runs a pass every interval_ms. A pass gathers into
+// contiguous scratch arrays only the options whose own LTP or index LTP
+// changed since they were last solved, runs the batch solver in
+// black_scholes.hpp over them, and scatters the results back. Contracts with
+// unchanged inputs keep their previous values; time to expiry is measured to
+// 15:30 IST on the expiry date from the exchange time of the pass.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "black_scholes.hpp"
+#include "instrument_table.hpp"
+#include "market_clock.hpp"
+#include "smartstream.hpp"
+#include "tick_dispatcher.hpp"
+
+struct GreeksSettings {
+    double rate = 0.065;   // Continuously compounded risk-free rate
+    int interval_ms = 0;   // Pass period; 0 disables the engine
+};
+
+struct OptionGreeks {
+    uint32_t token;
+    double spot;     // Index LTP the values were solved with, rupees
+    double price;    // Option LTP, rupees
+    double iv;       // NaN if the price has no implied volatility
+    double delta;
+    double gamma;
+    double vega;     // Per volatility point
+    double theta;    // Per calendar day
+    int64_t solved_ms;  // Exchange time of the pass, 0 if never solved
+};
+
+class GreeksEngine : public TickSink {
+public:
+    static constexpr double MS_PER_YEAR = 365.0 * MS_PER_DAY;
+
+    GreeksEngine(const InstrumentTable& instruments, const GreeksSettings& settings)
+        : settings_(settings), live_price_(new std::atomic<int64_t>[instruments.size()]),
+          tracked_(instruments.size(), 0) {
+        for (size_t i = 0; i < instruments.size(); ++i) {
+            live_price_[i].store(0, std::memory_order_relaxed);
+        }
+        if (settings_.interval_ms > 0) {
+            build(instruments);
+        }
+    }
+
+    ~GreeksEngine() override {
+        stop();
+    }
+
+    bool enabled() const { return settings_.interval_ms > 0 && !contracts_.token.empty(); }
+    size_t contracts() const { return contracts_.token.size(); }
+
+    void on_tick(const Tick& tick, int32_t instrument_index) override {
+        if (instrument_index < 0 || !tracked_[instrument_index]) {
+            return;
+        }
+        live_price_[instrument_index].store(tick.ltp, std::memory_order_relaxed);
+        int64_t clock = clock_ms_.load(std::memory_order_relaxed);
+        while (tick.exchange_timestamp > clock &&
+               !clock_ms_.compare_exchange_weak(clock, tick.exchange_timestamp, std::memory_order_relaxed)) {
+        }
+    }
+
+    void start() {
+        if (!enabled() || running_.exchange(true)) {
+            return;
+        }
+        thread_ = std::thread([this]() {
+            std::unique_lock<std::mutex> lock(wake_mutex_);
+            while (running_.load()) {
+                wake_.wait_for(lock, std::chrono::milliseconds(settings_.interval_ms));
+                if (running_.load()) {
+                    pass(clock_ms_.load(std::memory_order_relaxed));
+                }
+            }
+        });
+    }
+
+    void stop() {
+        if (!running_.exchange(false)) {
+            return;
+        }
+        wake_.notify_one();
+        thread_.join();
+    }
+
+    // Solves the options whose inputs changed; returns how many. Called by
+    // the analytics thread, or directly when the engine is not started.
+    size_t pass(int64_t now_ms) {
+        if (now_ms <= 0) {
+            return 0;
+        }
+        auto started = std::chrono::steady_clock::now();
+        Contracts& c = contracts_;
+        size_t n = 0;
+        for (size_t k = 0; k < c.token.size(); ++k) {
+            int64_t price = live_price_[c.option_index[k]].load(std::memory_order_relaxed);
+            int64_t spot = live_price_[c.underlying_index[k]].load(std::memory_order_relaxed);
+            if (price <= 0 || spot <= 0 || (price == c.solved_price[k] && spot == c.solved_spot[k])) {
+                continue;
+            }
+            double years = (c.expiry_ms[k] - now_ms) / MS_PER_YEAR;
+            if (years <= 0) {
+                continue;
+            }
+            c.solved_price[k] = price;
+            c.solved_spot[k] = spot;
+            batch_.contract[n] = k;
+            batch_.spot[n] = spot / 100.0;
+            batch_.strike[n] = c.strike[k];
+            batch_.years[n] = years;
+            batch_.sign[n] = c.sign[k];
+            batch_.price[n] = price / 100.0;
+            ++n;
+        }
+
+        size_t failed = 0;
+        if (n > 0) {
+            BsInputs in{batch_.spot.data(), batch_.strike.data(), batch_.years.data(), batch_.sign.data(), batch_.price.data()};
+            BsOutputs out{batch_.iv.data(), batch_.delta.data(), batch_.gamma.data(), batch_.vega.data(), batch_.theta.data()};
+            failed = bs_solve_batch(in, out, n, settings_.rate);
+
+            std::lock_guard<std::mutex> lock(results_mutex_);
+            for (size_t i = 0; i < n; ++i) {
+                size_t k = batch_.contract[i];
+                results_[k] = OptionGreeks{c.token[k], batch_.spot[i], batch_.price[i], batch_.iv[i], batch_.delta[i],
+                                           batch_.gamma[i], batch_.vega[i], batch_.theta[i], now_ms};
+            }
+        }
+
+        passes_.fetch_add(1, std::memory_order_relaxed);
+        solved_.fetch_add(n, std::memory_order_relaxed);
+        failed_.fetch_add(failed, std::memory_order_relaxed);
+        last_pass_ns_.store(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count(),
+                            std::memory_order_relaxed);
+        return n;
+    }
+
+    std::vector<OptionGreeks> snapshot() const {
+        std::lock_guard<std::mutex> lock(results_mutex_);
+        return results_;
+    }
+
+    uint64_t passes() const { return passes_.load(std::memory_order_relaxed); }
+    uint64_t solved() const { return solved_.load(std::memory_order_relaxed); }
+    uint64_t failed() const { return failed_.load(std::memory_order_relaxed); }
+    int64_t last_pass_ns() const { return last_pass_ns_.load(std::memory_order_relaxed); }
+
+    // Newest exchange time seen on an option or index tick, epoch ms
+    int64_t exchange_clock_ms() const { return clock_ms_.load(std::memory_order_relaxed); }
+
+private:
+    // Per-option inputs and the prices they were last solved with
+    struct Contracts {
+        std::vector<uint32_t> token;
+        std::vector<int32_t> option_index;
+        std::vector<int32_t> underlying_index;
+        std::vector<double> strike;
+        std::vector<double> sign;
+        std::vector<int64_t> expiry_ms;
+        std::vector<int64_t> solved_price;
+        std::vector<int64_t> solved_spot;
+    };
+
+    // Scratch for one pass, only the changed contracts
+    struct Batch {
+        std::vector<size_t> contract;
+        std::vector<double> spot, strike, years, sign, price;
+        std::vector<double> iv, delta, gamma, vega, theta;
+
+        void resize(size_t n) {
+            contract.resize(n);
+            for (auto* field : {&spot, &strike, &years, &sign, &price, &iv, &delta, &gamma, &vega, &theta}) {
+                field->resize(n);
+            }
+        }
+    };
+
+    const GreeksSettings settings_;
+    std::unique_ptr<std::atomic<int64_t>[]> live_price_;  // Paise, by instrument index
+    std::vector<uint8_t> tracked_;                       // Options and their indices
+    alignas(64) std::atomic<int64_t> clock_ms_{0};
+    Contracts contracts_;
+    Batch batch_;
+
+    mutable std::mutex results_mutex_;
+    std::vector<OptionGreeks> results_;
+
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+    std::mutex wake_mutex_;
+    std::condition_variable wake_;
+    std::atomic<uint64_t> passes_{0};
+    std::atomic<uint64_t> solved_{0};
+    std::atomic<uint64_t> failed_{0};
+    std::atomic<int64_t> last_pass_ns_{0};
+
+    void build(const InstrumentTable& instruments) {
+        const auto& all = instruments.instruments();
+        std::map<std::string, int32_t> index_by_name;
+        for (size_t i = 0; i < all.size(); ++i) {
+            if (all[i].exchange_type == BSE_CM && all[i].option_type == OPTION_NONE) {
+                index_by_name.emplace(std::string(all[i].name, strnlen(all[i].name, sizeof(all[i].name))), static_cast<int32_t>(i));
+            }
+        }
+
+        for (size_t i = 0; i < all.size(); ++i) {
+            const Instrument& option = all[i];
+            if (option.option_type == OPTION_NONE || option.expiry == 0 || option.strike <= 0) {
+                continue;
+            }
+            auto found = index_by_name.find(std::string(option.name, strnlen(option.name, sizeof(option.name))));
+            if (found == index_by_name.end()) {
+                continue;
+            }
+            int32_t underlying = found->second;
+            contracts_.token.push_back(option.token);
+            contracts_.option_index.push_back(static_cast<int32_t>(i));
+            contracts_.underlying_index.push_back(underlying);
+            contracts_.strike.push_back(option.strike);
+            contracts_.sign.push_back(option.option_type == OPTION_CALL ? 1.0 : -1.0);
+            contracts_.expiry_ms.push_back(days_from_civil_date(option.expiry) * MS_PER_DAY - IST_OFFSET_MS + SESSION_CLOSE_MS);
+            contracts_.solved_price.push_back(0);
+            contracts_.solved_spot.push_back(0);
+            tracked_[i] = 1;
+            tracked_[underlying] = 1;
+
+            OptionGreeks empty{};
+            empty.token = option.token;
+            results_.push_back(empty);
+        }
+        batch_.resize(contracts_.token.size());
+    }
+};
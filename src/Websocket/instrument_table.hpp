@@ -0,0 +1,181 @@
+#pragma once
+
+// Instrument reference data keyed by numeric token.
+//
+// Instruments live in one dense vector of 64-byte records (the "instrument
+// index" used by every per-token array downstream). Tokens map to that index
+// through an open-addressing table built once after loading, so a lookup on
+// the tick path is a multiply, a shift and usually a single probe.
+//
+// Alongside the reference data each instrument has a live feed state: the
+// sequence number and exchange timestamp of its newest stream tick, used to
+// spot gaps. It is written only by the network thread that receives the
+// token and may be read from any thread.
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+enum OptionType : uint8_t {
+    OPTION_NONE = 0,
+    OPTION_CALL = 1,
+    OPTION_PUT = 2
+};
+
+struct alignas(64) Instrument {
+    uint32_t token;
+    uint8_t exchange_type;
+    uint8_t option_type;
+    uint16_t reserved;
+    int32_t expiry;     // YYYYMMDD, 0 for non-expiring instruments
+    int32_t lot_size;
+    double strike;      // Rupees, as written by BSEtokens
+    char symbol[24];
+    char name[16];
+};
+
+static_assert(sizeof(Instrument) == 64, "Instrument should fill exactly one cache line");
+
+struct InstrumentFeedState {
+    std::atomic<int64_t> sequence{0};            // 0 until the first tick of the current session
+    std::atomic<int64_t> exchange_timestamp{0};  // Epoch ms
+};
+
+// Parses "13DEC2024" into 20241213; returns 0 for anything else.
+inline int32_t parse_expiry_ddmmmyyyy(const std::string& text) {
+    static const char* months[] = {
+        "JAN", "FEB", "MAR", "APR", "MAY", "JUN",
+        "JUL", "AUG", "SEP", "OCT", "NOV", "DEC"
+    };
+    if (text.size() != 9) {
+        return 0;
+    }
+    int month = 0;
+    for (int i = 0; i < 12; ++i) {
+        if (text.compare(2, 3, months[i]) == 0) {
+            month = i + 1;
+            break;
+        }
+    }
+    if (month == 0) {
+        return 0;
+    }
+    int day = std::atoi(text.substr(0, 2).c_str());
+    int year = std::atoi(text.substr(5, 4).c_str());
+    return year * 10000 + month * 100 + day;
+}
+
+class InstrumentTable {
+public:
+    static constexpr int32_t NOT_FOUND = -1;
+
+    // Appends an instrument. Call build_index() once all rows are loaded.
+    void add(const std::string& token, const std::string& symbol, const std::string& name,
+             const std::string& expiry, const std::string& strike, const std::string& lotsize,
+             uint8_t exchange_type) {
+        Instrument instrument{};
+        instrument.token = static_cast<uint32_t>(std::strtoul(token.c_str(), nullptr, 10));
+        if (instrument.token == 0) {
+            return;
+        }
+        instrument.exchange_type = exchange_type;
+        instrument.expiry = parse_expiry_ddmmmyyyy(expiry);
+        instrument.lot_size = std::atoi(lotsize.c_str());
+        instrument.strike = std::strtod(strike.c_str(), nullptr);
+        std::strncpy(instrument.symbol, symbol.c_str(), sizeof(instrument.symbol) - 1);
+        std::strncpy(instrument.name, name.c_str(), sizeof(instrument.name) - 1);
+
+        size_t length = symbol.size();
+        if (length > 2 && symbol.compare(length - 2, 2, "CE") == 0) {
+            instrument.option_type = OPTION_CALL;
+        } else if (length > 2 && symbol.compare(length - 2, 2, "PE") == 0) {
+            instrument.option_type = OPTION_PUT;
+        }
+        instruments_.push_back(instrument);
+    }
+
+    // Builds the token index. Duplicate tokens keep their first row.
+    void build_index() {
+        size_t capacity = 16;
+        while (capacity < instruments_.size() * 2) {
+            capacity <<= 1;
+        }
+        mask_ = static_cast<uint32_t>(capacity - 1);
+        shift_ = 32;
+        for (size_t c = capacity; c > 1; c >>= 1) {
+            --shift_;
+        }
+        keys_.assign(capacity, 0);
+        values_.assign(capacity, 0);
+
+        std::vector<Instrument> unique;
+        unique.reserve(instruments_.size());
+        for (const auto& instrument : instruments_) {
+            uint32_t slot = slot_for(instrument.token);
+            while (keys_[slot] != 0 && keys_[slot] != instrument.token) {
+                slot = (slot + 1) & mask_;
+            }
+            if (keys_[slot] == instrument.token) {
+                continue;
+            }
+            keys_[slot] = instrument.token;
+            values_[slot] = static_cast<uint32_t>(unique.size());
+            unique.push_back(instrument);
+        }
+        instruments_.swap(unique);
+        instruments_.shrink_to_fit();
+        feed_state_.reset(new InstrumentFeedState[instruments_.size()]);
+    }
+
+    int32_t index_of(uint32_t token) const {
+        if (keys_.empty() || token == 0) {
+            return NOT_FOUND;
+        }
+        uint32_t slot = slot_for(token);
+        while (true) {
+            uint32_t key = keys_[slot];
+            if (key == token) {
+                return static_cast<int32_t>(values_[slot]);
+            }
+            if (key == 0) {
+                return NOT_FOUND;
+            }
+            slot = (slot + 1) & mask_;
+        }
+    }
+
+    const Instrument* find(uint32_t token) const {
+        int32_t index = index_of(token);
+        return index == NOT_FOUND ? nullptr : &instruments_[index];
+    }
+
+    const Instrument& at(size_t index) const { return instruments_[index]; }
+    InstrumentFeedState& feed_state(size_t index) const { return feed_state_[index]; }
+    const std::vector<Instrument>& instruments() const { return instruments_; }
+    size_t size() const { return instruments_.size(); }
+    size_t index_slots() const { return keys_.size(); }
+
+    size_t memory_bytes() const {
+        return instruments_.capacity() * sizeof(Instrument) +
+               keys_.capacity() * sizeof(uint32_t) + values_.capacity() * sizeof(uint32_t) +
+               instruments_.size() * sizeof(InstrumentFeedState);
+    }
+
+private:
+    uint32_t slot_for(uint32_t token) const {
+        // Fibonacci hashing: the high bits of the product are well mixed even
+        // for the sequential token ranges the exchange hands out.
+        return (token * 2654435769u) >> shift_;
+    }
+
+    std::vector<Instrument> instruments_;
+    std::vector<uint32_t> keys_;
+    std::vector<uint32_t> values_;
+    std::unique_ptr<InstrumentFeedState[]> feed_state_;
+    uint32_t mask_ = 0;
+    uint32_t shift_ = 32;
+};
@@ -0,0 +1,282 @@
+#pragma once
+
+// Kafka producer stage for the decoded tick stream.
+//
+// Ticks are re-encoded into their SmartStream wire packet (decode_tick() in
+// smartstream.hpp reads them back) and keyed by the 4-byte little-endian
+// token, so librdkafka's key partitioner keeps each instrument ordered within
+// one partition. The Kafka message timestamp is the exchange timestamp.
+// Closed bars, when a bar topic is set, go to their own topic as the raw
+// little-endian Bar struct (tick_dispatcher.hpp) under the same key.
+//
+// produce() only enqueues into librdkafka's buffer; batching, compression and
+// acks are librdkafka's job. Each topic's handle is created once in start(),
+// so producing never looks the topic up by name. The C++ produce(Topic*)
+// overloads take no timestamp, so messages go through rd_kafka_producev()
+// on the same handles. Delivery reports are served by a dedicated poll
+// thread, never by a consumer or the network thread.
+
+#include <rdkafka.h>
+#include <rdkafkacpp.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "smartstream.hpp"
+#include "tick_dispatcher.hpp"
+
+struct KafkaSettings {
+    std::string brokers;
+    std::string tick_topic = "bse.ticks";
+    std::string bar_topic;  // Empty: bars are not produced
+    std::string linger_ms = "5";
+    std::string batch_size = "1000000";
+    std::string compression = "lz4";
+    std::string acks = "1";
+    std::string queue_max_messages = "1000000";
+    int stats_interval_s = 60;
+    // Passed to librdkafka as is, e.g. test.mock.num.brokers for a stand-in
+    // cluster inside the producer
+    std::vector<std::pair<std::string, std::string>> extra_properties;
+};
+
+struct KafkaTopicStats {
+    std::string topic;
+    std::unique_ptr<RdKafka::Topic> handle;  // From start() until stop()
+    std::atomic<uint64_t> produced{0};
+    std::atomic<uint64_t> queue_full{0};
+    std::atomic<uint64_t> produce_errors{0};
+    std::atomic<uint64_t> delivered{0};
+    std::atomic<uint64_t> delivery_failed{0};
+    std::atomic<uint64_t> bytes_delivered{0};
+    std::atomic<uint64_t> latency_ns_sum{0};
+    std::atomic<uint64_t> latency_ns_max{0};
+};
+
+class KafkaSink : public TickSink, public RdKafka::DeliveryReportCb {
+public:
+    static constexpr size_t TICK_TOPIC = 0;
+
+    KafkaSink() {
+        topics_.emplace_back(new KafkaTopicStats());
+    }
+
+    KafkaSink(const KafkaSink&) = delete;
+    KafkaSink& operator=(const KafkaSink&) = delete;
+
+    ~KafkaSink() override {
+        stop();
+    }
+
+    // Registers an extra topic before start(); returns the index to produce to.
+    // The delivery opaque has room for 16 topics.
+    size_t add_topic(const std::string& topic) {
+        if (topics_.size() == 16) {
+            return TICK_TOPIC;
+        }
+        topics_.emplace_back(new KafkaTopicStats());
+        topics_.back()->topic = topic;
+        return topics_.size() - 1;
+    }
+
+    bool start(const KafkaSettings& settings, std::string& error) {
+        settings_ = settings;
+        topics_[TICK_TOPIC]->topic = settings_.tick_topic;
+        if (!settings_.bar_topic.empty()) {
+            bar_topic_ = add_topic(settings_.bar_topic);
+        }
+
+        std::unique_ptr<RdKafka::Conf> conf(RdKafka::Conf::create(RdKafka::Conf::CONF_GLOBAL));
+        const std::pair<const char*, const std::string*> properties[] = {
+            {"bootstrap.servers", &settings_.brokers},
+            {"linger.ms", &settings_.linger_ms},
+            {"batch.size", &settings_.batch_size},
+            {"compression.codec", &settings_.compression},
+            {"acks", &settings_.acks},
+            {"queue.buffering.max.messages", &settings_.queue_max_messages},
+        };
+        for (const auto& property : properties) {
+            if (property.second->empty()) {
+                continue;
+            }
+            if (conf->set(property.first, *property.second, error) != RdKafka::Conf::CONF_OK) {
+                return false;
+            }
+        }
+        for (const auto& property : settings_.extra_properties) {
+            if (conf->set(property.first, property.second, error) != RdKafka::Conf::CONF_OK) {
+                return false;
+            }
+        }
+        if (conf->set("dr_cb", static_cast<RdKafka::DeliveryReportCb*>(this), error) != RdKafka::Conf::CONF_OK) {
+            return false;
+        }
+
+        producer_.reset(RdKafka::Producer::create(conf.get(), error));
+        if (!producer_) {
+            return false;
+        }
+        for (auto& stats : topics_) {
+            stats->handle.reset(RdKafka::Topic::create(producer_.get(), stats->topic, nullptr, error));
+            if (!stats->handle) {
+                error = "topic " + stats->topic + ": " + error;
+                release_producer();
+                return false;
+            }
+        }
+
+        running_ = true;
+        poll_thread_ = std::thread(&KafkaSink::poll_loop, this);
+        return true;
+    }
+
+    // Flushes outstanding messages (bounded wait) and stops the poll thread.
+    // Returns the number of messages still undelivered after the flush.
+    int stop() {
+        if (!running_.exchange(false)) {
+            return 0;
+        }
+        poll_thread_.join();
+        producer_->flush(5000);
+        int undelivered = producer_->outq_len();
+        std::cout << report();
+        if (undelivered > 0) {
+            std::cout << "Kafka: " << undelivered << " messages undelivered at stop" << std::endl;
+        }
+        release_producer();
+        return undelivered;
+    }
+
+    void on_tick(const Tick& tick, int32_t instrument_index) override {
+        char packet[MAX_PACKET_SIZE];
+        size_t size = encode_tick(tick, packet);
+        if (size != 0) {
+            produce(TICK_TOPIC, tick.token, packet, size, tick.exchange_timestamp);
+        }
+    }
+
+    void on_bar(const Bar& bar, int32_t instrument_index) override {
+        if (bar_topic_ != TICK_TOPIC) {
+            produce(bar_topic_, bar.token, reinterpret_cast<const char*>(&bar), sizeof(bar), bar.start_ms);
+        }
+    }
+
+    // Enqueues one message. Never blocks: a full local queue is counted and the
+    // message dropped, since stale market data is worth less than a stall.
+    bool produce(size_t topic_index, uint32_t key, const char* payload, size_t size, int64_t timestamp_ms) {
+        KafkaTopicStats& stats = *topics_[topic_index];
+        // The opaque carries the enqueue time and topic index back to dr_cb
+        // without allocating.
+        uintptr_t opaque = (static_cast<uintptr_t>(steady_now_ns()) << 4) | (topic_index & 0xF);
+
+        rd_kafka_resp_err_t result = rd_kafka_producev(
+            producer_->c_ptr(),
+            RD_KAFKA_V_RKT(stats.handle->c_ptr()),
+            RD_KAFKA_V_PARTITION(RD_KAFKA_PARTITION_UA),
+            RD_KAFKA_V_MSGFLAGS(RD_KAFKA_MSG_F_COPY),
+            RD_KAFKA_V_VALUE(const_cast<char*>(payload), size),
+            RD_KAFKA_V_KEY(&key, sizeof(key)),
+            RD_KAFKA_V_TIMESTAMP(timestamp_ms),
+            RD_KAFKA_V_OPAQUE(reinterpret_cast<void*>(opaque)),
+            RD_KAFKA_V_END);
+
+        if (result == RD_KAFKA_RESP_ERR_NO_ERROR) {
+            stats.produced.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        if (result == RD_KAFKA_RESP_ERR__QUEUE_FULL) {
+            stats.queue_full.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            stats.produce_errors.fetch_add(1, std::memory_order_relaxed);
+        }
+        return false;
+    }
+
+    void dr_cb(RdKafka::Message& message) override {
+        uintptr_t opaque = reinterpret_cast<uintptr_t>(message.msg_opaque());
+        size_t topic_index = opaque & 0xF;
+        if (topic_index >= topics_.size()) {
+            return;
+        }
+        KafkaTopicStats& stats = *topics_[topic_index];
+
+        if (message.err() != RdKafka::ERR_NO_ERROR) {
+            stats.delivery_failed.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        uint64_t latency = static_cast<uint64_t>(steady_now_ns()) - (opaque >> 4);
+        stats.delivered.fetch_add(1, std::memory_order_relaxed);
+        stats.bytes_delivered.fetch_add(message.len(), std::memory_order_relaxed);
+        stats.latency_ns_sum.fetch_add(latency, std::memory_order_relaxed);
+        if (latency > stats.latency_ns_max.load(std::memory_order_relaxed)) {
+            stats.latency_ns_max.store(latency, std::memory_order_relaxed);
+        }
+    }
+
+    const std::vector<std::unique_ptr<KafkaTopicStats>>& topics() const { return topics_; }
+
+    std::string report() const {
+        std::ostringstream out;
+        for (const auto& stats : topics_) {
+            uint64_t delivered = stats->delivered.load();
+            out << "Kafka " << stats->topic
+                << ": produced " << stats->produced.load()
+                << ", delivered " << delivered
+                << ", failed " << stats->delivery_failed.load()
+                << ", queue full " << stats->queue_full.load()
+                << ", errors " << stats->produce_errors.load()
+                << ", bytes " << stats->bytes_delivered.load()
+                << std::fixed << std::setprecision(3)
+                << ", avg latency " << (delivered ? stats->latency_ns_sum.load() / 1e6 / delivered : 0.0) << " ms"
+                << ", max latency " << stats->latency_ns_max.load() / 1e6 << " ms\n";
+        }
+        return out.str();
+    }
+
+private:
+    // Topic handles hold a reference on the producer, so they go first
+    void release_producer() {
+        for (auto& stats : topics_) {
+            stats->handle.reset();
+        }
+        producer_.reset();
+    }
+
+    void poll_loop() {
+        auto last_report = std::chrono::steady_clock::now();
+        std::vector<uint64_t> last_delivered(topics_.size(), 0);
+
+        while (running_.load(std::memory_order_relaxed)) {
+            producer_->poll(100);
+
+            auto now = std::chrono::steady_clock::now();
+            double elapsed = std::chrono::duration<double>(now - last_report).count();
+            if (settings_.stats_interval_s > 0 && elapsed >= settings_.stats_interval_s) {
+                for (size_t i = 0; i < topics_.size(); ++i) {
+                    uint64_t delivered = topics_[i]->delivered.load();
+                    std::cout << "Kafka " << topics_[i]->topic << ": "
+                              << static_cast<uint64_t>((delivered - last_delivered[i]) / elapsed)
+                              << " msg/s, queued " << producer_->outq_len() << std::endl;
+                    last_delivered[i] = delivered;
+                }
+                last_report = now;
+            }
+        }
+    }
+
+    KafkaSettings settings_;
+    std::unique_ptr<RdKafka::Producer> producer_;
+    std::vector<std::unique_ptr<KafkaTopicStats>> topics_;
+    size_t bar_topic_ = TICK_TOPIC;  // TICK_TOPIC while bars are off
+    std::thread poll_thread_;
+    std::atomic<bool> running_{false};
+};
@@ -0,0 +1,158 @@
+#pragma once
+
+// Lock-free log-linear latency histogram (HDR style).
+//
+// Values are bucketed by power of two with 32 linear sub-buckets each, which
+// bounds the relative error to about 3% over the full 64-bit range. record()
+// takes relaxed atomic read-modify-writes, so any number of threads may
+// record concurrently. A histogram with one writer thread can use
+// record_local() instead, which is plain relaxed stores like LocalCounter;
+// hot paths keep one per thread and merge the snapshots. Readers take a
+// snapshot and compute percentiles from it.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BITS = 5;
+    static constexpr uint64_t SUB_COUNT = 1ull << SUB_BITS;
+    static constexpr size_t BUCKET_COUNT = (64 - SUB_BITS + 1) * SUB_COUNT;
+
+    struct Snapshot {
+        std::vector<uint64_t> counts;
+        uint64_t total = 0;
+        uint64_t sum = 0;
+        uint64_t max = 0;
+
+        // Upper bound of the bucket holding the p-th percentile (0..100).
+        uint64_t percentile(double p) const {
+            if (total == 0) {
+                return 0;
+            }
+            uint64_t rank = static_cast<uint64_t>(p / 100.0 * total + 0.5);
+            rank = std::max<uint64_t>(1, std::min(rank, total));
+            uint64_t seen = 0;
+            for (size_t i = 0; i < counts.size(); ++i) {
+                seen += counts[i];
+                if (seen >= rank) {
+                    return std::min(bucket_upper(i), max);
+                }
+            }
+            return max;
+        }
+
+        // Adds another histogram's samples, e.g. one per writer thread
+        void merge(const Snapshot& other) {
+            counts.resize(std::max(counts.size(), other.counts.size()));
+            for (size_t i = 0; i < other.counts.size(); ++i) {
+                counts[i] += other.counts[i];
+            }
+            total += other.total;
+            sum += other.sum;
+            max = std::max(max, other.max);
+        }
+
+        double mean() const {
+            return total ? static_cast<double>(sum) / total : 0.0;
+        }
+
+        // Interval view: this snapshot minus an earlier one of the same histogram.
+        Snapshot since(const Snapshot& earlier) const {
+            Snapshot delta;
+            delta.counts.resize(counts.size());
+            for (size_t i = 0; i < counts.size(); ++i) {
+                delta.counts[i] = counts[i] - (i < earlier.counts.size() ? earlier.counts[i] : 0);
+                if (delta.counts[i] != 0) {
+                    delta.max = bucket_upper(i);
+                }
+            }
+            delta.total = total - earlier.total;
+            delta.sum = sum - earlier.sum;
+            delta.max = std::min(delta.max, max);
+            return delta;
+        }
+
+        // "count=.. mean=.. p50=.. p90=.. p99=.. p99.9=.. max=.." in the given unit.
+        std::string summary(double divisor = 1e3, const char* unit = "us") const {
+            std::ostringstream out;
+            out << std::fixed << std::setprecision(1)
+                << "count=" << total
+                << " mean=" << mean() / divisor << unit
+                << " p50=" << percentile(50) / divisor << unit
+                << " p90=" << percentile(90) / divisor << unit
+                << " p99=" << percentile(99) / divisor << unit
+                << " p99.9=" << percentile(99.9) / divisor << unit
+                << " max=" << max / divisor << unit;
+            return out.str();
+        }
+    };
+
+    LatencyHistogram() {
+        for (auto& count : counts_) {
+            count.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void record(int64_t value) {
+        uint64_t v = value < 0 ? 0 : static_cast<uint64_t>(value);
+        counts_[bucket_of(v)].fetch_add(1, std::memory_order_relaxed);
+        total_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(v, std::memory_order_relaxed);
+        uint64_t current = max_.load(std::memory_order_relaxed);
+        while (v > current && !max_.compare_exchange_weak(current, v, std::memory_order_relaxed)) {
+        }
+    }
+
+    // Only for a histogram that no other thread records into
+    void record_local(int64_t value) {
+        uint64_t v = value < 0 ? 0 : static_cast<uint64_t>(value);
+        std::atomic<uint64_t>& count = counts_[bucket_of(v)];
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        total_.store(total_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        sum_.store(sum_.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+        if (v > max_.load(std::memory_order_relaxed)) {
+            max_.store(v, std::memory_order_relaxed);
+        }
+    }
+
+    Snapshot snapshot() const {
+        Snapshot snap;
+        snap.counts.resize(BUCKET_COUNT);
+        for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+            snap.counts[i] = counts_[i].load(std::memory_order_relaxed);
+        }
+        snap.total = total_.load(std::memory_order_relaxed);
+        snap.sum = sum_.load(std::memory_order_relaxed);
+        snap.max = max_.load(std::memory_order_relaxed);
+        return snap;
+    }
+
+    static size_t bucket_of(uint64_t value) {
+        if (value < SUB_COUNT) {
+            return static_cast<size_t>(value);
+        }
+        int shift = 63 - __builtin_clzll(value) - SUB_BITS;
+        return ((shift + 1) << SUB_BITS) + static_cast<size_t>((value >> shift) - SUB_COUNT);
+    }
+
+    static uint64_t bucket_upper(size_t bucket) {
+        if (bucket < SUB_COUNT) {
+            return bucket;
+        }
+        int shift = static_cast<int>(bucket >> SUB_BITS) - 1;
+        uint64_t lower = ((bucket & (SUB_COUNT - 1)) + SUB_COUNT) << shift;
+        return lower + ((1ull << shift) - 1);
+    }
+
+private:
+    std::atomic<uint64_t> counts_[BUCKET_COUNT];
+    std::atomic<uint64_t> total_{0};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> max_{0};
+};
@@ -0,0 +1,106 @@
+#pragma once
+
+// Exchange-time helpers. SmartStream timestamps are epoch milliseconds; BSE
+// trades on IST (UTC+05:30, no DST), so all calendar maths here is a fixed
+// offset and never touches the process time zone.
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <set>
+#include <string>
+
+constexpr int64_t IST_OFFSET_MS = 19800000;  // 5h30m
+constexpr int64_t MS_PER_DAY = 86400000;
+
+inline int64_t ist_day_number(int64_t epoch_ms) {
+    int64_t local = epoch_ms + IST_OFFSET_MS;
+    return local >= 0 ? local / MS_PER_DAY : (local - MS_PER_DAY + 1) / MS_PER_DAY;
+}
+
+// Milliseconds since IST midnight.
+inline int64_t ist_ms_of_day(int64_t epoch_ms) {
+    return epoch_ms + IST_OFFSET_MS - ist_day_number(epoch_ms) * MS_PER_DAY;
+}
+
+inline int32_t ist_minute_of_day(int64_t epoch_ms) {
+    return static_cast<int32_t>(ist_ms_of_day(epoch_ms) / 60000);
+}
+
+// Days since 1970-01-01 to YYYYMMDD (proleptic Gregorian).
+inline int32_t civil_date_from_days(int64_t days) {
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    int64_t doe = days - era * 146097;
+    int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int64_t y = yoe + era * 400;
+    int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int64_t mp = (5 * doy + 2) / 153;
+    int64_t d = doy - (153 * mp + 2) / 5 + 1;
+    int64_t m = mp < 10 ? mp + 3 : mp - 9;
+    y += m <= 2;
+    return static_cast<int32_t>(y * 10000 + m * 100 + d);
+}
+
+// YYYYMMDD to days since 1970-01-01.
+inline int64_t days_from_civil_date(int32_t yyyymmdd) {
+    int64_t y = yyyymmdd / 10000;
+    int64_t m = (yyyymmdd / 100) % 100;
+    int64_t d = yyyymmdd % 100;
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+inline int32_t ist_date(int64_t epoch_ms) {
+    return civil_date_from_days(ist_day_number(epoch_ms));
+}
+
+// 0 = Sunday ... 6 = Saturday; 1970-01-01 was a Thursday.
+inline int ist_weekday(int64_t day_number) {
+    int64_t weekday = (day_number + 4) % 7;
+    return static_cast<int>(weekday < 0 ? weekday + 7 : weekday);
+}
+
+// BSE equity and derivatives continuous session, 09:15 to 15:30 IST.
+constexpr int64_t SESSION_OPEN_MS = (9 * 60 + 15) * 60000;
+constexpr int64_t SESSION_CLOSE_MS = (15 * 60 + 30) * 60000;
+
+// Weekends plus the holidays listed in config/settings/Holiday.ini, one
+// "holidayN = D,M,YYYY" line each (the format BSEtokens reads).
+class TradingCalendar {
+public:
+    // Returns false if the file could not be read; the calendar then only
+    // knows about weekends.
+    bool load(const std::string& filename) {
+        std::ifstream file(filename);
+        if (!file.is_open()) {
+            return false;
+        }
+        std::string line;
+        while (std::getline(file, line)) {
+            size_t equals = line.find('=');
+            if (equals == std::string::npos || line.find("holiday") == std::string::npos) {
+                continue;
+            }
+            int day = 0, month = 0, year = 0;
+            if (std::sscanf(line.c_str() + equals + 1, " %d , %d , %d", &day, &month, &year) == 3) {
+                holidays_.insert(year * 10000 + month * 100 + day);
+            }
+        }
+        return true;
+    }
+
+    bool is_trading_day(int64_t day_number) const {
+        int weekday = ist_weekday(day_number);
+        return weekday != 0 && weekday != 6 && holidays_.count(civil_date_from_days(day_number)) == 0;
+    }
+
+    size_t holiday_count() const { return holidays_.size(); }
+
+private:
+    std::set<int32_t> holidays_;  // YYYYMMDD
+};
@@ -0,0 +1,331 @@
+#pragma once
+
+// Metrics surface for ws: Prometheus text served on a local port and/or
+// written to a snapshot file.
+//
+// Nothing here runs on the network thread. Hot-path code only bumps
+// counters: LocalCounter for values with a single writing thread (a plain
+// load and store, no locked instruction or shared cache line ping-pong) and
+// relaxed atomics elsewhere. A collector callback reads them when a scrape
+// arrives or the snapshot is due, so the cost of formatting is paid on the
+// metrics thread alone.
+//
+// Counters registered with a rate also get a "<name>_per_second" gauge
+// (the "_total" suffix replaced) computed over the last interval, for
+// readers of the snapshot file that have no Prometheus rate().
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Counter written by one thread and read by any; add() is not atomic with
+// respect to other writers
+class LocalCounter {
+public:
+    void add(uint64_t n = 1) {
+        value_.store(value_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    uint64_t load() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+// One label pair, escaped for the Prometheus text format
+inline std::string metric_label(const std::string& name, const std::string& value) {
+    std::string out = name + "=\"";
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            out += '\\';
+            out += c;
+        } else if (c == '\n') {
+            out += "\\n";
+        } else {
+            out += c;
+        }
+    }
+    return out + '"';
+}
+
+struct MetricFamily {
+    struct Sample {
+        std::string labels;  // Comma-separated label pairs, empty for none
+        double value;
+    };
+
+    std::string name;
+    std::string type;  // "counter" or "gauge"
+    std::string help;
+    bool rate = false;
+    std::vector<Sample> samples;
+
+    MetricFamily& add(double value) {
+        return add(std::string(), value);
+    }
+
+    MetricFamily& add(const std::string& labels, double value) {
+        samples.push_back(Sample{labels, value});
+        return *this;
+    }
+};
+
+// Families keep their address as more are added, so a caller may hold on to
+// one while registering others
+class MetricsSnapshot {
+public:
+    MetricFamily& counter(const std::string& name, const std::string& help, bool rate = false) {
+        families_.push_back(MetricFamily{name, "counter", help, rate, {}});
+        return families_.back();
+    }
+
+    MetricFamily& gauge(const std::string& name, const std::string& help) {
+        families_.push_back(MetricFamily{name, "gauge", help, false, {}});
+        return families_.back();
+    }
+
+    const std::deque<MetricFamily>& families() const { return families_; }
+
+    void append(const std::vector<MetricFamily>& families) {
+        families_.insert(families_.end(), families.begin(), families.end());
+    }
+
+    std::string render() const {
+        std::string out;
+        char number[32];
+        for (const auto& family : families_) {
+            out += "# HELP " + family.name + " " + family.help + "\n";
+            out += "# TYPE " + family.name + " " + family.type + "\n";
+            for (const auto& sample : family.samples) {
+                out += family.name;
+                if (!sample.labels.empty()) {
+                    out += "{" + sample.labels + "}";
+                }
+                std::snprintf(number, sizeof(number), " %.15g\n", sample.value);
+                out += number;
+            }
+        }
+        return out;
+    }
+
+private:
+    std::deque<MetricFamily> families_;
+};
+
+struct MetricsSettings {
+    int port = 0;                        // 0 disables the HTTP endpoint
+    std::string bind_address = "127.0.0.1";
+    std::string file;                    // Empty disables the snapshot file
+    int interval_s = 5;                  // Rate window and snapshot period
+};
+
+class MetricsServer {
+public:
+    typedef std::function<void(MetricsSnapshot&)> Collector;
+
+    ~MetricsServer() {
+        stop();
+    }
+
+    bool start(const MetricsSettings& settings, Collector collector, std::string& error) {
+        settings_ = settings;
+        settings_.interval_s = std::max(1, settings_.interval_s);
+        collector_ = std::move(collector);
+        if (settings_.port > 0 && !listen_on(error)) {
+            return false;
+        }
+        running_ = true;
+        thread_ = std::thread(&MetricsServer::run, this);
+        return true;
+    }
+
+    void stop() {
+        if (!running_.exchange(false)) {
+            return;
+        }
+        thread_.join();
+        if (listen_fd_ >= 0) {
+            ::close(listen_fd_);
+            listen_fd_ = -1;
+        }
+    }
+
+    // Current counters plus the rates from the last completed interval
+    std::string render() {
+        MetricsSnapshot snapshot;
+        collector_(snapshot);
+        std::lock_guard<std::mutex> lock(rates_mutex_);
+        snapshot.append(rates_);
+        return snapshot.render();
+    }
+
+private:
+    MetricsSettings settings_;
+    Collector collector_;
+    int listen_fd_ = -1;
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+
+    std::mutex rates_mutex_;
+    std::vector<MetricFamily> rates_;
+    std::map<std::string, double> last_values_;
+    std::chrono::steady_clock::time_point last_time_;
+
+    bool listen_on(std::string& error) {
+        listen_fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (listen_fd_ < 0) {
+            error = std::string("socket: ") + std::strerror(errno);
+            return false;
+        }
+        int reuse = 1;
+        setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(static_cast<uint16_t>(settings_.port));
+        if (inet_pton(AF_INET, settings_.bind_address.c_str(), &address.sin_addr) != 1) {
+            error = "invalid bind address " + settings_.bind_address;
+        } else if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+            error = "bind " + settings_.bind_address + ":" + std::to_string(settings_.port) + ": " + std::strerror(errno);
+        } else if (::listen(listen_fd_, 16) < 0) {
+            error = std::string("listen: ") + std::strerror(errno);
+        } else {
+            return true;
+        }
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+        return false;
+    }
+
+    void run() {
+        last_time_ = std::chrono::steady_clock::now();
+        update_rates(last_time_);
+        auto next_tick = last_time_ + std::chrono::seconds(settings_.interval_s);
+
+        while (running_.load()) {
+            if (listen_fd_ >= 0) {
+                pollfd fd{listen_fd_, POLLIN, 0};
+                if (::poll(&fd, 1, 100) > 0) {
+                    serve(::accept(listen_fd_, nullptr, nullptr));
+                }
+            } else {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+
+            auto now = std::chrono::steady_clock::now();
+            if (now >= next_tick) {
+                update_rates(now);
+                if (!settings_.file.empty()) {
+                    write_file(render());
+                }
+                next_tick = now + std::chrono::seconds(settings_.interval_s);
+            }
+        }
+    }
+
+    void update_rates(std::chrono::steady_clock::time_point now) {
+        MetricsSnapshot snapshot;
+        collector_(snapshot);
+        double seconds = std::chrono::duration<double>(now - last_time_).count();
+        std::vector<MetricFamily> rates;
+        for (const auto& family : snapshot.families()) {
+            if (!family.rate) {
+                continue;
+            }
+            std::string name = family.name;
+            if (name.size() > 6 && name.compare(name.size() - 6, 6, "_total") == 0) {
+                name.resize(name.size() - 6);
+            }
+            MetricFamily rate{name + "_per_second", "gauge", family.help + ", per second over the last interval", false, {}};
+            for (const auto& sample : family.samples) {
+                std::string key = family.name + "{" + sample.labels + "}";
+                auto it = last_values_.find(key);
+                double delta = it == last_values_.end() ? 0 : sample.value - it->second;
+                rate.add(sample.labels, seconds > 0 && delta > 0 ? delta / seconds : 0);
+                last_values_[key] = sample.value;
+            }
+            rates.push_back(std::move(rate));
+        }
+        last_time_ = now;
+        std::lock_guard<std::mutex> lock(rates_mutex_);
+        rates_.swap(rates);
+    }
+
+    // Answers one HTTP request; anything but GET /metrics gets a 404
+    void serve(int client) {
+        if (client < 0) {
+            return;
+        }
+        timeval timeout{1, 0};
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        std::string request;
+        char buffer[1024];
+        while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192) {
+            ssize_t received = ::recv(client, buffer, sizeof(buffer), 0);
+            if (received <= 0) {
+                break;
+            }
+            request.append(buffer, static_cast<size_t>(received));
+        }
+
+        std::string status = "200 OK";
+        std::string body;
+        if (request.compare(0, 12, "GET /metrics") == 0 && request.size() > 12 && (request[12] == ' ' || request[12] == '?')) {
+            body = render();
+        } else {
+            status = "404 Not Found";
+            body = "Not found; metrics are at /metrics\n";
+        }
+        std::string response = "HTTP/1.1 " + status + "\r\n"
+                               "Content-Type: text/plain; version=0.0.4\r\n"
+                               "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                               "Connection: close\r\n\r\n" + body;
+        size_t sent = 0;
+        while (sent < response.size()) {
+            ssize_t result = ::send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+            if (result <= 0) {
+                break;
+            }
+            sent += static_cast<size_t>(result);
+        }
+        ::close(client);
+    }
+
+    // Replaces the snapshot atomically so readers never see a partial file
+    void write_file(const std::string& text) {
+        std::filesystem::path path(settings_.file);
+        if (path.has_parent_path() && !std::filesystem::exists(path.parent_path())) {
+            std::filesystem::create_directories(path.parent_path());
+        }
+        std::string temporary = settings_.file + ".tmp";
+        {
+            std::ofstream out(temporary, std::ios::trunc);
+            out << text;
+            if (!out) {
+                return;
+            }
+        }
+        std::rename(temporary.c_str(), settings_.file.c_str());
+    }
+};
@@ -0,0 +1,309 @@
+#pragma once
+
+// Option chains as dense strike-indexed matrices.
+//
+// Every (underlying, expiry) pair in the instrument table gets a chain: one
+// row per listed strike, ascending, each holding a CE and a PE quote. The
+// instrument table index of every option is mapped to its chain and slot
+// when the table is loaded, so a tick lands on its slot with two array loads
+// and no search.
+//
+// Chain-level aggregates are kept current by applying each tick's change in
+// OI or volume, never by rescanning the chain:
+//   - call and put OI and volume totals, and so PCR by OI and by volume
+//   - OI change against the previous day's close, per slot and in total,
+//     derived from the SnapQuote OI change percentage
+//   - max pain, from a Fenwick tree of call + put OI per strike. Total payout
+//     to holders is convex in the settlement strike, and its slope past
+//     strike k is (call OI at or below k) - (put OI above k), so max pain is
+//     the first strike where cumulative call + put OI reaches the total put
+//     OI: one O(log n) descent after each OI change
+//   - the ATM straddle, from the strike nearest the index of the same name
+//
+// Ticks for one chain arrive on several consumer threads, so each chain has
+// a mutex, held for the few stores of one tick. Rows are trivially copyable
+// and contiguous, so snapshot() is a single copy under that lock and always
+// consistent with summary().
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "instrument_table.hpp"
+#include "smartstream.hpp"
+#include "tick_dispatcher.hpp"
+
+// One side of a strike, prices in paise
+struct ChainQuote {
+    uint32_t token;           // 0 if the strike is not listed on this side
+    int64_t ltp;
+    int64_t bid;              // Best bid and ask, SnapQuote only
+    int64_t ask;
+    int64_t volume;           // Day volume
+    int64_t open_interest;
+    int64_t oi_change;        // Against the previous day's close
+    int64_t exchange_timestamp;
+};
+
+struct ChainRow {
+    double strike;  // Rupees
+    ChainQuote call;
+    ChainQuote put;
+};
+
+static_assert(std::is_trivially_copyable<ChainRow>::value, "Chain rows are copied as one block");
+
+struct ChainSummary {
+    std::string name;
+    int32_t expiry;          // YYYYMMDD
+    size_t strikes;
+    double index_price;      // Rupees, 0 before the first index tick
+    int64_t call_oi;
+    int64_t put_oi;
+    int64_t call_volume;
+    int64_t put_volume;
+    int64_t call_oi_change;
+    int64_t put_oi_change;
+    double pcr_oi;           // Put / call, 0 while the call side is 0
+    double pcr_volume;
+    double max_pain;         // Strike, 0 without OI
+    double atm_strike;       // 0 before the first index tick
+    double atm_straddle;     // ATM CE + PE LTP, rupees
+};
+
+class OptionChainBook : public TickSink {
+public:
+    explicit OptionChainBook(const InstrumentTable& instruments)
+        : slot_of_(instruments.size(), SlotRef{-1, 0}) {
+        build(instruments);
+    }
+
+    size_t chain_count() const { return chains_.size(); }
+
+    // Chain for an underlying and expiry, -1 if there is none
+    int find(const std::string& name, int32_t expiry) const {
+        for (size_t i = 0; i < chains_.size(); ++i) {
+            if (chains_[i]->name == name && chains_[i]->expiry == expiry) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+    void on_tick(const Tick& tick, int32_t instrument_index) override {
+        if (instrument_index < 0 || static_cast<size_t>(instrument_index) >= slot_of_.size()) {
+            return;
+        }
+        const SlotRef& ref = slot_of_[instrument_index];
+        if (ref.chain >= 0) {
+            update_option(*chains_[ref.chain], ref.slot, tick);
+            return;
+        }
+        if (ref.slot > 0 && tick.ltp > 0) {
+            for (int chain : chains_of_index_[ref.slot - 1]) {
+                update_index(*chains_[chain], tick.ltp);
+            }
+        }
+    }
+
+    ChainSummary summary(size_t chain_index) const {
+        const Chain& chain = *chains_[chain_index];
+        std::lock_guard<std::mutex> lock(chain.mutex);
+        ChainSummary out;
+        out.name = chain.name;
+        out.expiry = chain.expiry;
+        out.strikes = chain.rows.size();
+        out.index_price = chain.index_ltp / 100.0;
+        out.call_oi = chain.call_oi;
+        out.put_oi = chain.put_oi;
+        out.call_volume = chain.call_volume;
+        out.put_volume = chain.put_volume;
+        out.call_oi_change = chain.call_oi_change;
+        out.put_oi_change = chain.put_oi_change;
+        out.pcr_oi = chain.call_oi > 0 ? static_cast<double>(chain.put_oi) / chain.call_oi : 0.0;
+        out.pcr_volume = chain.call_volume > 0 ? static_cast<double>(chain.put_volume) / chain.call_volume : 0.0;
+        out.max_pain = chain.max_pain_row >= 0 ? chain.rows[chain.max_pain_row].strike : 0.0;
+        out.atm_strike = chain.atm_row >= 0 ? chain.rows[chain.atm_row].strike : 0.0;
+        out.atm_straddle = chain.atm_straddle / 100.0;
+        return out;
+    }
+
+    // Copies the whole chain, strikes ascending, into out
+    void snapshot(size_t chain_index, std::vector<ChainRow>& out) const {
+        const Chain& chain = *chains_[chain_index];
+        out.resize(chain.rows.size());
+        std::lock_guard<std::mutex> lock(chain.mutex);
+        std::memcpy(out.data(), chain.rows.data(), chain.rows.size() * sizeof(ChainRow));
+    }
+
+private:
+    // chain >= 0: an option in rows[slot / 2], CE if slot is even. chain < 0
+    // and slot > 0: an index, whose chains are chains_of_index_[slot - 1].
+    struct SlotRef {
+        int32_t chain;
+        int32_t slot;
+    };
+
+    struct Chain {
+        std::string name;
+        int32_t expiry = 0;
+        std::vector<ChainRow> rows;
+        std::vector<int64_t> oi_tree;  // Fenwick tree of call + put OI by row, 1-based
+        size_t tree_top = 0;           // Highest power of two <= rows
+
+        int64_t index_ltp = 0;
+        int64_t call_oi = 0;
+        int64_t put_oi = 0;
+        int64_t call_volume = 0;
+        int64_t put_volume = 0;
+        int64_t call_oi_change = 0;
+        int64_t put_oi_change = 0;
+        int max_pain_row = -1;
+        int atm_row = -1;
+        int64_t atm_straddle = 0;
+        mutable std::mutex mutex;
+    };
+
+    std::vector<std::unique_ptr<Chain>> chains_;
+    std::vector<SlotRef> slot_of_;                  // By instrument index
+    std::vector<std::vector<int>> chains_of_index_;
+
+    void build(const InstrumentTable& instruments) {
+        const auto& all = instruments.instruments();
+        std::map<std::pair<std::string, int32_t>, std::vector<size_t>> options;
+        for (size_t i = 0; i < all.size(); ++i) {
+            const Instrument& option = all[i];
+            if (option.option_type != OPTION_NONE && option.expiry != 0 && option.strike > 0) {
+                options[{std::string(option.name, strnlen(option.name, sizeof(option.name))), option.expiry}].push_back(i);
+            }
+        }
+
+        std::map<std::string, int> index_slot;
+        for (size_t i = 0; i < all.size(); ++i) {
+            if (all[i].exchange_type == BSE_CM && all[i].option_type == OPTION_NONE) {
+                std::string name(all[i].name, strnlen(all[i].name, sizeof(all[i].name)));
+                if (index_slot.emplace(name, static_cast<int>(chains_of_index_.size()) + 1).second) {
+                    chains_of_index_.emplace_back();
+                    slot_of_[i] = SlotRef{-1, static_cast<int32_t>(chains_of_index_.size())};
+                }
+            }
+        }
+
+        for (auto& [key, members] : options) {
+            std::unique_ptr<Chain> chain(new Chain());
+            chain->name = key.first;
+            chain->expiry = key.second;
+
+            std::vector<double> strikes;
+            for (size_t i : members) {
+                strikes.push_back(all[i].strike);
+            }
+            std::sort(strikes.begin(), strikes.end());
+            strikes.erase(std::unique(strikes.begin(), strikes.end()), strikes.end());
+            chain->rows.resize(strikes.size());
+            for (size_t row = 0; row < strikes.size(); ++row) {
+                chain->rows[row] = ChainRow{};
+                chain->rows[row].strike = strikes[row];
+            }
+            chain->oi_tree.assign(strikes.size() + 1, 0);
+            chain->tree_top = 1;
+            while (chain->tree_top * 2 <= strikes.size()) {
+                chain->tree_top *= 2;
+            }
+
+            int chain_index = static_cast<int>(chains_.size());
+            for (size_t i : members) {
+                size_t row = std::lower_bound(strikes.begin(), strikes.end(), all[i].strike) - strikes.begin();
+                bool put = all[i].option_type == OPTION_PUT;
+                (put ? chain->rows[row].put : chain->rows[row].call).token = all[i].token;
+                slot_of_[i] = SlotRef{chain_index, static_cast<int32_t>(row * 2 + put)};
+            }
+            auto index = index_slot.find(chain->name);
+            if (index != index_slot.end()) {
+                chains_of_index_[index->second - 1].push_back(chain_index);
+            }
+            chains_.push_back(std::move(chain));
+        }
+    }
+
+    static void tree_add(Chain& chain, size_t row, int64_t delta) {
+        for (size_t i = row + 1; i < chain.oi_tree.size(); i += i & (~i + 1)) {
+            chain.oi_tree[i] += delta;
+        }
+    }
+
+    // First row whose cumulative call + put OI reaches target
+    static int tree_lower_bound(const Chain& chain, int64_t target) {
+        size_t position = 0;
+        for (size_t step = chain.tree_top; step > 0; step >>= 1) {
+            if (position + step < chain.oi_tree.size() && chain.oi_tree[position + step] < target) {
+                position += step;
+                target -= chain.oi_tree[position];
+            }
+        }
+        return static_cast<int>(std::min(position, chain.rows.size() - 1));
+    }
+
+    void update_option(Chain& chain, int32_t slot, const Tick& tick) {
+        int row = slot / 2;
+        bool put = slot & 1;
+        std::lock_guard<std::mutex> lock(chain.mutex);
+        ChainQuote& quote = put ? chain.rows[row].put : chain.rows[row].call;
+        if (tick.ltp > 0) {
+            quote.ltp = tick.ltp;
+        }
+        quote.exchange_timestamp = tick.exchange_timestamp;
+
+        if (tick.mode != MODE_LTP && tick.volume >= quote.volume) {
+            (put ? chain.put_volume : chain.call_volume) += tick.volume - quote.volume;
+            quote.volume = tick.volume;
+        }
+
+        if (tick.mode == MODE_SNAP_QUOTE) {
+            quote.bid = tick.bids[0].price;
+            quote.ask = tick.asks[0].price;
+
+            int64_t open_interest = std::max<int64_t>(0, tick.open_interest);
+            double ratio = 1.0 + tick.open_interest_change_pct / 100.0;
+            int64_t oi_change = std::isfinite(ratio) && ratio > 0
+                ? open_interest - std::llround(open_interest / ratio)
+                : 0;
+            (put ? chain.put_oi_change : chain.call_oi_change) += oi_change - quote.oi_change;
+            quote.oi_change = oi_change;
+
+            int64_t delta = open_interest - quote.open_interest;
+            if (delta != 0) {
+                quote.open_interest = open_interest;
+                (put ? chain.put_oi : chain.call_oi) += delta;
+                tree_add(chain, row, delta);
+                chain.max_pain_row = chain.call_oi + chain.put_oi > 0 ? tree_lower_bound(chain, chain.put_oi) : -1;
+            }
+        }
+
+        if (row == chain.atm_row) {
+            chain.atm_straddle = chain.rows[row].call.ltp + chain.rows[row].put.ltp;
+        }
+    }
+
+    void update_index(Chain& chain, int64_t ltp) {
+        double price = ltp / 100.0;
+        std::lock_guard<std::mutex> lock(chain.mutex);
+        chain.index_ltp = ltp;
+        const auto& rows = chain.rows;
+        auto it = std::lower_bound(rows.begin(), rows.end(), price,
+                                   [](const ChainRow& row, double value) { return row.strike < value; });
+        if (it == rows.end() || (it != rows.begin() && price - (it - 1)->strike < it->strike - price)) {
+            --it;
+        }
+        chain.atm_row = static_cast<int>(it - rows.begin());
+        chain.atm_straddle = it->call.ltp + it->put.ltp;
+    }
+};
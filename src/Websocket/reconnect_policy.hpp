@@ -0,0 +1,75 @@
+#pragma once
+
+// Connection states and reconnect timing for WebSocketClient.
+//
+// Every transition happens on the client's network thread, driven by
+// websocketpp callbacks and two asio steady timers (reconnect and
+// heartbeat), so a client owns exactly one thread however often it drops.
+//
+//   CONNECTING --open--> OPEN --close/fail/pong timeout--> BACKOFF
+//        ^                                                    |
+//        +-----------------------timer------------------------+
+//
+// Backoff doubles from reconnect_initial_ms up to reconnect_max_ms and is
+// "equal jitter": half the step is fixed and half random, so shards that
+// lose their sockets together do not reconnect in lock step. The first retry
+// after a transient drop therefore waits reconnect_initial_ms / 2 to
+// reconnect_initial_ms.
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+
+enum class ConnectionState : int {
+    DISCONNECTED = 0,  // Not started yet
+    CONNECTING = 1,    // Handshake in flight
+    OPEN = 2,
+    BACKOFF = 3        // Waiting for the reconnect timer
+};
+
+inline const char* connection_state_name(ConnectionState state) {
+    switch (state) {
+        case ConnectionState::CONNECTING: return "connecting";
+        case ConnectionState::OPEN: return "open";
+        case ConnectionState::BACKOFF: return "backoff";
+        default: return "disconnected";
+    }
+}
+
+struct ConnectionSettings {
+    int reconnect_initial_ms = 100;
+    int reconnect_max_ms = 30000;
+    int heartbeat_interval_ms = 10000;  // Ping period while open
+    int pong_timeout_ms = 5000;         // Drop the connection if a ping goes unanswered this long
+};
+
+class ReconnectBackoff {
+public:
+    explicit ReconnectBackoff(const ConnectionSettings& settings)
+        : initial_ms_(std::max(1, settings.reconnect_initial_ms)),
+          max_ms_(std::max(initial_ms_, settings.reconnect_max_ms)),
+          random_(std::random_device{}()) {}
+
+    // Delay before the next attempt; counts the attempt
+    int next_delay_ms() {
+        int64_t step = initial_ms_;
+        for (int i = 0; i < attempt_ && step < max_ms_; ++i) {
+            step *= 2;
+        }
+        step = std::min<int64_t>(step, max_ms_);
+        ++attempt_;
+        std::uniform_int_distribution<int64_t> jitter(0, step / 2);
+        return static_cast<int>(step - step / 2 + jitter(random_));
+    }
+
+    // Attempts since the last successful open
+    int attempt() const { return attempt_; }
+
+    void reset() { attempt_ = 0; }
+
+private:
+    const int initial_ms_;
+    const int max_ms_;
+    int attempt_ = 0;
+    std::mt19937 random_;
+};
@@ -0,0 +1,334 @@
+#pragma once
+
+// Shared-memory market data bus.
+//
+// bin/ws (the publisher) maps /dev/shm/<name> and writes every decoded tick
+// twice: into a ring that readers can follow in order, and into a per-token
+// "latest quote" slot. Both are guarded by seqlocks, so readers in other
+// processes never block the publisher and never make a syscall after
+// ShmBusReader::open().
+//
+// Layout (all offsets from the start of the mapping):
+//
+//   ShmBusHeader                      layout, ring head
+//   uint32_t tokens[slot_count]       slot i belongs to tokens[i]
+//   ShmBusEntry slots[slot_count]     latest tick per token
+//   ShmBusEntry ring[ring_capacity]   every tick, overwritten oldest first
+//
+// Include this header on its own to build a reader; it only depends on
+// smartstream.hpp for the Tick record.
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "smartstream.hpp"
+
+constexpr uint64_t SHM_BUS_MAGIC = 0x5355424B4349544Bull;  // "KTICKBUS"
+constexpr uint32_t SHM_BUS_VERSION = 1;
+
+struct alignas(64) ShmBusHeader {
+    std::atomic<uint64_t> magic;       // Written last, once the layout is valid
+    uint32_t version;
+    uint32_t tick_size;
+    uint32_t slot_count;
+    uint32_t ring_capacity;            // Power of two
+    uint64_t tokens_offset;
+    uint64_t slots_offset;
+    uint64_t ring_offset;
+    uint64_t total_size;
+    int64_t created_epoch_ms;
+    int32_t publisher_pid;
+    alignas(64) std::atomic<uint64_t> ring_head;  // Ticks ever claimed in the ring
+};
+
+// Seqlock-protected tick: `version` is odd while the writer is mid-copy.
+// For ring entries the version also encodes the ring position, so a reader
+// can tell a lapped entry from the one it expected.
+struct alignas(64) ShmBusEntry {
+    std::atomic<uint64_t> version;
+    Tick tick;
+};
+
+inline uint64_t shm_bus_ring_version(uint64_t position) {
+    return (position + 1) * 2;
+}
+
+inline size_t shm_bus_align(size_t value) {
+    return (value + 63) & ~static_cast<size_t>(63);
+}
+
+class ShmBusPublisher {
+public:
+    ShmBusPublisher() = default;
+    ShmBusPublisher(const ShmBusPublisher&) = delete;
+    ShmBusPublisher& operator=(const ShmBusPublisher&) = delete;
+
+    ~ShmBusPublisher() {
+        close();
+    }
+
+    // Creates (or recreates) the segment with one slot per token, in the
+    // order given, so slot i is instrument index i.
+    bool create(const std::string& name, const std::vector<uint32_t>& tokens, size_t ring_capacity, std::string& error) {
+        size_t capacity = 2;
+        while (capacity < ring_capacity) {
+            capacity <<= 1;
+        }
+
+        size_t tokens_offset = shm_bus_align(sizeof(ShmBusHeader));
+        size_t slots_offset = shm_bus_align(tokens_offset + tokens.size() * sizeof(uint32_t));
+        size_t ring_offset = slots_offset + tokens.size() * sizeof(ShmBusEntry);
+        size_t total_size = ring_offset + capacity * sizeof(ShmBusEntry);
+
+        // Unlink first so readers still attached to a previous run keep their
+        // old mapping instead of seeing this one half-initialised.
+        shm_unlink(name.c_str());
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+        if (fd < 0) {
+            error = "shm_open failed: " + std::string(std::strerror(errno));
+            return false;
+        }
+        if (ftruncate(fd, static_cast<off_t>(total_size)) != 0) {
+            error = "ftruncate failed: " + std::string(std::strerror(errno));
+            ::close(fd);
+            return false;
+        }
+        void* base = mmap(nullptr, total_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (base == MAP_FAILED) {
+            error = "mmap failed: " + std::string(std::strerror(errno));
+            return false;
+        }
+
+        base_ = static_cast<char*>(base);
+        size_ = total_size;
+        name_ = name;
+        header_ = reinterpret_cast<ShmBusHeader*>(base_);
+        slots_ = reinterpret_cast<ShmBusEntry*>(base_ + slots_offset);
+        ring_ = reinterpret_cast<ShmBusEntry*>(base_ + ring_offset);
+        slot_count_ = tokens.size();
+        ring_mask_ = capacity - 1;
+
+        // ftruncate zero-filled the mapping, so only non-zero fields are set.
+        std::memcpy(base_ + tokens_offset, tokens.data(), tokens.size() * sizeof(uint32_t));
+        for (size_t i = 0; i < tokens.size(); ++i) {
+            slots_[i].tick.token = tokens[i];
+        }
+        header_->version = SHM_BUS_VERSION;
+        header_->tick_size = sizeof(Tick);
+        header_->slot_count = static_cast<uint32_t>(tokens.size());
+        header_->ring_capacity = static_cast<uint32_t>(capacity);
+        header_->tokens_offset = tokens_offset;
+        header_->slots_offset = slots_offset;
+        header_->ring_offset = ring_offset;
+        header_->total_size = total_size;
+        header_->created_epoch_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        header_->publisher_pid = static_cast<int32_t>(getpid());
+        header_->magic.store(SHM_BUS_MAGIC, std::memory_order_release);
+        return true;
+    }
+
+    void close() {
+        if (base_ != nullptr) {
+            munmap(base_, size_);
+            base_ = nullptr;
+        }
+    }
+
+    // Safe to call from several consumer threads as long as each instrument
+    // index is only ever written by one of them (TickDispatcher guarantees it).
+    void publish(const Tick& tick, int32_t instrument_index) {
+        if (base_ == nullptr) {
+            return;
+        }
+        if (instrument_index >= 0 && static_cast<size_t>(instrument_index) < slot_count_) {
+            ShmBusEntry& slot = slots_[instrument_index];
+            uint64_t version = slot.version.load(std::memory_order_relaxed);
+            slot.version.store(version + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            std::memcpy(&slot.tick, &tick, sizeof(Tick));
+            slot.version.store(version + 2, std::memory_order_release);
+        }
+
+        uint64_t position = header_->ring_head.fetch_add(1, std::memory_order_relaxed);
+        ShmBusEntry& entry = ring_[position & ring_mask_];
+        entry.version.store(shm_bus_ring_version(position) - 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(&entry.tick, &tick, sizeof(Tick));
+        entry.version.store(shm_bus_ring_version(position), std::memory_order_release);
+    }
+
+    const std::string& name() const { return name_; }
+    size_t size_bytes() const { return size_; }
+
+private:
+    char* base_ = nullptr;
+    size_t size_ = 0;
+    std::string name_;
+    ShmBusHeader* header_ = nullptr;
+    ShmBusEntry* slots_ = nullptr;
+    ShmBusEntry* ring_ = nullptr;
+    size_t slot_count_ = 0;
+    uint64_t ring_mask_ = 0;
+};
+
+class ShmBusReader {
+public:
+    ShmBusReader() = default;
+    ShmBusReader(const ShmBusReader&) = delete;
+    ShmBusReader& operator=(const ShmBusReader&) = delete;
+
+    ~ShmBusReader() {
+        close();
+    }
+
+    // Maps the segment read-only. By default the ring cursor starts at the
+    // newest tick; pass from_oldest to replay whatever is still in the ring.
+    bool open(const std::string& name, std::string& error, bool from_oldest = false) {
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) {
+            error = "shm_open failed: " + std::string(std::strerror(errno));
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(ShmBusHeader)) {
+            error = "segment is not initialised";
+            ::close(fd);
+            return false;
+        }
+        void* base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (base == MAP_FAILED) {
+            error = "mmap failed: " + std::string(std::strerror(errno));
+            return false;
+        }
+        base_ = static_cast<const char*>(base);
+        size_ = st.st_size;
+        header_ = reinterpret_cast<const ShmBusHeader*>(base_);
+
+        if (header_->magic.load(std::memory_order_acquire) != SHM_BUS_MAGIC ||
+            header_->version != SHM_BUS_VERSION || header_->tick_size != sizeof(Tick) ||
+            header_->total_size > size_) {
+            error = "segment layout does not match this reader";
+            close();
+            return false;
+        }
+
+        slots_ = reinterpret_cast<const ShmBusEntry*>(base_ + header_->slots_offset);
+        ring_ = reinterpret_cast<const ShmBusEntry*>(base_ + header_->ring_offset);
+        ring_mask_ = header_->ring_capacity - 1;
+
+        const uint32_t* tokens = reinterpret_cast<const uint32_t*>(base_ + header_->tokens_offset);
+        index_.clear();
+        for (uint32_t i = 0; i < header_->slot_count; ++i) {
+            index_.emplace_back(tokens[i], i);
+        }
+        std::sort(index_.begin(), index_.end());
+
+        uint64_t head = header_->ring_head.load(std::memory_order_acquire);
+        cursor_ = from_oldest && head > header_->ring_capacity ? head - header_->ring_capacity : (from_oldest ? 0 : head);
+        return true;
+    }
+
+    void close() {
+        if (base_ != nullptr) {
+            munmap(const_cast<char*>(base_), size_);
+            base_ = nullptr;
+        }
+    }
+
+    // Copies the most recent tick for `token`. Returns false for unknown
+    // tokens and for tokens that have not ticked yet.
+    bool latest(uint32_t token, Tick& out) const {
+        int32_t slot = slot_of(token);
+        if (slot < 0) {
+            return false;
+        }
+        const ShmBusEntry& entry = slots_[slot];
+        while (true) {
+            uint64_t before = entry.version.load(std::memory_order_acquire);
+            if (before == 0) {
+                return false;
+            }
+            if (before & 1) {
+                continue;
+            }
+            std::memcpy(&out, &entry.tick, sizeof(Tick));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (entry.version.load(std::memory_order_relaxed) == before) {
+                return true;
+            }
+        }
+    }
+
+    // Last traded price in paise, or -1 if the token has not ticked.
+    int64_t last_price(uint32_t token) const {
+        Tick tick;
+        return latest(token, tick) ? tick.ltp : -1;
+    }
+
+    // Copies up to `max_count` ring ticks the reader has not seen yet. If the
+    // publisher lapped the reader, the cursor jumps to the oldest surviving
+    // tick and the gap is added to lost().
+    size_t poll(Tick* out, size_t max_count) {
+        size_t count = 0;
+        uint64_t head = header_->ring_head.load(std::memory_order_acquire);
+        if (head - cursor_ > header_->ring_capacity) {
+            lost_ += head - header_->ring_capacity - cursor_;
+            cursor_ = head - header_->ring_capacity;
+        }
+        while (count < max_count && cursor_ < head) {
+            const ShmBusEntry& entry = ring_[cursor_ & ring_mask_];
+            uint64_t expected = shm_bus_ring_version(cursor_);
+            uint64_t before = entry.version.load(std::memory_order_acquire);
+            if (before < expected) {
+                break;  // Claimed but not written yet
+            }
+            if (before == expected) {
+                std::memcpy(&out[count], &entry.tick, sizeof(Tick));
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (entry.version.load(std::memory_order_relaxed) == expected) {
+                    ++count;
+                    ++cursor_;
+                    continue;
+                }
+            }
+            // Overwritten while we looked: we were lapped
+            ++lost_;
+            ++cursor_;
+        }
+        return count;
+    }
+
+    size_t slot_count() const { return index_.size(); }
+    uint64_t lost() const { return lost_; }
+    int32_t publisher_pid() const { return header_->publisher_pid; }
+
+private:
+    int32_t slot_of(uint32_t token) const {
+        auto it = std::lower_bound(index_.begin(), index_.end(), std::make_pair(token, 0u));
+        return it != index_.end() && it->first == token ? static_cast<int32_t>(it->second) : -1;
+    }
+
+    const char* base_ = nullptr;
+    size_t size_ = 0;
+    const ShmBusHeader* header_ = nullptr;
+    const ShmBusEntry* slots_ = nullptr;
+    const ShmBusEntry* ring_ = nullptr;
+    uint64_t ring_mask_ = 0;
+    std::vector<std::pair<uint32_t, uint32_t>> index_;
+    uint64_t cursor_ = 0;
+    uint64_t lost_ = 0;
+};
@@ -0,0 +1,340 @@
+#pragma once
+
+// SmartStream (AngelOne WebSocket 2.0) binary tick packets.
+//
+// Every binary frame is one little-endian packet whose layout depends on the
+// subscription mode in byte 0:
+//
+//   offset  size  field
+//   0       1     subscription mode (1 = LTP, 2 = Quote, 3 = SnapQuote)
+//   1       1     exchange type
+//   2       25    token (ASCII digits, NUL terminated)
+//   27      8     sequence number
+//   35      8     exchange timestamp (epoch ms)
+//   43      8     last traded price (paise)                 -- LTP ends at 51
+//   51      8     last traded quantity
+//   59      8     average traded price
+//   67      8     volume traded for the day
+//   75      8     total buy quantity (double)
+//   83      8     total sell quantity (double)
+//   91      8     open
+//   99      8     high
+//   107     8     low
+//   115     8     close                                     -- Quote ends at 123
+//   123     8     last traded timestamp
+//   131     8     open interest
+//   139     8     open interest change % (double)
+//   147     200   best five: 10 x {int16 flag, int64 qty, int64 price, int16 orders}
+//   347     8     upper circuit limit
+//   355     8     lower circuit limit
+//   363     8     52 week high
+//   371     8     52 week low                               -- SnapQuote ends at 379
+//
+// decode_tick() reads those fields at fixed offsets straight out of the frame
+// buffer; it never allocates and never builds intermediate strings.
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "SmartStream decoder assumes a little-endian host"
+#endif
+
+enum SubscriptionMode : uint8_t {
+    MODE_LTP = 1,
+    MODE_QUOTE = 2,
+    MODE_SNAP_QUOTE = 3
+};
+
+enum ExchangeType : uint8_t {
+    NSE_CM = 1,
+    NSE_FO = 2,
+    BSE_CM = 3,
+    BSE_FO = 4,
+    MCX_FO = 5,
+    NCX_FO = 7,
+    CDE_FO = 13
+};
+
+constexpr size_t LTP_PACKET_SIZE = 51;
+constexpr size_t QUOTE_PACKET_SIZE = 123;
+constexpr size_t SNAP_QUOTE_PACKET_SIZE = 379;
+constexpr size_t MAX_PACKET_SIZE = SNAP_QUOTE_PACKET_SIZE;
+
+constexpr size_t TOKEN_FIELD_SIZE = 25;
+constexpr size_t DEPTH_ENTRY_SIZE = 20;
+constexpr int DEPTH_LEVELS = 5;
+
+struct DepthLevel {
+    int64_t price;
+    int64_t quantity;
+    int32_t orders;
+    int32_t reserved;
+};
+
+// Tick::flags; decode_tick() leaves them clear
+enum TickFlags : uint16_t {
+    TICK_FLAG_SNAPSHOT = 1 << 0  // Rebuilt from a REST quote after a gap, not a stream packet
+};
+
+// Fixed-size, trivially copyable tick record. Prices are in paise, exactly as
+// they arrive on the wire; fields beyond the packet's mode are left zeroed.
+struct Tick {
+    uint32_t token;
+    uint8_t mode;
+    uint8_t exchange_type;
+    uint16_t flags;
+    int64_t sequence;
+    int64_t exchange_timestamp;
+    int64_t ltp;
+
+    int64_t last_traded_qty;
+    int64_t avg_traded_price;
+    int64_t volume;
+    double total_buy_qty;
+    double total_sell_qty;
+    int64_t open;
+    int64_t high;
+    int64_t low;
+    int64_t close;
+
+    int64_t last_traded_timestamp;
+    int64_t open_interest;
+    double open_interest_change_pct;
+    DepthLevel bids[DEPTH_LEVELS];
+    DepthLevel asks[DEPTH_LEVELS];
+    int64_t upper_circuit;
+    int64_t lower_circuit;
+    int64_t high_52_week;
+    int64_t low_52_week;
+
+    int64_t receive_ns;  // Local steady-clock time the frame was handed to us
+    int64_t decoded_ns;  // Local steady-clock time decoding finished
+};
+
+static_assert(std::is_trivially_copyable<Tick>::value, "Tick must stay memcpy-able");
+
+inline int64_t steady_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Wall-clock nanoseconds; only comparable between processes on the same host.
+inline int64_t wall_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Unaligned little-endian loads; compile down to single mov instructions.
+template <typename T>
+inline T load_le(const char* p) {
+    T value;
+    std::memcpy(&value, p, sizeof(T));
+    return value;
+}
+
+template <typename T>
+inline void store_le(char* p, T value) {
+    std::memcpy(p, &value, sizeof(T));
+}
+
+// Parses the NUL-terminated ASCII token into an integer. Returns 0 for an empty
+// or non-numeric token, which is never a valid instrument.
+inline uint32_t parse_token_field(const char* p) {
+    uint32_t value = 0;
+    for (size_t i = 0; i < TOKEN_FIELD_SIZE; ++i) {
+        unsigned digit = static_cast<unsigned char>(p[i]) - '0';
+        if (digit > 9) {
+            return p[i] == '\0' && i > 0 ? value : 0;
+        }
+        value = value * 10 + digit;
+    }
+    return value;
+}
+
+inline size_t packet_size_for_mode(uint8_t mode) {
+    switch (mode) {
+        case MODE_LTP: return LTP_PACKET_SIZE;
+        case MODE_QUOTE: return QUOTE_PACKET_SIZE;
+        case MODE_SNAP_QUOTE: return SNAP_QUOTE_PACKET_SIZE;
+        default: return 0;
+    }
+}
+
+// Decodes one binary frame into `tick`. Returns false for unknown modes,
+// truncated frames and unparsable tokens; `tick` is unspecified in that case.
+inline bool decode_tick(const char* data, size_t len, Tick& tick) {
+    if (len < LTP_PACKET_SIZE) {
+        return false;
+    }
+
+    uint8_t mode = static_cast<uint8_t>(data[0]);
+    size_t expected = packet_size_for_mode(mode);
+    if (expected == 0 || len < expected) {
+        return false;
+    }
+
+    tick.token = parse_token_field(data + 2);
+    if (tick.token == 0) {
+        return false;
+    }
+    tick.mode = mode;
+    tick.exchange_type = static_cast<uint8_t>(data[1]);
+    tick.flags = 0;
+    tick.sequence = load_le<int64_t>(data + 27);
+    tick.exchange_timestamp = load_le<int64_t>(data + 35);
+    tick.ltp = load_le<int64_t>(data + 43);
+
+    if (mode == MODE_LTP) {
+        // Zero everything past the LTP block so stale data never leaks through.
+        std::memset(&tick.last_traded_qty, 0, offsetof(Tick, receive_ns) - offsetof(Tick, last_traded_qty));
+        return true;
+    }
+
+    tick.last_traded_qty = load_le<int64_t>(data + 51);
+    tick.avg_traded_price = load_le<int64_t>(data + 59);
+    tick.volume = load_le<int64_t>(data + 67);
+    tick.total_buy_qty = load_le<double>(data + 75);
+    tick.total_sell_qty = load_le<double>(data + 83);
+    tick.open = load_le<int64_t>(data + 91);
+    tick.high = load_le<int64_t>(data + 99);
+    tick.low = load_le<int64_t>(data + 107);
+    tick.close = load_le<int64_t>(data + 115);
+
+    if (mode == MODE_QUOTE) {
+        std::memset(&tick.last_traded_timestamp, 0, offsetof(Tick, receive_ns) - offsetof(Tick, last_traded_timestamp));
+        return true;
+    }
+
+    tick.last_traded_timestamp = load_le<int64_t>(data + 123);
+    tick.open_interest = load_le<int64_t>(data + 131);
+    tick.open_interest_change_pct = load_le<double>(data + 139);
+
+    // Depth entries are tagged rather than ordered: flag 0 is a buy level,
+    // anything else a sell level.
+    int bid_count = 0;
+    int ask_count = 0;
+    const char* entry = data + 147;
+    for (int i = 0; i < 2 * DEPTH_LEVELS; ++i, entry += DEPTH_ENTRY_SIZE) {
+        bool is_buy = load_le<int16_t>(entry) == 0;
+        DepthLevel& level = is_buy ? tick.bids[bid_count < DEPTH_LEVELS ? bid_count : DEPTH_LEVELS - 1]
+                                   : tick.asks[ask_count < DEPTH_LEVELS ? ask_count : DEPTH_LEVELS - 1];
+        level.quantity = load_le<int64_t>(entry + 2);
+        level.price = load_le<int64_t>(entry + 10);
+        level.orders = load_le<int16_t>(entry + 18);
+        level.reserved = 0;
+        bid_count += is_buy;
+        ask_count += !is_buy;
+    }
+    for (; bid_count < DEPTH_LEVELS; ++bid_count) {
+        tick.bids[bid_count] = DepthLevel{};
+    }
+    for (; ask_count < DEPTH_LEVELS; ++ask_count) {
+        tick.asks[ask_count] = DepthLevel{};
+    }
+
+    tick.upper_circuit = load_le<int64_t>(data + 347);
+    tick.lower_circuit = load_le<int64_t>(data + 355);
+    tick.high_52_week = load_le<int64_t>(data + 363);
+    tick.low_52_week = load_le<int64_t>(data + 371);
+    return true;
+}
+
+// Inverse of decode_tick(): writes the wire packet for `tick` into `out`, which
+// must hold MAX_PACKET_SIZE bytes. Returns the packet length, or 0 for an
+// unknown mode. Used to synthesise frames for benchmarks and test servers.
+inline size_t encode_tick(const Tick& tick, char* out) {
+    size_t size = packet_size_for_mode(tick.mode);
+    if (size == 0) {
+        return 0;
+    }
+    std::memset(out, 0, size);
+
+    out[0] = static_cast<char>(tick.mode);
+    out[1] = static_cast<char>(tick.exchange_type);
+    char digits[16];
+    int n = 0;
+    uint32_t token = tick.token;
+    do {
+        digits[n++] = static_cast<char>('0' + token % 10);
+        token /= 10;
+    } while (token != 0);
+    for (int i = 0; i < n; ++i) {
+        out[2 + i] = digits[n - 1 - i];
+    }
+    store_le<int64_t>(out + 27, tick.sequence);
+    store_le<int64_t>(out + 35, tick.exchange_timestamp);
+    store_le<int64_t>(out + 43, tick.ltp);
+    if (tick.mode == MODE_LTP) {
+        return size;
+    }
+
+    store_le<int64_t>(out + 51, tick.last_traded_qty);
+    store_le<int64_t>(out + 59, tick.avg_traded_price);
+    store_le<int64_t>(out + 67, tick.volume);
+    store_le<double>(out + 75, tick.total_buy_qty);
+    store_le<double>(out + 83, tick.total_sell_qty);
+    store_le<int64_t>(out + 91, tick.open);
+    store_le<int64_t>(out + 99, tick.high);
+    store_le<int64_t>(out + 107, tick.low);
+    store_le<int64_t>(out + 115, tick.close);
+    if (tick.mode == MODE_QUOTE) {
+        return size;
+    }
+
+    store_le<int64_t>(out + 123, tick.last_traded_timestamp);
+    store_le<int64_t>(out + 131, tick.open_interest);
+    store_le<double>(out + 139, tick.open_interest_change_pct);
+    char* entry = out + 147;
+    for (int side = 0; side < 2; ++side) {
+        const DepthLevel* levels = side == 0 ? tick.bids : tick.asks;
+        for (int i = 0; i < DEPTH_LEVELS; ++i, entry += DEPTH_ENTRY_SIZE) {
+            store_le<int16_t>(entry, static_cast<int16_t>(side));
+            store_le<int64_t>(entry + 2, levels[i].quantity);
+            store_le<int64_t>(entry + 10, levels[i].price);
+            store_le<int16_t>(entry + 18, static_cast<int16_t>(levels[i].orders));
+        }
+    }
+    store_le<int64_t>(out + 347, tick.upper_circuit);
+    store_le<int64_t>(out + 355, tick.lower_circuit);
+    store_le<int64_t>(out + 363, tick.high_52_week);
+    store_le<int64_t>(out + 371, tick.low_52_week);
+    return size;
+}
+
+// Capture files are a plain sequence of [uint32 length][frame bytes] records,
+// one per binary websocket frame, in arrival order.
+inline bool read_capture_file(const std::string& filename, std::vector<std::string>& frames) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    uint32_t length = 0;
+    while (file.read(reinterpret_cast<char*>(&length), sizeof(length))) {
+        std::string frame(length, '\0');
+        if (!file.read(&frame[0], length)) {
+            break;
+        }
+        frames.push_back(std::move(frame));
+    }
+    return true;
+}
+
+inline bool write_capture_file(const std::string& filename, const std::vector<std::string>& frames) {
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+    for (const auto& frame : frames) {
+        uint32_t length = static_cast<uint32_t>(frame.size());
+        file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        file.write(frame.data(), length);
+    }
+    return true;
+}
@@ -0,0 +1,436 @@
+#pragma once
+
+// REST snapshot recovery for ticks lost to a gap in the stream.
+//
+// The network threads call request() for tokens whose stream is known to
+// have gaps: every subscribed token of a shard after it reconnects, or one
+// token whose sequence number went backwards. A worker thread batches the
+// pending tokens into market quote requests (FULL mode, at most batch_size
+// tokens each), spaced to stay under the API's request rate, and publishes
+// each answer into the tick dispatcher as a SnapQuote tick flagged
+// TICK_FLAG_SNAPSHOT so consumers can tell rebuilt state from stream data.
+//
+// Recovery is bounded: a token still unanswered timeout_ms after it was
+// requested is given up and counted as failed. A snapshot older than a
+// stream tick that arrived meanwhile is not published (counted as
+// superseded), and neither is one without a readable exchFeedTime (counted
+// as undated), since every consumer orders by exchange time. Response bodies
+// are checked field by field: a non-JSON error page or a null field fails
+// the request or leaves the field at 0, never the worker. Nothing here runs on a network thread except request(), which
+// only takes a short lock, so live ticks for unaffected tokens never wait.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <strings.h>
+#include <curl/curl.h>
+#include <nlohmann/json.hpp>
+
+#include "event_log.hpp"
+#include "instrument_table.hpp"
+#include "latency_histogram.hpp"
+#include "smartstream.hpp"
+#include "tick_dispatcher.hpp"
+
+struct SnapshotRecoverySettings {
+    std::string quote_url = "https://apiconnect.angelone.in/rest/secure/angelbroking/market/v1/quote/";
+    size_t batch_size = 50;            // Tokens per quote request; the API accepts 50
+    double requests_per_second = 10;
+    int timeout_ms = 10000;            // Longest a token may wait for its snapshot
+};
+
+// "21-Jun-2023 10:46:10" in IST to epoch milliseconds; 0 if unparseable
+inline int64_t parse_quote_time_ms(const std::string& text) {
+    static const char* months[] = {
+        "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+        "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+    };
+    int day = 0, year = 0, hour = 0, minute = 0, second = 0;
+    char month_text[4] = {0};
+    if (std::sscanf(text.c_str(), "%d-%3s-%d %d:%d:%d", &day, month_text, &year, &hour, &minute, &second) != 6) {
+        return 0;
+    }
+    int month = -1;
+    for (int i = 0; i < 12; ++i) {
+        if (strcasecmp(month_text, months[i]) == 0) {
+            month = i;
+            break;
+        }
+    }
+    if (month < 0) {
+        return 0;
+    }
+    std::tm utc{};
+    utc.tm_year = year - 1900;
+    utc.tm_mon = month;
+    utc.tm_mday = day;
+    utc.tm_hour = hour;
+    utc.tm_min = minute;
+    utc.tm_sec = second;
+    constexpr int64_t IST_OFFSET_S = 5 * 3600 + 30 * 60;
+    return (static_cast<int64_t>(timegm(&utc)) - IST_OFFSET_S) * 1000;
+}
+
+inline const char* quote_exchange_name(uint8_t exchange_type) {
+    switch (exchange_type) {
+        case NSE_CM: return "NSE";
+        case NSE_FO: return "NFO";
+        case BSE_CM: return "BSE";
+        case BSE_FO: return "BFO";
+        case MCX_FO: return "MCX";
+        case NCX_FO: return "NCDEX";
+        case CDE_FO: return "CDS";
+        default: return "";
+    }
+}
+
+class SnapshotRecovery {
+public:
+    SnapshotRecovery(const InstrumentTable& instruments, TickDispatcher& dispatcher, EventLog& event_log)
+        : instruments_(instruments), dispatcher_(dispatcher), event_log_(event_log) {}
+
+    ~SnapshotRecovery() {
+        stop();
+    }
+
+    // headers: full "Name: value" lines, including Authorization
+    bool start(const SnapshotRecoverySettings& settings, const std::vector<std::string>& headers, std::string& error) {
+        settings_ = settings;
+        settings_.batch_size = std::max<size_t>(1, settings_.batch_size);
+        curl_ = curl_easy_init();
+        if (curl_ == nullptr) {
+            error = "curl_easy_init failed";
+            return false;
+        }
+        header_lines_ = headers;
+        build_headers();
+        running_ = true;
+        thread_ = std::thread(&SnapshotRecovery::run, this);
+        return true;
+    }
+
+    void stop() {
+        if (!running_.exchange(false)) {
+            return;
+        }
+        wake_.notify_one();
+        thread_.join();
+        curl_slist_free_all(headers_);
+        curl_easy_cleanup(curl_);
+        headers_ = nullptr;
+        curl_ = nullptr;
+    }
+
+    // Queues tokens for a snapshot; a token already pending keeps its
+    // original deadline. Safe from any thread.
+    void request(const std::vector<std::pair<uint8_t, uint32_t>>& tokens, const char* reason) {
+        if (!running_.load(std::memory_order_relaxed) || tokens.empty()) {
+            return;
+        }
+        int64_t deadline_ns = steady_now_ns() + static_cast<int64_t>(settings_.timeout_ms) * 1000000;
+        size_t added = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (const auto& [exchange_type, token] : tokens) {
+                if (pending_.emplace(token, Pending{exchange_type, deadline_ns, steady_now_ns()}).second) {
+                    ++added;
+                }
+            }
+        }
+        requested_.fetch_add(added, std::memory_order_relaxed);
+        if (added > 0) {
+            // Single-token gaps are only counted; they can come in bursts
+            if (tokens.size() > 1) {
+                event_log_.write("Snapshot recovery of {} tokens requested: {}", added, reason);
+            }
+            wake_.notify_one();
+        }
+    }
+
+    void request(uint8_t exchange_type, uint32_t token, const char* reason) {
+        request(std::vector<std::pair<uint8_t, uint32_t>>{{exchange_type, token}}, reason);
+    }
+
+    // Replaces the Authorization header line from the next request on, after
+    // the session token is renewed. Safe from any thread.
+    void set_authorization(const std::string& header) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_authorization_ = header;
+    }
+
+    size_t pending() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return pending_.size();
+    }
+
+    uint64_t requested() const { return requested_.load(std::memory_order_relaxed); }
+    uint64_t recovered() const { return recovered_.load(std::memory_order_relaxed); }
+    uint64_t superseded() const { return superseded_.load(std::memory_order_relaxed); }
+    uint64_t undated() const { return undated_.load(std::memory_order_relaxed); }
+    uint64_t failed() const { return failed_.load(std::memory_order_relaxed); }
+    uint64_t http_requests() const { return http_requests_.load(std::memory_order_relaxed); }
+    LatencyHistogram::Snapshot recovery_time() const { return recovery_time_.snapshot(); }
+
+private:
+    struct Pending {
+        uint8_t exchange_type;
+        int64_t deadline_ns;
+        int64_t requested_ns;
+    };
+
+    const InstrumentTable& instruments_;
+    TickDispatcher& dispatcher_;
+    EventLog& event_log_;
+    SnapshotRecoverySettings settings_;
+    CURL* curl_ = nullptr;
+    curl_slist* headers_ = nullptr;
+    std::vector<std::string> header_lines_;
+    std::string pending_authorization_;  // Guarded by mutex_
+
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::map<uint32_t, Pending> pending_;
+
+    std::atomic<uint64_t> requested_{0};
+    std::atomic<uint64_t> recovered_{0};
+    std::atomic<uint64_t> superseded_{0};
+    std::atomic<uint64_t> undated_{0};
+    std::atomic<uint64_t> failed_{0};
+    std::atomic<uint64_t> http_requests_{0};
+    LatencyHistogram recovery_time_;  // Request to snapshot published
+
+    void run() {
+        auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(1.0 / std::max(0.1, settings_.requests_per_second)));
+        auto next_request = std::chrono::steady_clock::now();
+
+        while (running_.load()) {
+            std::vector<std::pair<uint32_t, Pending>> batch;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait_for(lock, std::chrono::milliseconds(100), [this]() { return !pending_.empty() || !running_.load(); });
+                expire_locked();
+                if (pending_.empty()) {
+                    continue;
+                }
+            }
+
+            // Spacing requests rather than bursting keeps under the rate limit
+            std::this_thread::sleep_until(next_request);
+            next_request = std::chrono::steady_clock::now() + interval;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                expire_locked();
+                for (auto it = pending_.begin(); it != pending_.end() && batch.size() < settings_.batch_size;) {
+                    batch.emplace_back(it->first, it->second);
+                    it = pending_.erase(it);
+                }
+            }
+            if (!batch.empty()) {
+                fetch(batch);
+            }
+        }
+    }
+
+    void expire_locked() {
+        int64_t now_ns = steady_now_ns();
+        size_t expired = 0;
+        for (auto it = pending_.begin(); it != pending_.end();) {
+            if (it->second.deadline_ns <= now_ns) {
+                it = pending_.erase(it);
+                ++expired;
+            } else {
+                ++it;
+            }
+        }
+        if (expired > 0) {
+            failed_.fetch_add(expired, std::memory_order_relaxed);
+            event_log_.write("Snapshot recovery gave up on {} tokens after {} ms", expired, settings_.timeout_ms);
+        }
+    }
+
+    static size_t append_body(char* data, size_t size, size_t count, void* out) {
+        static_cast<std::string*>(out)->append(data, size * count);
+        return size * count;
+    }
+
+    void build_headers() {
+        curl_slist_free_all(headers_);
+        headers_ = nullptr;
+        for (const auto& header : header_lines_) {
+            headers_ = curl_slist_append(headers_, header.c_str());
+        }
+    }
+
+    void fetch(const std::vector<std::pair<uint32_t, Pending>>& batch) {
+        nlohmann::json body;
+        body["mode"] = "FULL";
+        for (const auto& [token, pending] : batch) {
+            body["exchangeTokens"][quote_exchange_name(pending.exchange_type)].push_back(std::to_string(token));
+        }
+        std::string request_body = body.dump();
+        std::string response_body;
+
+        // The request may not outlive the earliest deadline in the batch
+        int64_t earliest_deadline_ns = batch.front().second.deadline_ns;
+        for (const auto& entry : batch) {
+            earliest_deadline_ns = std::min(earliest_deadline_ns, entry.second.deadline_ns);
+        }
+        long timeout_ms = std::max<long>(100, static_cast<long>((earliest_deadline_ns - steady_now_ns()) / 1000000));
+
+        std::string authorization;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            authorization.swap(pending_authorization_);
+        }
+        if (!authorization.empty()) {
+            for (auto& line : header_lines_) {
+                if (line.compare(0, 14, "Authorization:") == 0) {
+                    line = authorization;
+                }
+            }
+            build_headers();
+        }
+
+        curl_easy_setopt(curl_, CURLOPT_URL, settings_.quote_url.c_str());
+        curl_easy_setopt(curl_, CURLOPT_HTTPHEADER, headers_);
+        curl_easy_setopt(curl_, CURLOPT_POSTFIELDS, request_body.c_str());
+        curl_easy_setopt(curl_, CURLOPT_POSTFIELDSIZE, static_cast<long>(request_body.size()));
+        curl_easy_setopt(curl_, CURLOPT_WRITEFUNCTION, &SnapshotRecovery::append_body);
+        curl_easy_setopt(curl_, CURLOPT_WRITEDATA, &response_body);
+        curl_easy_setopt(curl_, CURLOPT_TIMEOUT_MS, timeout_ms);
+        curl_easy_setopt(curl_, CURLOPT_NOSIGNAL, 1L);
+        CURLcode result = curl_easy_perform(curl_);
+        http_requests_.fetch_add(1, std::memory_order_relaxed);
+
+        long status = 0;
+        curl_easy_getinfo(curl_, CURLINFO_RESPONSE_CODE, &status);
+        // Not JSON (an HTML 502, a plain-text rate-limit page) parses as discarded
+        const nlohmann::json response = nlohmann::json::parse(response_body, nullptr, false);
+        std::map<uint32_t, const nlohmann::json*> fetched;
+        const nlohmann::json* data = response.is_object() && response.contains("data") ? &response["data"] : nullptr;
+        if (result == CURLE_OK && status == 200 && data != nullptr && data->is_object() && data->contains("fetched") &&
+            (*data)["fetched"].is_array()) {
+            for (const auto& quote : (*data)["fetched"]) {
+                if (quote.is_object()) {
+                    uint32_t token = static_cast<uint32_t>(std::strtoul(text(quote, "symbolToken").c_str(), nullptr, 10));
+                    fetched[token] = &quote;
+                }
+            }
+        } else {
+            std::string message = result != CURLE_OK ? curl_easy_strerror(result) : text(response, "message");
+            event_log_.write("Snapshot request for {} tokens failed: {} (HTTP {})", batch.size(),
+                             message.empty() ? "bad response" : message, status);
+        }
+
+        // Tokens without an answer go back in the queue until their deadline
+        std::vector<std::pair<uint32_t, Pending>> retry;
+        for (const auto& [token, pending] : batch) {
+            auto it = fetched.find(token);
+            if (it == fetched.end()) {
+                retry.emplace_back(token, pending);
+            } else {
+                publish(token, pending, *it->second);
+            }
+        }
+        if (!retry.empty()) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (const auto& [token, pending] : retry) {
+                pending_.emplace(token, pending);
+            }
+        }
+    }
+
+    static int64_t paise(const nlohmann::json& quote, const char* key) {
+        return quote.contains(key) && quote[key].is_number() ? std::llround(quote[key].get<double>() * 100) : 0;
+    }
+
+    static int64_t number(const nlohmann::json& quote, const char* key) {
+        return quote.contains(key) && quote[key].is_number() ? std::llround(quote[key].get<double>()) : 0;
+    }
+
+    static double real(const nlohmann::json& quote, const char* key) {
+        return quote.contains(key) && quote[key].is_number() ? quote[key].get<double>() : 0.0;
+    }
+
+    // Empty unless the field is a string
+    static std::string text(const nlohmann::json& object, const char* key) {
+        return object.is_object() && object.contains(key) && object[key].is_string() ? object[key].get<std::string>() : std::string();
+    }
+
+    void publish(uint32_t token, const Pending& pending, const nlohmann::json& quote) {
+        int32_t instrument_index = instruments_.index_of(token);
+        if (instrument_index == InstrumentTable::NOT_FOUND) {
+            return;
+        }
+
+        Tick tick{};
+        tick.token = token;
+        tick.mode = MODE_SNAP_QUOTE;
+        tick.exchange_type = pending.exchange_type;
+        tick.flags = TICK_FLAG_SNAPSHOT;
+        tick.exchange_timestamp = parse_quote_time_ms(text(quote, "exchFeedTime"));
+        if (tick.exchange_timestamp == 0) {
+            undated_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        // The stream has moved past this snapshot already
+        int64_t live_timestamp = instruments_.feed_state(instrument_index).exchange_timestamp.load(std::memory_order_relaxed);
+        if (live_timestamp >= tick.exchange_timestamp) {
+            superseded_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        tick.ltp = paise(quote, "ltp");
+        tick.last_traded_qty = number(quote, "lastTradeQty");
+        tick.avg_traded_price = paise(quote, "avgPrice");
+        tick.volume = number(quote, "tradeVolume");
+        tick.total_buy_qty = real(quote, "totBuyQuan");
+        tick.total_sell_qty = real(quote, "totSellQuan");
+        tick.open = paise(quote, "open");
+        tick.high = paise(quote, "high");
+        tick.low = paise(quote, "low");
+        tick.close = paise(quote, "close");
+        tick.open_interest = number(quote, "opnInterest");
+        tick.upper_circuit = paise(quote, "upperCircuit");
+        tick.lower_circuit = paise(quote, "lowerCircuit");
+        tick.high_52_week = paise(quote, "52WeekHigh");
+        tick.low_52_week = paise(quote, "52WeekLow");
+        if (quote.contains("depth") && quote["depth"].is_object()) {
+            const auto& depth = quote["depth"];
+            bool buy = depth.contains("buy") && depth["buy"].is_array();
+            bool sell = depth.contains("sell") && depth["sell"].is_array();
+            for (int level = 0; level < DEPTH_LEVELS; ++level) {
+                if (buy && level < static_cast<int>(depth["buy"].size())) {
+                    const auto& entry = depth["buy"][level];
+                    tick.bids[level] = DepthLevel{paise(entry, "price"), number(entry, "quantity"), static_cast<int32_t>(number(entry, "orders")), 0};
+                }
+                if (sell && level < static_cast<int>(depth["sell"].size())) {
+                    const auto& entry = depth["sell"][level];
+                    tick.asks[level] = DepthLevel{paise(entry, "price"), number(entry, "quantity"), static_cast<int32_t>(number(entry, "orders")), 0};
+                }
+            }
+        }
+        tick.receive_ns = steady_now_ns();
+        tick.decoded_ns = tick.receive_ns;
+
+        dispatcher_.publish(tick, instrument_index);
+        recovered_.fetch_add(1, std::memory_order_relaxed);
+        recovery_time_.record(tick.receive_ns - pending.requested_ns);
+    }
+};
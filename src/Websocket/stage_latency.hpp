@@ -0,0 +1,206 @@
+#pragma once
+
+// Per-stage tick latency.
+//
+// A tick is timed at four points: the exchange timestamp in its packet, the
+// complete websocket frame handed to on_message (Tick::receive_ns), the end of
+// decoding (Tick::decoded_ns) and its dequeue by a consumer, where this sink
+// runs. Each consumer thread records into its own LatencyHistogram per hop
+// with plain stores, and snapshot() merges them. websocketpp does not report when the
+// socket read finished, so on_message is the earliest local point.
+//
+// The exchange timestamp is wall-clock milliseconds; hops starting there are
+// measured through a steady-to-wall offset refreshed by the reporter, so they
+// carry up to 1 ms of truncation plus any skew between our clock and the
+// exchange's. Replayed sessions have historical exchange timestamps and only
+// record the local hops.
+//
+// The reporter prints interval percentiles every interval and totals on
+// stop(). mark() closes the current interval early under a label, so each
+// reconnect splits the report into the latency before and after it.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "latency_histogram.hpp"
+#include "smartstream.hpp"
+#include "tick_dispatcher.hpp"
+
+enum TickStage {
+    STAGE_EXCHANGE_TO_FRAME,
+    STAGE_FRAME_TO_DECODED,
+    STAGE_DECODED_TO_CONSUMED,
+    STAGE_EXCHANGE_TO_CONSUMED,
+    TICK_STAGE_COUNT
+};
+
+inline const char* tick_stage_name(int stage) {
+    switch (stage) {
+        case STAGE_EXCHANGE_TO_FRAME: return "exchange->frame";
+        case STAGE_FRAME_TO_DECODED: return "frame->decoded";
+        case STAGE_DECODED_TO_CONSUMED: return "decoded->consumed";
+        case STAGE_EXCHANGE_TO_CONSUMED: return "exchange->consumed";
+        default: return "unknown";
+    }
+}
+
+class StageLatencySink : public TickSink {
+public:
+    // exchange_clock: whether exchange timestamps are live and comparable
+    // with our wall clock (false for replay)
+    StageLatencySink(const TickDispatcher& dispatcher, bool exchange_clock)
+        : dispatcher_(dispatcher), exchange_clock_(exchange_clock),
+          consumers_(new ConsumerStages[dispatcher.consumer_count()]) {
+        refresh_clock_offset();
+    }
+
+    ~StageLatencySink() override {
+        stop();
+    }
+
+    void on_tick(const Tick& tick, int32_t instrument_index) override {
+        // A recovered snapshot's age is the outage, not feed latency
+        if (tick.flags & TICK_FLAG_SNAPSHOT) {
+            return;
+        }
+        LatencyHistogram* stages = consumers_[dispatcher_.consumer_of(instrument_index)].stages;
+        int64_t now_ns = steady_now_ns();
+        stages[STAGE_FRAME_TO_DECODED].record_local(tick.decoded_ns - tick.receive_ns);
+        stages[STAGE_DECODED_TO_CONSUMED].record_local(now_ns - tick.decoded_ns);
+        if (exchange_clock_ && tick.exchange_timestamp > 0) {
+            int64_t offset_ns = clock_offset_ns_.load(std::memory_order_relaxed);
+            int64_t exchange_ns = tick.exchange_timestamp * 1000000;
+            stages[STAGE_EXCHANGE_TO_FRAME].record_local(tick.receive_ns + offset_ns - exchange_ns);
+            stages[STAGE_EXCHANGE_TO_CONSUMED].record_local(now_ns + offset_ns - exchange_ns);
+        }
+    }
+
+    // Reports every interval_s seconds; 0 only reports marks and totals
+    void start(int interval_s) {
+        running_ = true;
+        report_thread_ = std::thread(&StageLatencySink::run, this, interval_s);
+    }
+
+    // Prints the totals since start; safe to call more than once
+    void stop() {
+        if (!running_.exchange(false)) {
+            return;
+        }
+        wake_.notify_one();
+        report_thread_.join();
+    }
+
+    // Ends the current interval now, reporting it under the given label
+    void mark(const std::string& label) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            marks_.push_back(label);
+        }
+        wake_.notify_one();
+    }
+
+    LatencyHistogram::Snapshot snapshot(TickStage stage) const {
+        LatencyHistogram::Snapshot merged = consumers_[0].stages[stage].snapshot();
+        for (size_t i = 1; i < dispatcher_.consumer_count(); ++i) {
+            merged.merge(consumers_[i].stages[stage].snapshot());
+        }
+        return merged;
+    }
+
+    // One line per stage with samples since start
+    std::string report() const {
+        LatencyHistogram::Snapshot current[TICK_STAGE_COUNT];
+        take_snapshots(current);
+        return format_report(current, nullptr);
+    }
+
+private:
+    // Written only by the consumer thread that owns it
+    struct alignas(64) ConsumerStages {
+        LatencyHistogram stages[TICK_STAGE_COUNT];
+    };
+
+    const TickDispatcher& dispatcher_;
+    const bool exchange_clock_;
+    std::unique_ptr<ConsumerStages[]> consumers_;
+    std::atomic<int64_t> clock_offset_ns_{0};
+
+    std::atomic<bool> running_{false};
+    std::thread report_thread_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::vector<std::string> marks_;
+
+    void take_snapshots(LatencyHistogram::Snapshot* out) const {
+        for (int stage = 0; stage < TICK_STAGE_COUNT; ++stage) {
+            out[stage] = snapshot(static_cast<TickStage>(stage));
+        }
+    }
+
+    static std::string format_report(const LatencyHistogram::Snapshot* current, const LatencyHistogram::Snapshot* since) {
+        std::string out;
+        for (int stage = 0; stage < TICK_STAGE_COUNT; ++stage) {
+            LatencyHistogram::Snapshot snap = since != nullptr ? current[stage].since(since[stage]) : current[stage];
+            if (snap.total == 0) {
+                continue;
+            }
+            out += "  ";
+            out += tick_stage_name(stage);
+            out += ": ";
+            out += snap.summary();
+            out += '\n';
+        }
+        return out;
+    }
+
+    void refresh_clock_offset() {
+        clock_offset_ns_.store(wall_now_ns() - steady_now_ns(), std::memory_order_relaxed);
+    }
+
+    void run(int interval_s) {
+        LatencyHistogram::Snapshot last[TICK_STAGE_COUNT];
+        LatencyHistogram::Snapshot current[TICK_STAGE_COUNT];
+        take_snapshots(last);
+        auto interval_start = std::chrono::steady_clock::now();
+
+        while (running_.load()) {
+            std::vector<std::string> marks;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait_for(lock, std::chrono::milliseconds(100), [this]() { return !marks_.empty() || !running_.load(); });
+                marks.swap(marks_);
+            }
+            refresh_clock_offset();
+
+            auto now = std::chrono::steady_clock::now();
+            double elapsed = std::chrono::duration<double>(now - interval_start).count();
+            bool interval_due = interval_s > 0 && elapsed >= interval_s;
+            if (marks.empty() && !interval_due) {
+                continue;
+            }
+
+            std::ostringstream heading;
+            heading << std::fixed << std::setprecision(1) << "Latency over " << elapsed << "s";
+            for (const auto& mark : marks) {
+                heading << ", until " << mark;
+            }
+            take_snapshots(current);
+            std::string lines = format_report(current, last);
+            std::cout << heading.str() << (lines.empty() ? ": no ticks" : "") << std::endl << lines;
+            std::copy(current, current + TICK_STAGE_COUNT, last);
+            interval_start = now;
+        }
+        std::cout << "Latency totals" << std::endl << report();
+    }
+};
@@ -0,0 +1,244 @@
+#pragma once
+
+// Live ATM-centred strike window.
+//
+// BSEtokens selects the day's option universe once, from the previous close
+// +/-10%. With a window configured, ws subscribes only the strikes within
+// +/-N steps of at-the-money on each index's nearest expiry, and moves the
+// window as the index ticks arrive. Every AMXIDX instrument with options of
+// the same name in the table gets a chain; its options start unsubscribed and
+// the first index tick centres the window.
+//
+// The window re-centres only once the index has moved past the midpoint to
+// the next strike by a further hysteresis fraction of the strike step, so an
+// index oscillating around a midpoint does not flip the window on every tick.
+// A re-centre adds and removes just the strikes that entered or left the
+// window, and each shard's subscription manager turns that into at most one
+// subscribe and one unsubscribe request.
+//
+// on_tick() runs on a consumer thread. Each chain is only touched by the
+// consumer that owns its index token, so the hot path takes no lock; the
+// subscription manager is locked only on a re-centre.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "instrument_table.hpp"
+#include "smartstream.hpp"
+#include "subscription_manager.hpp"
+#include "tick_dispatcher.hpp"
+
+struct StrikeWindowSettings {
+    int strikes = 0;            // Strikes either side of ATM; 0 disables the window
+    double hysteresis = 0.25;   // Fraction of a strike step beyond the midpoint
+    int mode = MODE_SNAP_QUOTE;
+    int32_t min_expiry = 0;     // YYYYMMDD; earlier expiries are ignored
+};
+
+class StrikeWindow : public TickSink {
+public:
+    // Called on the consumer thread after a re-centre has updated the desired
+    // subscriptions, typically to flush them
+    typedef std::function<void(const std::string& name, double atm_strike, size_t added, size_t removed)> RecentreCallback;
+
+    struct Status {
+        std::string name;
+        double index_price;  // Rupees, last index tick
+        double atm_strike;   // Centre of the window, 0 until the first tick
+        int32_t expiry;
+        size_t chain_strikes;
+        size_t window_tokens;
+        uint64_t recentres;
+    };
+
+    StrikeWindow(const InstrumentTable& instruments, ShardedSubscriptions& subscriptions, const StrikeWindowSettings& settings)
+        : subscriptions_(subscriptions), settings_(settings), chain_of_(instruments.size(), -1) {
+        if (settings_.strikes > 0) {
+            build_chains(instruments);
+        }
+    }
+
+    // Set before any tick can arrive
+    void set_on_recentre(RecentreCallback on_recentre) { on_recentre_ = std::move(on_recentre); }
+
+    bool enabled() const { return settings_.strikes > 0 && !chains_.empty(); }
+
+    // Option tokens the window manages, which the starting universe leaves out
+    std::vector<std::string> managed_tokens() const {
+        std::vector<std::string> tokens;
+        for (const auto& chain : chains_) {
+            for (const auto& strike : chain->strikes) {
+                for (const auto& token : strike.tokens) {
+                    tokens.push_back(token);
+                }
+            }
+        }
+        return tokens;
+    }
+
+    void on_tick(const Tick& tick, int32_t instrument_index) override {
+        if (instrument_index < 0 || static_cast<size_t>(instrument_index) >= chain_of_.size()) {
+            return;
+        }
+        int chain_index = chain_of_[instrument_index];
+        if (chain_index < 0 || tick.ltp <= 0) {
+            return;
+        }
+        Chain& chain = *chains_[chain_index];
+        double price = tick.ltp / 100.0;
+        chain.index_price.store(price, std::memory_order_relaxed);
+
+        int centre = chain.centre.load(std::memory_order_relaxed);
+        if (centre >= 0 && !should_recentre(chain, centre, price)) {
+            return;
+        }
+        int atm = nearest_strike(chain, price);
+        if (atm != centre) {
+            recentre(chain, centre, atm);
+        }
+    }
+
+    std::vector<Status> status() const {
+        std::vector<Status> out;
+        for (const auto& chain : chains_) {
+            int centre = chain->centre.load(std::memory_order_relaxed);
+            out.push_back(Status{chain->name, chain->index_price.load(std::memory_order_relaxed),
+                                 centre >= 0 ? chain->strikes[centre].strike : 0.0, chain->expiry,
+                                 chain->strikes.size(), chain->window_tokens.load(std::memory_order_relaxed),
+                                 chain->recentres.load(std::memory_order_relaxed)});
+        }
+        return out;
+    }
+
+private:
+    struct Strike {
+        double strike;
+        std::vector<std::string> tokens;  // CE and PE
+    };
+
+    struct Chain {
+        std::string name;
+        int32_t expiry = 0;
+        std::vector<Strike> strikes;  // Ascending
+        std::atomic<int> centre{-1};
+        std::atomic<double> index_price{0};
+        std::atomic<size_t> window_tokens{0};
+        std::atomic<uint64_t> recentres{0};
+    };
+
+    ShardedSubscriptions& subscriptions_;
+    const StrikeWindowSettings settings_;
+    RecentreCallback on_recentre_;
+    std::vector<std::unique_ptr<Chain>> chains_;
+    std::vector<int> chain_of_;  // Instrument index -> chain, -1 for the rest
+
+    // One chain per index with options: the nearest expiry not before
+    // min_expiry, strikes ascending
+    void build_chains(const InstrumentTable& instruments) {
+        const auto& all = instruments.instruments();
+        std::map<std::string, int32_t> nearest_expiry;
+        for (const auto& instrument : all) {
+            if (instrument.option_type == OPTION_NONE || instrument.expiry < settings_.min_expiry) {
+                continue;
+            }
+            auto it = nearest_expiry.find(instrument.name);
+            if (it == nearest_expiry.end() || instrument.expiry < it->second) {
+                nearest_expiry[instrument.name] = instrument.expiry;
+            }
+        }
+
+        for (size_t i = 0; i < all.size(); ++i) {
+            const Instrument& index = all[i];
+            if (index.exchange_type != BSE_CM || index.option_type != OPTION_NONE) {
+                continue;
+            }
+            auto expiry = nearest_expiry.find(index.name);
+            if (expiry == nearest_expiry.end()) {
+                continue;
+            }
+            std::unique_ptr<Chain> chain(new Chain());
+            chain->name = index.name;
+            chain->expiry = expiry->second;
+
+            std::map<double, std::vector<std::string>> by_strike;
+            for (const auto& option : all) {
+                if (option.option_type != OPTION_NONE && option.expiry == chain->expiry &&
+                    std::strncmp(option.name, index.name, sizeof(option.name)) == 0) {
+                    by_strike[option.strike].push_back(std::to_string(option.token));
+                }
+            }
+            for (auto& [strike, tokens] : by_strike) {
+                chain->strikes.push_back(Strike{strike, std::move(tokens)});
+            }
+            chain_of_[i] = static_cast<int>(chains_.size());
+            chains_.push_back(std::move(chain));
+        }
+    }
+
+    static int nearest_strike(const Chain& chain, double price) {
+        const auto& strikes = chain.strikes;
+        auto it = std::lower_bound(strikes.begin(), strikes.end(), price,
+                                   [](const Strike& strike, double value) { return strike.strike < value; });
+        if (it == strikes.end()) {
+            return static_cast<int>(strikes.size()) - 1;
+        }
+        if (it != strikes.begin() && price - (it - 1)->strike < it->strike - price) {
+            --it;
+        }
+        return static_cast<int>(it - strikes.begin());
+    }
+
+    // Past the midpoint towards the neighbouring strike by the hysteresis
+    // fraction of the gap between them
+    bool should_recentre(const Chain& chain, int centre, double price) const {
+        double atm = chain.strikes[centre].strike;
+        int neighbour = price > atm ? centre + 1 : centre - 1;
+        if (neighbour < 0 || neighbour >= static_cast<int>(chain.strikes.size())) {
+            return false;
+        }
+        double gap = std::fabs(chain.strikes[neighbour].strike - atm);
+        return std::fabs(price - atm) >= gap * (0.5 + settings_.hysteresis);
+    }
+
+    void recentre(Chain& chain, int from, int to) {
+        int last = static_cast<int>(chain.strikes.size()) - 1;
+        int old_low = from < 0 ? 1 : std::max(0, from - settings_.strikes);
+        int old_high = from < 0 ? 0 : std::min(last, from + settings_.strikes);
+        int new_low = std::max(0, to - settings_.strikes);
+        int new_high = std::min(last, to + settings_.strikes);
+
+        std::vector<std::string> added;
+        std::vector<std::string> removed;
+        size_t window_tokens = 0;
+        for (int i = std::min(old_low, new_low); i <= std::max(old_high, new_high); ++i) {
+            bool in_old = i >= old_low && i <= old_high;
+            bool in_new = i >= new_low && i <= new_high;
+            const auto& tokens = chain.strikes[i].tokens;
+            if (in_new) {
+                window_tokens += tokens.size();
+            }
+            if (in_new && !in_old) {
+                added.insert(added.end(), tokens.begin(), tokens.end());
+            } else if (in_old && !in_new) {
+                removed.insert(removed.end(), tokens.begin(), tokens.end());
+            }
+        }
+
+        subscriptions_.remove(settings_.mode, BSE_FO, removed);
+        subscriptions_.add(settings_.mode, BSE_FO, added);
+        chain.centre.store(to, std::memory_order_relaxed);
+        chain.window_tokens.store(window_tokens, std::memory_order_relaxed);
+        chain.recentres.fetch_add(1, std::memory_order_relaxed);
+        if (on_recentre_) {
+            on_recentre_(chain.name, chain.strikes[to].strike, added.size(), removed.size());
+        }
+    }
+};
@@ -0,0 +1,335 @@
+#pragma once
+
+// Desired versus acknowledged SmartStream subscriptions.
+//
+// Callers edit the desired token set per (mode, exchange type) from any
+// thread. take_requests() diffs it against what the current connection has
+// been sent and returns only the subscribe/unsubscribe deltas, packed across
+// exchange types into requests of at most max_batch tokens, each with its own
+// correlationID. Unsubscribes come first so a universe change never exceeds
+// the session's token limit on the way.
+//
+// SmartStream does not acknowledge a subscription, it only rejects one, so a
+// sent token counts as acknowledged until an error frame names its request.
+// Rejected tokens leave the desired set as well, so they are not retried on
+// every flush. reset() forgets the connection's state; the next
+// take_requests() then replays the whole desired set.
+//
+// A sharded feed has one manager per connection. ShardedSubscriptions routes
+// each token to its shard by a stable hash of the token number, so a token
+// always lives on the same connection and the split does not depend on the
+// order of the CSVs.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+constexpr int UNSUBSCRIBE_ACTION = 0;
+constexpr int SUBSCRIBE_ACTION = 1;
+
+struct SubscriptionRequest {
+    std::string correlation_id;
+    int action = SUBSCRIBE_ACTION;
+    int mode = 0;
+    std::vector<std::pair<int, std::vector<std::string>>> token_list;  // Exchange type, tokens
+
+    size_t token_count() const {
+        size_t count = 0;
+        for (const auto& entry : token_list) {
+            count += entry.second.size();
+        }
+        return count;
+    }
+
+    std::string to_json() const {
+        nlohmann::json request;
+        request["correlationID"] = correlation_id;
+        request["action"] = action;
+        request["params"]["mode"] = mode;
+        nlohmann::json list = nlohmann::json::array();
+        for (const auto& [exchange_type, tokens] : token_list) {
+            list.push_back({{"exchangeType", exchange_type}, {"tokens", tokens}});
+        }
+        request["params"]["tokenList"] = list;
+        return request.dump();
+    }
+};
+
+class SubscriptionManager {
+public:
+    static constexpr size_t REMEMBERED_REQUESTS = 1024;  // Sent requests an error frame can still name
+
+    explicit SubscriptionManager(size_t max_batch = 1000) : max_batch_(max_batch == 0 ? 1 : max_batch) {}
+
+    void add(int mode, int exchange_type, const std::vector<std::string>& tokens) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& desired = keys_[Key(mode, exchange_type)].desired;
+        desired.insert(tokens.begin(), tokens.end());
+    }
+
+    void remove(int mode, int exchange_type, const std::vector<std::string>& tokens) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& desired = keys_[Key(mode, exchange_type)].desired;
+        for (const auto& token : tokens) {
+            desired.erase(token);
+        }
+    }
+
+    // Makes tokens the whole desired set for this mode and exchange type
+    void replace(int mode, int exchange_type, const std::vector<std::string>& tokens) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        keys_[Key(mode, exchange_type)].desired = std::set<std::string>(tokens.begin(), tokens.end());
+    }
+
+    // Deltas between the desired and acknowledged sets, which are counted as
+    // acknowledged from here on. Requests that then fail to send go back
+    // through send_failed().
+    std::vector<SubscriptionRequest> take_requests() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<SubscriptionRequest> requests;
+        for (int action : {UNSUBSCRIBE_ACTION, SUBSCRIBE_ACTION}) {
+            for (auto& [key, state] : keys_) {
+                const std::set<std::string>& from = action == SUBSCRIBE_ACTION ? state.desired : state.acknowledged;
+                const std::set<std::string>& to = action == SUBSCRIBE_ACTION ? state.acknowledged : state.desired;
+                std::vector<std::string> delta;
+                for (const auto& token : from) {
+                    if (to.count(token) == 0) {
+                        delta.push_back(token);
+                    }
+                }
+                for (const auto& token : delta) {
+                    if (action == SUBSCRIBE_ACTION) {
+                        state.acknowledged.insert(token);
+                    } else {
+                        state.acknowledged.erase(token);
+                    }
+                }
+                append_batched(requests, action, key, delta);
+            }
+        }
+        for (const auto& request : requests) {
+            remember(request);
+        }
+        return requests;
+    }
+
+    // Undoes a request taken by take_requests() that never reached the server
+    void send_failed(const SubscriptionRequest& request) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& [exchange_type, tokens] : request.token_list) {
+            auto& acknowledged = keys_[Key(request.mode, exchange_type)].acknowledged;
+            for (const auto& token : tokens) {
+                if (request.action == SUBSCRIBE_ACTION) {
+                    acknowledged.erase(token);
+                } else {
+                    acknowledged.insert(token);
+                }
+            }
+        }
+    }
+
+    // Handles an error frame naming a sent request. Rejected subscriptions
+    // leave both sets; returns the number of tokens affected, 0 if the
+    // correlationID is unknown.
+    size_t reject(const std::string& correlation_id) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto it = sent_.begin(); it != sent_.end(); ++it) {
+            if (it->correlation_id != correlation_id) {
+                continue;
+            }
+            if (it->action == SUBSCRIBE_ACTION) {
+                for (const auto& [exchange_type, tokens] : it->token_list) {
+                    KeyState& state = keys_[Key(it->mode, exchange_type)];
+                    for (const auto& token : tokens) {
+                        state.acknowledged.erase(token);
+                        state.desired.erase(token);
+                    }
+                }
+            }
+            size_t count = it->token_count();
+            sent_.erase(it);
+            return count;
+        }
+        return 0;
+    }
+
+    // New connection: nothing is subscribed on it yet
+    void reset() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& entry : keys_) {
+            entry.second.acknowledged.clear();
+        }
+        sent_.clear();
+    }
+
+    // Exchange type and token of everything the current connection was sent
+    std::vector<std::pair<uint8_t, uint32_t>> acknowledged_tokens() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<std::pair<uint8_t, uint32_t>> tokens;
+        for (const auto& [key, state] : keys_) {
+            for (const auto& token : state.acknowledged) {
+                tokens.emplace_back(static_cast<uint8_t>(key.second), static_cast<uint32_t>(std::strtoul(token.c_str(), nullptr, 10)));
+            }
+        }
+        return tokens;
+    }
+
+    size_t desired_count() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t count = 0;
+        for (const auto& entry : keys_) {
+            count += entry.second.desired.size();
+        }
+        return count;
+    }
+
+    size_t acknowledged_count() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t count = 0;
+        for (const auto& entry : keys_) {
+            count += entry.second.acknowledged.size();
+        }
+        return count;
+    }
+
+private:
+    typedef std::pair<int, int> Key;  // Mode, exchange type
+
+    struct KeyState {
+        std::set<std::string> desired;
+        std::set<std::string> acknowledged;
+    };
+
+    const size_t max_batch_;
+    mutable std::mutex mutex_;
+    std::map<Key, KeyState> keys_;
+    std::deque<SubscriptionRequest> sent_;
+    uint64_t next_id_ = 0;
+
+    // Keys are ordered by mode, so consecutive exchange types of one mode
+    // share requests until the batch is full
+    void append_batched(std::vector<SubscriptionRequest>& requests, int action, const Key& key, const std::vector<std::string>& tokens) {
+        size_t i = 0;
+        while (i < tokens.size()) {
+            if (requests.empty() || requests.back().action != action || requests.back().mode != key.first ||
+                requests.back().token_count() >= max_batch_) {
+                SubscriptionRequest request;
+                request.correlation_id = next_correlation_id(action);
+                request.action = action;
+                request.mode = key.first;
+                requests.push_back(std::move(request));
+            }
+            SubscriptionRequest& request = requests.back();
+            size_t take = std::min(max_batch_ - request.token_count(), tokens.size() - i);
+            if (request.token_list.empty() || request.token_list.back().first != key.second) {
+                request.token_list.emplace_back(key.second, std::vector<std::string>());
+            }
+            auto& list = request.token_list.back().second;
+            list.insert(list.end(), tokens.begin() + i, tokens.begin() + i + take);
+            i += take;
+        }
+    }
+
+    // SmartStream wants a 10 character correlationID
+    std::string next_correlation_id(int action) {
+        char id[16];
+        std::snprintf(id, sizeof(id), "%s%07llu", action == SUBSCRIBE_ACTION ? "sub" : "uns",
+                      static_cast<unsigned long long>(++next_id_ % 10000000));
+        return id;
+    }
+
+    void remember(const SubscriptionRequest& request) {
+        sent_.push_back(request);
+        if (sent_.size() > REMEMBERED_REQUESTS) {
+            sent_.pop_front();
+        }
+    }
+};
+
+// Stable shard for a token: the murmur3 finaliser, scaled to [0, shards).
+// Neighbouring tokens (one expiry's strikes) spread across shards.
+inline size_t shard_of_token(uint32_t token, size_t shards) {
+    uint32_t hash = token;
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6Bu;
+    hash ^= hash >> 13;
+    hash *= 0xC2B2AE35u;
+    hash ^= hash >> 16;
+    return static_cast<size_t>((static_cast<uint64_t>(hash) * shards) >> 32);
+}
+
+inline size_t shard_of_token(const std::string& token, size_t shards) {
+    return shard_of_token(static_cast<uint32_t>(std::strtoul(token.c_str(), nullptr, 10)), shards);
+}
+
+// One SubscriptionManager per shard behind the single-manager editing calls
+class ShardedSubscriptions {
+public:
+    ShardedSubscriptions(size_t shards, size_t max_batch) {
+        for (size_t i = 0; i < std::max<size_t>(shards, 1); ++i) {
+            shards_.emplace_back(new SubscriptionManager(max_batch));
+        }
+    }
+
+    size_t shard_count() const { return shards_.size(); }
+    SubscriptionManager& shard(size_t index) { return *shards_[index]; }
+    const SubscriptionManager& shard(size_t index) const { return *shards_[index]; }
+
+    void add(int mode, int exchange_type, const std::vector<std::string>& tokens) {
+        std::vector<std::vector<std::string>> split = partition(tokens);
+        for (size_t i = 0; i < shards_.size(); ++i) {
+            shards_[i]->add(mode, exchange_type, split[i]);
+        }
+    }
+
+    void remove(int mode, int exchange_type, const std::vector<std::string>& tokens) {
+        std::vector<std::vector<std::string>> split = partition(tokens);
+        for (size_t i = 0; i < shards_.size(); ++i) {
+            shards_[i]->remove(mode, exchange_type, split[i]);
+        }
+    }
+
+    void replace(int mode, int exchange_type, const std::vector<std::string>& tokens) {
+        std::vector<std::vector<std::string>> split = partition(tokens);
+        for (size_t i = 0; i < shards_.size(); ++i) {
+            shards_[i]->replace(mode, exchange_type, split[i]);
+        }
+    }
+
+    size_t desired_count() const {
+        size_t count = 0;
+        for (const auto& shard : shards_) {
+            count += shard->desired_count();
+        }
+        return count;
+    }
+
+    size_t acknowledged_count() const {
+        size_t count = 0;
+        for (const auto& shard : shards_) {
+            count += shard->acknowledged_count();
+        }
+        return count;
+    }
+
+private:
+    std::vector<std::unique_ptr<SubscriptionManager>> shards_;
+
+    std::vector<std::vector<std::string>> partition(const std::vector<std::string>& tokens) const {
+        std::vector<std::vector<std::string>> split(shards_.size());
+        for (const auto& token : tokens) {
+            split[shard_of_token(token, shards_.size())].push_back(token);
+        }
+        return split;
+    }
+};
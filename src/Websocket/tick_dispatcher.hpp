@@ -0,0 +1,211 @@
+#pragma once
+
+// Hands decoded ticks from the network thread to consumer threads.
+//
+// Each consumer owns one BoundedRing; publish() routes a tick to a ring by its
+// instrument index so every token is always handled by the same consumer and
+// stays in order. Consumers drain their ring in batches and pass each tick to
+// the registered sinks. Nothing on the publish side takes a lock.
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "smartstream.hpp"
+#include "tick_ring.hpp"
+
+// A closed OHLCV bar from the bar engine (bar_engine.hpp). Prices are in
+// paise like Tick's; the layout is also the Kafka and journal payload.
+struct Bar {
+    uint32_t token;
+    uint8_t exchange_type;
+    uint8_t reserved;
+    uint16_t interval_s;
+    int64_t start_ms;       // Exchange time the bar opened, epoch ms
+    int64_t open;
+    int64_t high;
+    int64_t low;
+    int64_t close;
+    int64_t volume;         // Traded in the bar, from the cumulative day volume
+    int64_t open_interest;  // Last seen in the bar
+    uint32_t ticks;
+    uint32_t reserved2;
+};
+
+static_assert(sizeof(Bar) == 72, "Bar is a wire and file format");
+
+// A downstream stage. on_tick() runs on a consumer thread; when more than one
+// consumer is configured a sink sees ticks from several threads concurrently
+// (but any one token only ever from the same thread).
+class TickSink {
+public:
+    virtual ~TickSink() = default;
+    virtual void on_tick(const Tick& tick, int32_t instrument_index) = 0;
+
+    // A bar closed; same thread rules as on_tick() for its token.
+    virtual void on_bar(const Bar& bar, int32_t instrument_index) {}
+
+    // Called when a consumer finds its ring empty, a good moment to flush,
+    // and again about once a second while it stays empty.
+    virtual void on_idle() {}
+};
+
+struct TickDispatcherSettings {
+    size_t ring_capacity = 65536;
+    size_t consumer_threads = 1;
+    OverflowPolicy overflow = OverflowPolicy::DROP_OLDEST;
+};
+
+class TickDispatcher {
+public:
+    static constexpr size_t POP_BATCH = 64;
+    static constexpr unsigned IDLE_REPEAT_ROUNDS = 8192;  // Sleeping rounds of ~100us
+
+    explicit TickDispatcher(const TickDispatcherSettings& settings) : settings_(settings) {
+        size_t consumers = settings_.consumer_threads == 0 ? 1 : settings_.consumer_threads;
+        for (size_t i = 0; i < consumers; ++i) {
+            rings_.emplace_back(new BoundedRing<RoutedTick>(settings_.ring_capacity, settings_.overflow));
+        }
+    }
+
+    ~TickDispatcher() {
+        stop();
+    }
+
+    // Sinks must be registered before start().
+    void add_sink(TickSink* sink) {
+        sinks_.push_back(sink);
+    }
+
+    void start() {
+        if (running_.exchange(true)) {
+            return;
+        }
+        for (size_t i = 0; i < rings_.size(); ++i) {
+            consumers_.emplace_back(&TickDispatcher::consume, this, i);
+        }
+    }
+
+    // Stops the consumers after they drain whatever is already queued.
+    void stop() {
+        if (!running_.exchange(false)) {
+            return;
+        }
+        for (auto& consumer : consumers_) {
+            consumer.join();
+        }
+        consumers_.clear();
+    }
+
+    // Called from the network thread. Never blocks unless the BLOCK overflow
+    // policy was chosen and the consumer has fallen a full ring behind.
+    bool publish(const Tick& tick, int32_t instrument_index) {
+        return rings_[consumer_of(instrument_index)]->push(RoutedTick{tick, instrument_index});
+    }
+
+    // Called from a consumer thread (by a sink such as the bar engine) to hand
+    // a bar to every sink, on the thread that owns the bar's token.
+    void publish_bar(const Bar& bar, int32_t instrument_index) {
+        for (TickSink* sink : sinks_) {
+            sink->on_bar(bar, instrument_index);
+        }
+    }
+
+    // The consumer whose ring carries an instrument's ticks
+    size_t consumer_of(int32_t instrument_index) const {
+        return rings_.size() == 1 ? 0 : static_cast<size_t>(instrument_index) % rings_.size();
+    }
+
+    size_t consumer_count() const { return rings_.size(); }
+    size_t ring_capacity() const { return rings_.front()->capacity(); }
+    OverflowPolicy overflow_policy() const { return settings_.overflow; }
+
+    size_t occupancy() const {
+        size_t total = 0;
+        for (const auto& ring : rings_) {
+            total += ring->occupancy();
+        }
+        return total;
+    }
+
+    uint64_t published() const {
+        uint64_t total = 0;
+        for (const auto& ring : rings_) {
+            total += ring->pushed();
+        }
+        return total;
+    }
+
+    uint64_t dropped() const {
+        uint64_t total = 0;
+        for (const auto& ring : rings_) {
+            total += ring->dropped();
+        }
+        return total;
+    }
+
+    uint64_t consumed() const {
+        return consumed_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct RoutedTick {
+        Tick tick;
+        int32_t instrument_index;
+    };
+
+    void consume(size_t ring_index) {
+        BoundedRing<RoutedTick>& ring = *rings_[ring_index];
+        std::unique_ptr<RoutedTick[]> batch(new RoutedTick[POP_BATCH]);
+        unsigned idle_rounds = 0;
+
+        while (true) {
+            size_t count = ring.pop_batch(batch.get(), POP_BATCH);
+            if (count == 0) {
+                if (!running_.load(std::memory_order_acquire)) {
+                    break;
+                }
+                if (idle_rounds % IDLE_REPEAT_ROUNDS == 0) {
+                    for (TickSink* sink : sinks_) {
+                        sink->on_idle();
+                    }
+                }
+                idle_wait(++idle_rounds);
+                continue;
+            }
+
+            idle_rounds = 0;
+            for (size_t i = 0; i < count; ++i) {
+                for (TickSink* sink : sinks_) {
+                    sink->on_tick(batch[i].tick, batch[i].instrument_index);
+                }
+            }
+            consumed_.fetch_add(count, std::memory_order_relaxed);
+        }
+
+        for (TickSink* sink : sinks_) {
+            sink->on_idle();
+        }
+    }
+
+    // Spin briefly for bursts, then yield, then sleep so an idle feed costs
+    // no CPU.
+    static void idle_wait(unsigned rounds) {
+        if (rounds < 64) {
+            TICK_RING_PAUSE();
+        } else if (rounds < 128) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+
+    TickDispatcherSettings settings_;
+    std::vector<std::unique_ptr<BoundedRing<RoutedTick>>> rings_;
+    std::vector<TickSink*> sinks_;
+    std::vector<std::thread> consumers_;
+    std::atomic<bool> running_{false};
+    std::atomic<uint64_t> consumed_{0};
+};
@@ -0,0 +1,546 @@
+#pragma once
+
+// Append-only binary tick journal.
+//
+// One file per IST trading day (<dir>/YYYYMMDD.tj), pre-allocated in chunks
+// and written through a shared mapping. Each record is the tick's SmartStream
+// packet behind a small fixed header, so a journal replays through exactly
+// the same decode_tick() path as the live socket. The header's data_end is
+// only advanced after a batch of records is complete, which keeps a file that
+// is still being written readable at any moment. Closed bars from the bar
+// engine are interleaved as JOURNAL_RECORD_BAR records, which tick readers
+// skip by type.
+//
+// A sparse index (<dir>/YYYYMMDD.tji) records the first offset of every
+// minute and of every (token, minute) pair. It is rewritten periodically and
+// on rotation; readers rebuild the missing tail by scanning if the writer
+// died before the last rewrite.
+//
+// Versioning: readers accept any file with the same major version and use the
+// size fields in the file and record headers, so minor versions may append
+// fields without breaking old days.
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "market_clock.hpp"
+#include "smartstream.hpp"
+#include "tick_dispatcher.hpp"
+
+constexpr uint64_t JOURNAL_MAGIC = 0x4C4E524A54455342ull;        // "BSETJRNL"
+constexpr uint64_t JOURNAL_INDEX_MAGIC = 0x5844494A54455342ull;  // "BSETJIDX"
+constexpr uint16_t JOURNAL_VERSION_MAJOR = 1;
+constexpr uint16_t JOURNAL_VERSION_MINOR = 0;
+constexpr uint32_t JOURNAL_HEADER_SIZE = 4096;
+constexpr int JOURNAL_MINUTES_PER_DAY = 1440;
+constexpr uint64_t JOURNAL_NO_OFFSET = ~0ull;
+
+enum JournalRecordType : uint16_t {
+    JOURNAL_RECORD_TICK = 1,
+    JOURNAL_RECORD_BAR = 2   // Payload is a Bar; exchange_timestamp is the bar start
+};
+
+struct JournalFileHeader {
+    uint64_t magic;
+    uint16_t version_major;
+    uint16_t version_minor;
+    uint32_t header_size;
+    int32_t date;                      // YYYYMMDD (IST)
+    uint32_t record_header_size;
+    int64_t created_epoch_ms;
+    std::atomic<uint64_t> data_end;    // One past the last committed record
+    std::atomic<uint64_t> record_count;
+};
+
+struct JournalRecordHeader {
+    uint32_t size;                     // Whole record, padded to 8 bytes
+    uint16_t type;
+    uint16_t flags;
+    uint32_t token;
+    uint32_t payload_size;
+    int64_t exchange_timestamp;
+    int64_t receive_ns;
+};
+
+static_assert(sizeof(JournalRecordHeader) == 32, "record header is part of the file format");
+
+struct JournalIndexHeader {
+    uint64_t magic;
+    uint16_t version_major;
+    uint16_t version_minor;
+    uint32_t minute_count;
+    uint64_t covered_end;              // Journal offset the index is complete up to
+    uint64_t token_entry_count;
+};
+
+struct JournalTokenIndexEntry {
+    uint32_t token;
+    uint16_t minute;
+    uint16_t reserved;
+    uint64_t offset;
+
+    bool operator<(const JournalTokenIndexEntry& other) const {
+        return token != other.token ? token < other.token : minute < other.minute;
+    }
+};
+
+inline std::string journal_path(const std::string& dir, int32_t date, const char* extension) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "/%08d%s", date, extension);
+    return dir + name;
+}
+
+// In-memory sparse index shared by the writer and the reader's rebuild path.
+struct JournalIndex {
+    uint64_t minute_offsets[JOURNAL_MINUTES_PER_DAY];
+    std::vector<JournalTokenIndexEntry> token_entries;
+    uint64_t covered_end = JOURNAL_HEADER_SIZE;
+
+    JournalIndex() {
+        reset();
+    }
+
+    void reset() {
+        std::fill(minute_offsets, minute_offsets + JOURNAL_MINUTES_PER_DAY, JOURNAL_NO_OFFSET);
+        token_entries.clear();
+        covered_end = JOURNAL_HEADER_SIZE;
+        last_minute_.clear();
+    }
+
+    // Records stamped on another day than the file's are left out
+    void note(uint32_t token, int64_t exchange_timestamp, uint64_t offset, int32_t date) {
+        if (ist_date(exchange_timestamp) != date) {
+            return;
+        }
+        int32_t minute = ist_minute_of_day(exchange_timestamp);
+        if (minute_offsets[minute] == JOURNAL_NO_OFFSET) {
+            minute_offsets[minute] = offset;
+        }
+        auto it = last_minute_.find(token);
+        if (it == last_minute_.end() || it->second != minute) {
+            last_minute_[token] = minute;
+            token_entries.push_back(JournalTokenIndexEntry{token, static_cast<uint16_t>(minute), 0, offset});
+        }
+    }
+
+    bool save(const std::string& path) const {
+        std::vector<JournalTokenIndexEntry> sorted(token_entries);
+        std::stable_sort(sorted.begin(), sorted.end());
+
+        JournalIndexHeader header{JOURNAL_INDEX_MAGIC, JOURNAL_VERSION_MAJOR, JOURNAL_VERSION_MINOR,
+                                  JOURNAL_MINUTES_PER_DAY, covered_end, sorted.size()};
+        std::string temp = path + ".tmp";
+        FILE* file = std::fopen(temp.c_str(), "wb");
+        if (file == nullptr) {
+            return false;
+        }
+        bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+                  std::fwrite(minute_offsets, sizeof(minute_offsets), 1, file) == 1 &&
+                  (sorted.empty() || std::fwrite(sorted.data(), sizeof(JournalTokenIndexEntry), sorted.size(), file) == sorted.size());
+        ok = std::fclose(file) == 0 && ok;
+        return ok && std::rename(temp.c_str(), path.c_str()) == 0;
+    }
+
+    bool load(const std::string& path) {
+        reset();
+        FILE* file = std::fopen(path.c_str(), "rb");
+        if (file == nullptr) {
+            return false;
+        }
+        JournalIndexHeader header;
+        bool ok = std::fread(&header, sizeof(header), 1, file) == 1 &&
+                  header.magic == JOURNAL_INDEX_MAGIC && header.version_major == JOURNAL_VERSION_MAJOR &&
+                  header.minute_count == JOURNAL_MINUTES_PER_DAY &&
+                  std::fread(minute_offsets, sizeof(minute_offsets), 1, file) == 1;
+        if (ok) {
+            token_entries.resize(header.token_entry_count);
+            ok = token_entries.empty() ||
+                 std::fread(token_entries.data(), sizeof(JournalTokenIndexEntry), token_entries.size(), file) == token_entries.size();
+            covered_end = header.covered_end;
+        }
+        std::fclose(file);
+        if (!ok) {
+            reset();
+        }
+        return ok;
+    }
+
+private:
+    std::unordered_map<uint32_t, int32_t> last_minute_;  // Token -> last indexed minute
+};
+
+class TickJournalWriter : public TickSink {
+public:
+    static constexpr size_t COMMIT_BATCH = 256;
+    static constexpr int64_t INDEX_SAVE_INTERVAL_NS = 60000000000;
+
+    TickJournalWriter(const std::string& dir, size_t chunk_bytes)
+        : dir_(dir), chunk_bytes_(std::max<size_t>(chunk_bytes, 1 << 20)) {}
+
+    TickJournalWriter(const TickJournalWriter&) = delete;
+    TickJournalWriter& operator=(const TickJournalWriter&) = delete;
+
+    ~TickJournalWriter() override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        close_file();
+    }
+
+    void on_tick(const Tick& tick, int32_t instrument_index) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        append(tick);
+    }
+
+    void on_bar(const Bar& bar, int32_t instrument_index) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        append(JOURNAL_RECORD_BAR, 0, bar.token, sizeof(bar), bar.start_ms, steady_now_ns(),
+               [&bar](char* payload) { std::memcpy(payload, &bar, sizeof(bar)); });
+    }
+
+    void on_idle() override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        commit();
+        if (base_ != nullptr && steady_now_ns() - last_index_save_ns_ > INDEX_SAVE_INTERVAL_NS) {
+            save_index();
+        }
+    }
+
+    uint64_t records_written() const { return records_written_.load(std::memory_order_relaxed); }
+    uint64_t write_errors() const { return write_errors_.load(std::memory_order_relaxed); }
+    const std::string& current_path() const { return path_; }
+
+private:
+    void append(const Tick& tick) {
+        append(JOURNAL_RECORD_TICK, tick.flags, tick.token, packet_size_for_mode(tick.mode), tick.exchange_timestamp,
+               tick.receive_ns, [&tick](char* payload) { encode_tick(tick, payload); });
+    }
+
+    // write_payload fills the record's payload in place in the mapping.
+    // Files only rotate forward: a record stamped before the current day
+    // (a late or badly stamped tick) goes into the open file, unindexed, and
+    // one without an exchange timestamp is not journaled.
+    template <typename WritePayload>
+    void append(uint16_t type, uint16_t flags, uint32_t token, size_t payload_size, int64_t exchange_timestamp,
+                int64_t receive_ns, WritePayload write_payload) {
+        if (exchange_timestamp <= 0) {
+            return;
+        }
+        int32_t date = ist_date(exchange_timestamp);
+        if (date > date_ && !open_file(date)) {
+            write_errors_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        size_t record_size = (sizeof(JournalRecordHeader) + payload_size + 7) & ~static_cast<size_t>(7);
+        if (write_offset_ + record_size > mapped_size_ && !grow(write_offset_ + record_size)) {
+            write_errors_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        char* record = base_ + write_offset_;
+        JournalRecordHeader header{static_cast<uint32_t>(record_size), type, flags,
+                                   token, static_cast<uint32_t>(payload_size),
+                                   exchange_timestamp, receive_ns};
+        std::memcpy(record, &header, sizeof(header));
+        write_payload(record + sizeof(header));
+
+        index_.note(token, exchange_timestamp, write_offset_, date_);
+        write_offset_ += record_size;
+        if (++pending_ >= COMMIT_BATCH) {
+            commit();
+        }
+    }
+
+    // Publishes everything appended so far to readers.
+    void commit() {
+        if (base_ == nullptr || pending_ == 0) {
+            return;
+        }
+        file_header()->record_count.fetch_add(pending_, std::memory_order_relaxed);
+        file_header()->data_end.store(write_offset_, std::memory_order_release);
+        records_written_.fetch_add(pending_, std::memory_order_relaxed);
+        pending_ = 0;
+    }
+
+    bool open_file(int32_t date) {
+        close_file();
+        mkdir(dir_.c_str(), 0755);
+        path_ = journal_path(dir_, date, ".tj");
+
+        fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd_ < 0) {
+            std::perror(("journal open " + path_).c_str());
+            return false;
+        }
+        struct stat st;
+        fstat(fd_, &st);
+        bool fresh = st.st_size < static_cast<off_t>(JOURNAL_HEADER_SIZE);
+        size_t initial = std::max<size_t>(chunk_bytes_, static_cast<size_t>(st.st_size));
+        base_ = map(initial);
+        if (base_ == nullptr) {
+            close_file();
+            return false;
+        }
+        mapped_size_ = initial;
+
+        JournalFileHeader* header = file_header();
+        if (fresh) {
+            std::memset(base_, 0, JOURNAL_HEADER_SIZE);
+            header->magic = JOURNAL_MAGIC;
+            header->version_major = JOURNAL_VERSION_MAJOR;
+            header->version_minor = JOURNAL_VERSION_MINOR;
+            header->header_size = JOURNAL_HEADER_SIZE;
+            header->date = date;
+            header->record_header_size = sizeof(JournalRecordHeader);
+            header->created_epoch_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+            header->data_end.store(JOURNAL_HEADER_SIZE, std::memory_order_release);
+        } else if (header->magic != JOURNAL_MAGIC || header->version_major != JOURNAL_VERSION_MAJOR) {
+            std::cerr << "Refusing to append to incompatible journal " << path_ << std::endl;
+            close_file();
+            return false;
+        }
+
+        // Restarting mid-day: continue after the last committed record and
+        // rebuild the index for what is already there.
+        write_offset_ = header->data_end.load(std::memory_order_acquire);
+        date_ = date;
+        index_.reset();
+        for (uint64_t offset = JOURNAL_HEADER_SIZE; offset < write_offset_;) {
+            const JournalRecordHeader* record = reinterpret_cast<const JournalRecordHeader*>(base_ + offset);
+            if (record->size < sizeof(JournalRecordHeader)) {
+                break;
+            }
+            index_.note(record->token, record->exchange_timestamp, offset, date_);
+            offset += record->size;
+        }
+        last_index_save_ns_ = steady_now_ns();
+        return true;
+    }
+
+    // Also releases a file whose open failed part way; date_ is only set
+    // once a file is fully open, and only then is it committed and trimmed.
+    void close_file() {
+        if (base_ != nullptr) {
+            if (date_ != 0) {
+                commit();
+                save_index();
+            }
+            munmap(base_, mapped_size_);
+            base_ = nullptr;
+            mapped_size_ = 0;
+            // Give back the unused part of the last pre-allocated chunk
+            if (date_ != 0 && ftruncate(fd_, static_cast<off_t>(write_offset_)) != 0) {
+                std::perror("journal truncate");
+            }
+        }
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+        date_ = 0;
+    }
+
+    void save_index() {
+        index_.covered_end = write_offset_;
+        if (!index_.save(journal_path(dir_, date_, ".tji"))) {
+            write_errors_.fetch_add(1, std::memory_order_relaxed);
+        }
+        last_index_save_ns_ = steady_now_ns();
+    }
+
+    // The blocks must really be allocated: a store into a hole of a sparse
+    // file on a full disk raises SIGBUS, so there is no ftruncate fallback.
+    char* map(size_t size) {
+        int error = posix_fallocate(fd_, 0, static_cast<off_t>(size));
+        if (error != 0) {
+            std::cerr << "journal allocate " << path_ << ": " << std::strerror(error) << std::endl;
+            return nullptr;
+        }
+        void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (base == MAP_FAILED) {
+            std::perror("journal mmap");
+            return nullptr;
+        }
+        return static_cast<char*>(base);
+    }
+
+    // On failure the current mapping stays as it was
+    bool grow(size_t needed) {
+        size_t size = mapped_size_;
+        while (size < needed) {
+            size += chunk_bytes_;
+        }
+        char* base = map(size);
+        if (base == nullptr) {
+            return false;
+        }
+        munmap(base_, mapped_size_);
+        base_ = base;
+        mapped_size_ = size;
+        return true;
+    }
+
+    JournalFileHeader* file_header() {
+        return reinterpret_cast<JournalFileHeader*>(base_);
+    }
+
+    std::string dir_;
+    size_t chunk_bytes_;
+    std::mutex mutex_;
+    std::string path_;
+    int fd_ = -1;
+    char* base_ = nullptr;
+    size_t mapped_size_ = 0;
+    uint64_t write_offset_ = 0;
+    int32_t date_ = 0;
+    size_t pending_ = 0;
+    JournalIndex index_;
+    int64_t last_index_save_ns_ = 0;
+    std::atomic<uint64_t> records_written_{0};
+    std::atomic<uint64_t> write_errors_{0};
+};
+
+// Read-only view of one day's journal.
+class TickJournalReader {
+public:
+    struct Record {
+        const JournalRecordHeader* header;
+        const char* payload;
+        uint64_t offset;
+    };
+
+    TickJournalReader() = default;
+    TickJournalReader(const TickJournalReader&) = delete;
+    TickJournalReader& operator=(const TickJournalReader&) = delete;
+
+    ~TickJournalReader() {
+        close();
+    }
+
+    bool open(const std::string& path, std::string& error) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            error = "cannot open " + path + ": " + std::strerror(errno);
+            return false;
+        }
+        struct stat st;
+        fstat(fd, &st);
+        if (st.st_size < static_cast<off_t>(JOURNAL_HEADER_SIZE)) {
+            error = path + " is not a journal";
+            ::close(fd);
+            return false;
+        }
+        void* base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (base == MAP_FAILED) {
+            error = "mmap failed: " + std::string(std::strerror(errno));
+            return false;
+        }
+        base_ = static_cast<const char*>(base);
+        mapped_size_ = st.st_size;
+
+        const JournalFileHeader* header = reinterpret_cast<const JournalFileHeader*>(base_);
+        if (header->magic != JOURNAL_MAGIC || header->version_major != JOURNAL_VERSION_MAJOR) {
+            error = path + " has an unsupported journal version";
+            close();
+            return false;
+        }
+        data_begin_ = header->header_size;
+        data_end_ = std::min<uint64_t>(header->data_end.load(std::memory_order_acquire), mapped_size_);
+        date_ = header->date;
+        cursor_ = data_begin_;
+
+        // Use the saved index if present and extend it over any unindexed tail.
+        std::string index_path = path.size() > 3 ? path.substr(0, path.size() - 3) + ".tji" : path + "i";
+        uint64_t from = index_.load(index_path) ? index_.covered_end : data_begin_;
+        if (from < data_begin_ || from > data_end_) {
+            index_.reset();
+            from = data_begin_;
+        }
+        for (uint64_t offset = from; offset < data_end_;) {
+            const JournalRecordHeader* record = reinterpret_cast<const JournalRecordHeader*>(base_ + offset);
+            if (record->size < sizeof(JournalRecordHeader) || offset + record->size > data_end_) {
+                break;
+            }
+            index_.note(record->token, record->exchange_timestamp, offset, date_);
+            offset += record->size;
+        }
+        std::stable_sort(index_.token_entries.begin(), index_.token_entries.end());
+        return true;
+    }
+
+    void close() {
+        if (base_ != nullptr) {
+            munmap(const_cast<char*>(base_), mapped_size_);
+            base_ = nullptr;
+        }
+    }
+
+    bool next(Record& record) {
+        if (cursor_ + sizeof(JournalRecordHeader) > data_end_) {
+            return false;
+        }
+        const JournalRecordHeader* header = reinterpret_cast<const JournalRecordHeader*>(base_ + cursor_);
+        if (header->size < sizeof(JournalRecordHeader) || cursor_ + header->size > data_end_) {
+            return false;
+        }
+        record.header = header;
+        record.payload = base_ + cursor_ + sizeof(JournalRecordHeader);
+        record.offset = cursor_;
+        cursor_ += header->size;
+        return true;
+    }
+
+    void rewind() { cursor_ = data_begin_; }
+
+    // Positions the cursor at the first record stamped at or after the given
+    // IST minute of the day. Returns false if nothing that late was recorded.
+    bool seek_minute(int32_t minute) {
+        for (int32_t m = std::max(minute, 0); m < JOURNAL_MINUTES_PER_DAY; ++m) {
+            if (index_.minute_offsets[m] != JOURNAL_NO_OFFSET) {
+                cursor_ = index_.minute_offsets[m];
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Positions the cursor at the first record for `token` at or after the
+    // given minute. Records for other tokens follow; callers filter.
+    bool seek_token(uint32_t token, int32_t minute) {
+        JournalTokenIndexEntry key{token, static_cast<uint16_t>(std::max(minute, 0)), 0, 0};
+        auto it = std::lower_bound(index_.token_entries.begin(), index_.token_entries.end(), key);
+        if (it == index_.token_entries.end() || it->token != token) {
+            return false;
+        }
+        cursor_ = it->offset;
+        return true;
+    }
+
+    int32_t date() const { return date_; }
+    uint64_t data_end() const { return data_end_; }
+
+private:
+    const char* base_ = nullptr;
+    size_t mapped_size_ = 0;
+    uint64_t data_begin_ = JOURNAL_HEADER_SIZE;
+    uint64_t data_end_ = JOURNAL_HEADER_SIZE;
+    uint64_t cursor_ = JOURNAL_HEADER_SIZE;
+    int32_t date_ = 0;
+    JournalIndex index_;
+};
@@ -0,0 +1,195 @@
+#pragma once
+
+// Bounded lock-free ring of fixed-size records.
+//
+// This is the classic sequence-per-cell array queue: producers and consumers
+// each claim positions with one CAS on their own cache-line-padded cursor, and
+// a cell's sequence number tells whether it is free, full or being recycled.
+// It is safe for any number of producers and consumers, so the same type
+// serves the single asio thread today and sharded feeds later.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TICK_RING_PAUSE() _mm_pause()
+#else
+#define TICK_RING_PAUSE() std::this_thread::yield()
+#endif
+
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+// What push() does when the ring is full.
+enum class OverflowPolicy {
+    BLOCK,        // Spin until a consumer frees a cell
+    DROP_OLDEST,  // Evict the oldest unread record to make room
+    DROP_NEWEST   // Discard the record being pushed and count it
+};
+
+inline OverflowPolicy parse_overflow_policy(const std::string& text) {
+    if (text == "block") {
+        return OverflowPolicy::BLOCK;
+    }
+    if (text == "drop_newest" || text == "count_and_drop") {
+        return OverflowPolicy::DROP_NEWEST;
+    }
+    return OverflowPolicy::DROP_OLDEST;
+}
+
+inline const char* overflow_policy_name(OverflowPolicy policy) {
+    switch (policy) {
+        case OverflowPolicy::BLOCK: return "block";
+        case OverflowPolicy::DROP_NEWEST: return "drop_newest";
+        default: return "drop_oldest";
+    }
+}
+
+template <typename T>
+class BoundedRing {
+    static_assert(std::is_trivially_copyable<T>::value, "ring records are copied with plain stores");
+
+public:
+    explicit BoundedRing(size_t capacity, OverflowPolicy policy = OverflowPolicy::DROP_OLDEST)
+        : cells_(round_up_pow2(capacity)), mask_(cells_.size() - 1), policy_(policy) {
+        for (size_t i = 0; i < cells_.size(); ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedRing(const BoundedRing&) = delete;
+    BoundedRing& operator=(const BoundedRing&) = delete;
+
+    // Returns false only when the record was discarded (DROP_NEWEST).
+    bool push(const T& value) {
+        while (!try_push(value)) {
+            switch (policy_) {
+                case OverflowPolicy::DROP_NEWEST:
+                    dropped_.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                case OverflowPolicy::DROP_OLDEST: {
+                    T evicted;
+                    if (try_pop(evicted)) {
+                        dropped_.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    break;
+                }
+                case OverflowPolicy::BLOCK:
+                    blocked_.fetch_add(1, std::memory_order_relaxed);
+                    TICK_RING_PAUSE();
+                    break;
+            }
+        }
+        return true;
+    }
+
+    bool try_push(const T& value) {
+        size_t pos = enqueue_pos_.value.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells_[pos & mask_];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos_.value.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueue_pos_.value.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = value;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(T& value) {
+        return pop_batch(&value, 1) == 1;
+    }
+
+    // Claims up to `max_count` consecutive ready records with a single CAS and
+    // copies them to `out`. Returns the number of records taken.
+    size_t pop_batch(T* out, size_t max_count) {
+        size_t pos = dequeue_pos_.value.load(std::memory_order_relaxed);
+        size_t count;
+        while (true) {
+            count = 0;
+            while (count < max_count) {
+                const Cell& cell = cells_[(pos + count) & mask_];
+                size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                if (static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + count + 1) != 0) {
+                    break;
+                }
+                ++count;
+            }
+            if (count == 0) {
+                size_t current = dequeue_pos_.value.load(std::memory_order_relaxed);
+                if (current == pos) {
+                    return 0;
+                }
+                pos = current;
+                continue;
+            }
+            if (dequeue_pos_.value.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            Cell& cell = cells_[(pos + i) & mask_];
+            out[i] = cell.data;
+            cell.sequence.store(pos + i + mask_ + 1, std::memory_order_release);
+        }
+        return count;
+    }
+
+    size_t capacity() const { return mask_ + 1; }
+    OverflowPolicy policy() const { return policy_; }
+
+    // Approximate number of unread records; exact when producers are idle.
+    size_t occupancy() const {
+        size_t head = dequeue_pos_.value.load(std::memory_order_relaxed);
+        size_t tail = enqueue_pos_.value.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+
+    // Records accepted so far; the enqueue cursor doubles as the counter.
+    uint64_t pushed() const { return enqueue_pos_.value.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+    uint64_t blocked_spins() const { return blocked_.load(std::memory_order_relaxed); }
+
+private:
+    struct alignas(CACHE_LINE_SIZE) Cell {
+        std::atomic<size_t> sequence{0};
+        T data;
+    };
+
+    static size_t round_up_pow2(size_t capacity) {
+        size_t rounded = 2;
+        while (rounded < capacity) {
+            rounded <<= 1;
+        }
+        return rounded;
+    }
+
+    struct alignas(CACHE_LINE_SIZE) PaddedCursor {
+        std::atomic<size_t> value{0};
+    };
+
+    PaddedCursor enqueue_pos_;
+    PaddedCursor dequeue_pos_;
+    std::vector<Cell> cells_;
+    size_t mask_;
+    OverflowPolicy policy_;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> blocked_{0};
+};
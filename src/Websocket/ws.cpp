@@ -18,17 +18,39 @@
 #include <unordered_map>
 #include <queue>
 #include <mutex>
+#include <atomic>
+#include <cmath>
+#include <csignal>
+#include <algorithm>
+#include "smartstream.hpp"
+#include "instrument_table.hpp"
+#include "tick_dispatcher.hpp"
+#include "shm_bus.hpp"
+#include "kafka_sink.hpp"
+#include "tick_journal.hpp"
+#include "latency_histogram.hpp"
+#include "event_log.hpp"
+#include "stage_latency.hpp"
+#include "metrics.hpp"
+#include "reconnect_policy.hpp"
+#include "snapshot_recovery.hpp"
+#include "strike_window.hpp"
+#include "bar_engine.hpp"
+#include "greeks_engine.hpp"
+#include "option_chain.hpp"
+#include "subscription_manager.hpp"
+#include "../Auth/TokenManager.hpp"
 
 using json = nlohmann::json;
 namespace fs = std::filesystem;
 
 typedef websocketpp::client<websocketpp::config::asio_tls_client> tls_client;
 
-// Global map for token to symbol mapping
-std::unordered_map<std::string, std::string> token_to_symbol_map;
+// Global instrument table keyed by numeric token
+InstrumentTable instrument_table;
 
-// Function to load CSV data into the global map
-void load_csv_data(const std::string& filename) {
+// Function to load CSV data into the global instrument table
+void load_csv_data(const std::string& filename, uint8_t exchange_type) {
     std::ifstream file(filename);
     std::string line;
 
@@ -66,23 +88,134 @@ void load_csv_data(const std::string& filename) {
         lotsize = extract_field(ss);
         instrumenttype = extract_field(ss);
 
-        token_to_symbol_map[token] = symbol;  // Add the token-symbol pair to the map
+        instrument_table.add(token, symbol, name, expiry, strike, lotsize, exchange_type);
     }
 }
 
-// Pre-process CSV data into the global map
+// Pre-process CSV data into the global instrument table
 void preprocess_csv_data() {
-    load_csv_data("SocketTokens/AMXIDX_Tokens.csv");
-    load_csv_data("SocketTokens/Tokens.csv");
+    load_csv_data("SocketTokens/AMXIDX_Tokens.csv", BSE_CM);
+    load_csv_data("SocketTokens/Tokens.csv", BSE_FO);
+    instrument_table.build_index();
+
+    std::cout << "Instrument table: " << instrument_table.size() << " instruments, "
+              << instrument_table.index_slots() << " index slots, "
+              << instrument_table.memory_bytes() << " bytes" << std::endl;
 }
 
-class WebSocketClient {
+// Decode and dispatch step shared by the live socket and session replay.
+// process() is called from one thread at a time, which is the only writer of
+// its counters; any thread may read them.
+class FrameProcessor {
 public:
-    WebSocketClient(const std::string& auth_token, const std::string& api_key, const std::string& client_code, const std::string& feed_token)
-        : auth_token_(auth_token), api_key_(api_key), client_code_(client_code), feed_token_(feed_token), first_message_received_(false) {
+    // SmartStream exchange types are small integers; slot 0 collects the rest
+    static constexpr size_t EXCHANGE_TYPE_SLOTS = 32;
+
+    // Optional per-stage timing, switched on by replay runs
+    struct StageTimes {
+        uint64_t decode_ns = 0;
+        uint64_t publish_ns = 0;
+        uint64_t frames = 0;
+    };
+
+    explicit FrameProcessor(TickDispatcher& dispatcher)
+        : dispatcher_(dispatcher), token_ticks_(new LocalCounter[instrument_table.size()]) {}
+
+    // Returns the frame's token, or 0 if the frame was not published
+    uint32_t process(const char* data, size_t size, int64_t receive_ns) {
+        // Counted before decoding so malformed frames show up in the rates too
+        size_t slot = size >= 2 ? exchange_type_slot(static_cast<uint8_t>(data[1])) : 0;
+        messages_[slot].add();
+        bytes_[slot].add(size);
+
+        Tick tick;
+        if (!decode_tick(data, size, tick)) {
+            decode_errors_.add();
+            return 0;
+        }
+        tick.receive_ns = receive_ns;
+        tick.decoded_ns = steady_now_ns();
+        ticks_decoded_.add();
+
+        int32_t instrument_index = instrument_table.index_of(tick.token);
+        if (instrument_index == InstrumentTable::NOT_FOUND) {
+            unknown_tokens_.add();
+            return 0;
+        }
+        token_ticks_[instrument_index].add();
+        track_sequence(tick, instrument_index);
+
+        if (stage_times_ != nullptr) {
+            dispatcher_.publish(tick, instrument_index);
+            stage_times_->decode_ns += tick.decoded_ns - receive_ns;
+            stage_times_->publish_ns += steady_now_ns() - tick.decoded_ns;
+            ++stage_times_->frames;
+        } else {
+            dispatcher_.publish(tick, instrument_index);
+        }
+        return tick.token;
     }
 
-    void connect() {
+    void enable_stage_times(StageTimes* stage_times) { stage_times_ = stage_times; }
+
+    // Gaps are handed to recovery; max_sequence_jump 0 counts only sequence
+    // numbers that go backwards, as SmartStream does not number each token's
+    // packets contiguously
+    void set_recovery(SnapshotRecovery* recovery, int64_t max_sequence_jump) {
+        recovery_ = recovery;
+        max_sequence_jump_ = max_sequence_jump;
+    }
+
+    TickDispatcher& dispatcher() { return dispatcher_; }
+    uint64_t ticks_decoded() const { return ticks_decoded_.load(); }
+    uint64_t decode_errors() const { return decode_errors_.load(); }
+    uint64_t unknown_tokens() const { return unknown_tokens_.load(); }
+    uint64_t sequence_gaps() const { return sequence_gaps_.load(); }
+
+    // Binary frames and their bytes by exchange type slot
+    uint64_t messages(size_t slot) const { return messages_[slot].load(); }
+    uint64_t bytes(size_t slot) const { return bytes_[slot].load(); }
+
+    // Published ticks for one instrument table index
+    uint64_t token_ticks(int32_t instrument_index) const { return token_ticks_[instrument_index].load(); }
+
+    static size_t exchange_type_slot(uint8_t exchange_type) {
+        return exchange_type < EXCHANGE_TYPE_SLOTS ? exchange_type : 0;
+    }
+
+private:
+    TickDispatcher& dispatcher_;
+    StageTimes* stage_times_ = nullptr;
+    SnapshotRecovery* recovery_ = nullptr;
+    int64_t max_sequence_jump_ = 0;
+    LocalCounter ticks_decoded_;
+    LocalCounter decode_errors_;
+    LocalCounter unknown_tokens_;
+    LocalCounter sequence_gaps_;
+    LocalCounter messages_[EXCHANGE_TYPE_SLOTS];
+    LocalCounter bytes_[EXCHANGE_TYPE_SLOTS];
+    std::unique_ptr<LocalCounter[]> token_ticks_;
+
+    // Only this processor's network thread writes the token's feed state
+    void track_sequence(const Tick& tick, int32_t instrument_index) {
+        InstrumentFeedState& feed = instrument_table.feed_state(instrument_index);
+        int64_t last = feed.sequence.load(std::memory_order_relaxed);
+        if (last != 0 && (tick.sequence < last || (max_sequence_jump_ > 0 && tick.sequence - last > max_sequence_jump_))) {
+            sequence_gaps_.add();
+            if (recovery_ != nullptr) {
+                recovery_->request(tick.exchange_type, tick.token, "sequence gap");
+            }
+        }
+        feed.sequence.store(tick.sequence, std::memory_order_relaxed);
+        feed.exchange_timestamp.store(tick.exchange_timestamp, std::memory_order_relaxed);
+    }
+};
+
+class WebSocketClient {
+public:
+    WebSocketClient(const std::string& endpoint, const std::string& auth_token, const std::string& api_key, const std::string& client_code, const std::string& feed_token, FrameProcessor& frame_processor, EventLog& event_log, SubscriptionManager& subscriptions, const ConnectionSettings& connection_settings)
+        : endpoint_(endpoint), auth_token_(auth_token), api_key_(api_key), client_code_(client_code), feed_token_(feed_token), first_message_received_(false), frame_processor_(frame_processor), event_log_(event_log), subscriptions_(subscriptions),
+          connection_settings_(connection_settings), backoff_(connection_settings) {
         ws_client_.init_asio();
 
         ws_client_.set_tls_init_handler([this](websocketpp::connection_hdl) {
@@ -97,207 +230,349 @@ public:
         ws_client_.set_open_handler(std::bind(&WebSocketClient::on_open, this, std::placeholders::_1));
         ws_client_.set_message_handler(std::bind(&WebSocketClient::on_message, this, std::placeholders::_1, std::placeholders::_2));
         ws_client_.set_close_handler(std::bind(&WebSocketClient::on_close, this, std::placeholders::_1));
-        ws_client_.set_fail_handler(std::bind(&WebSocketClient::on_error, this, std::placeholders::_1));
+        ws_client_.set_fail_handler(std::bind(&WebSocketClient::on_fail, this, std::placeholders::_1));
         ws_client_.set_pong_handler(std::bind(&WebSocketClient::on_pong, this, std::placeholders::_1, std::placeholders::_2));
 
-        websocketpp::lib::error_code ec;
-        tls_client::connection_ptr con = ws_client_.get_connection("wss://smartapisocket.angelone.in/smart-stream", ec);
+        reconnect_timer_.reset(new websocketpp::lib::asio::steady_timer(ws_client_.get_io_service()));
+        heartbeat_timer_.reset(new websocketpp::lib::asio::steady_timer(ws_client_.get_io_service()));
+    }
 
-        if (ec) {
-            std::cout << "Could not create connection because: " << ec.message() << std::endl;
-            return;
-        }
+    // Runs the client on the calling thread, which becomes its only network
+    // thread: connects, then reconnects on the backoff timer after every drop.
+    // Does not return.
+    void connect() {
+        pin_network_thread();
+        ws_client_.start_perpetual();
+        open_connection();
+        ws_client_.run();
+    }
 
-        // Set headers
-        con->replace_header("Authorization", auth_token_);
-        con->replace_header("x-api-key", api_key_);
-        con->replace_header("x-client-code", client_code_);
-        con->replace_header("x-feed-token", feed_token_);
+    // Reconnects are marked in the stage latency report
+    void set_stage_latency(StageLatencySink* stage_latency) { stage_latency_ = stage_latency; }
 
-        connection_hdl_ = con->get_handle();
-        ws_client_.connect(con);
+    // Ticks missed while the connection was down are fetched over REST
+    void set_snapshot_recovery(SnapshotRecovery* snapshot_recovery) { snapshot_recovery_ = snapshot_recovery; }
 
-        // Log that connection was made
-        log_event("Sent connection message");
+    // This client's share of a sharded feed: it loads and subscribes only the
+    // tokens that hash to its shard. cpu >= 0 pins its network thread.
+    void set_shard(int shard, size_t shard_count, int cpu) {
+        shard_ = shard;
+        shard_count_ = std::max<size_t>(shard_count, 1);
+        cpu_ = cpu;
+    }
 
-        std::thread asio_thread([&]() {
-            ws_client_.run();
-        });
+    int shard() const { return shard_; }
+
+    // Connection state for the metrics endpoint; safe to read from any thread
+    bool connected() const { return connected_.load(std::memory_order_relaxed); }
+    ConnectionState state() const { return state_.load(std::memory_order_relaxed); }
+    uint64_t reconnects() const { return reconnects_.load(std::memory_order_relaxed); }
+    int retry_attempt() const { return retry_attempt_.load(std::memory_order_relaxed); }
+    int64_t last_ping_rtt_ns() const { return last_ping_rtt_ns_.load(std::memory_order_relaxed); }
+    LatencyHistogram::Snapshot ping_rtt() const { return ping_rtt_.snapshot(); }
+    int64_t last_recovery_ns() const { return last_recovery_ns_.load(std::memory_order_relaxed); }
+    LatencyHistogram::Snapshot recovery() const { return recovery_.snapshot(); }
+    const SubscriptionManager& subscriptions() const { return subscriptions_; }
+
+    // Starting universe: AMXIDX_Tokens.csv on BSE_CM and Tokens.csv on BSE_FO,
+    // the tokens of this shard only
+    void load_universe(int mode) {
+        subscriptions_.replace(mode, BSE_CM, shard_tokens(filter_tokens_from_csv("SocketTokens/AMXIDX_Tokens.csv")));
+        subscriptions_.replace(mode, BSE_FO, shard_tokens(filter_tokens_from_csv("SocketTokens/Tokens.csv")));
+    }
 
-        std::thread heartbeat_thread([&]() {
-            while (true) {
-                std::this_thread::sleep_for(std::chrono::seconds(30));
-                send_ping();
-            }
-        });
+    // Runtime changes to the universe; only the difference is sent
+    void subscribe(int mode, int exchange_type, const std::vector<std::string>& tokens) {
+        subscriptions_.add(mode, exchange_type, tokens);
+        flush_subscriptions();
+    }
 
-        asio_thread.join();
-        heartbeat_thread.join();
+    void unsubscribe(int mode, int exchange_type, const std::vector<std::string>& tokens) {
+        subscriptions_.remove(mode, exchange_type, tokens);
+        flush_subscriptions();
     }
 
-    void send_request() {
-        // First send AMXIDX_Tokens.csv tokens with exchangeType 3
-        std::vector<std::string> amxidx_tokens = filter_tokens_from_csv("SocketTokens/AMXIDX_Tokens.csv");
-        send_tokens_to_server(amxidx_tokens, 3);  // exchangeType 1 for AMXIDX_Tokens.csv
-        log_event("tokens sent to server: AMXIDX_Tokens.csv");
+    // Sends whatever the desired subscriptions differ by from this
+    // connection's. Safe from any thread: the send runs on the network
+    // thread, and is a no-op while disconnected since on_open replays them.
+    void flush_subscriptions() {
+        websocketpp::lib::asio::post(ws_client_.get_io_service(), [this]() { send_subscriptions(); });
+    }
 
-        // Then send Tokens.csv tokens with exchangeType 4
-        std::vector<std::string> tokens = filter_tokens_from_csv("SocketTokens/Tokens.csv");
-        send_tokens_to_server(tokens, 4);  // exchangeType 2 for Tokens.csv
-        log_event("tokens sent to server: Tokens.csv");
+    // Renewed session tokens for the next connection attempt; an open
+    // connection keeps the ones it was accepted with. Safe from any thread.
+    void set_tokens(const std::string& auth_token, const std::string& feed_token) {
+        websocketpp::lib::asio::post(ws_client_.get_io_service(), [this, auth_token, feed_token]() {
+            auth_token_ = auth_token;
+            feed_token_ = feed_token;
+        });
     }
 
 private:
     tls_client ws_client_;
     websocketpp::connection_hdl connection_hdl_;  // Store the connection handle
+    std::string endpoint_;
     std::string auth_token_;
     std::string api_key_;
     std::string client_code_;
     std::string feed_token_;
-    std::ofstream json_log_file_;
     bool first_message_received_;
     std::chrono::steady_clock::time_point first_message_time_;
     std::chrono::steady_clock::time_point last_logged_message_time_;
+    FrameProcessor& frame_processor_;
+    EventLog& event_log_;
+    SubscriptionManager& subscriptions_;
+    StageLatencySink* stage_latency_ = nullptr;
+    SnapshotRecovery* snapshot_recovery_ = nullptr;
+    int shard_ = 0;
+    size_t shard_count_ = 1;
+    int cpu_ = -1;
+
+    // Connection state machine; see reconnect_policy.hpp. Everything but the
+    // atomics is only touched on the network thread.
+    const ConnectionSettings connection_settings_;
+    ReconnectBackoff backoff_;
+    std::unique_ptr<websocketpp::lib::asio::steady_timer> reconnect_timer_;
+    std::unique_ptr<websocketpp::lib::asio::steady_timer> heartbeat_timer_;
+    int64_t down_since_ns_ = 0;  // Start of the current outage, 0 while healthy
+    int64_t ping_sent_ns_ = 0;   // Unanswered ping, 0 if none
+    std::atomic<ConnectionState> state_{ConnectionState::DISCONNECTED};
+    std::atomic<bool> connected_{false};
+    std::atomic<uint64_t> reconnects_{0};
+    std::atomic<int> retry_attempt_{0};
+    std::atomic<int64_t> last_ping_rtt_ns_{-1};
+    std::atomic<int64_t> last_recovery_ns_{-1};
+    LatencyHistogram ping_rtt_;
+    LatencyHistogram recovery_;  // Drop to reopened, per outage
+
+    void open_connection() {
+        state_ = ConnectionState::CONNECTING;
+        websocketpp::lib::error_code ec;
+        tls_client::connection_ptr con = ws_client_.get_connection(endpoint_, ec);
+        if (ec) {
+            log_event("Shard {} could not create connection: {}", shard_, ec.message());
+            connection_lost("connection setup failed");
+            return;
+        }
 
-    std::queue<std::string> log_queue_;
-    std::mutex log_mutex_;
-    std::thread log_thread_;
-    bool stop_logging_ = false;
-
-    const int MAX_RETRY_ATTEMPT = 5;
-    const int RETRY_DELAY = 10;
-    const int RETRY_MULTIPLIER = 2;
-    int current_retry_attempt = 0;
-    bool retry_in_progress = false;
+        // Set headers
+        con->replace_header("Authorization", auth_token_);
+        con->replace_header("x-api-key", api_key_);
+        con->replace_header("x-client-code", client_code_);
+        con->replace_header("x-feed-token", feed_token_);
 
-    struct SubscriptionData {
-        int mode;
-        std::vector<std::pair<int, std::vector<std::string>>> token_list;
-    };
-    
-    std::map<std::string, SubscriptionData> subscription_state;
+        connection_hdl_ = con->get_handle();
+        ws_client_.connect(con);
+        log_event("Shard {} sent connection request", shard_);
+    }
 
-    const int HEARTBEAT_INTERVAL = 10;
-    std::atomic<bool> heartbeat_active{false};
-    std::thread heartbeat_thread;
+    // Callbacks from a connection already given up on are ignored
+    bool is_current(const websocketpp::connection_hdl& hdl) const {
+        return !hdl.owner_before(connection_hdl_) && !connection_hdl_.owner_before(hdl);
+    }
 
     void on_open(websocketpp::connection_hdl hdl) {
-        std::cout << "Connection opened." << std::endl;
-        connection_hdl_ = hdl;
-
-        // Create the "logs" folder and open the controller.json file
-        std::filesystem::path log_dir = "logs";
-        if (!std::filesystem::exists(log_dir)) {
-            std::filesystem::create_directory(log_dir);
+        if (!is_current(hdl)) {
+            return;
         }
-
-        json_log_file_.open("logs/controller.json", std::ios::out | std::ios::app);
-        if (!json_log_file_.is_open()) {
-            std::cerr << "Error opening controller.json for logging" << std::endl;
+        std::cout << "Shard " << shard_ << ": connection opened." << std::endl;
+        state_ = ConnectionState::OPEN;
+        connected_ = true;
+
+        if (down_since_ns_ != 0) {
+            int64_t recovery_ns = steady_now_ns() - down_since_ns_;
+            recovery_.record(recovery_ns);
+            last_recovery_ns_.store(recovery_ns, std::memory_order_relaxed);
+            log_event("Shard {} recovered in {} ms after {} attempts", shard_, recovery_ns / 1000000, backoff_.attempt());
+            if (stage_latency_ != nullptr) {
+                stage_latency_->mark("shard " + std::to_string(shard_) + " reconnected after " + std::to_string(recovery_ns / 1000000) + " ms");
+            }
+            down_since_ns_ = 0;
+            recover_missed_ticks();
         }
+        backoff_.reset();
+        retry_attempt_ = 0;
 
-        send_request();  // Send the request when the connection is opened
+        // A new connection has no subscriptions; replay the desired set
+        subscriptions_.reset();
+        send_subscriptions();
 
-        // Start the logging thread
-        log_thread_ = std::thread(&WebSocketClient::log_worker, this);
+        ping_sent_ns_ = 0;
+        arm_heartbeat(connection_settings_.heartbeat_interval_ms);
+    }
 
-        current_retry_attempt = 0;  // Reset retry counter on successful connection
-        
-        if (!subscription_state.empty()) {
-            resubscribe();
+    // Everything subscribed before the drop may have missed ticks. The new
+    // session numbers its packets afresh, so sequence tracking restarts too.
+    void recover_missed_ticks() {
+        std::vector<std::pair<uint8_t, uint32_t>> tokens = subscriptions_.acknowledged_tokens();
+        for (const auto& entry : tokens) {
+            int32_t instrument_index = instrument_table.index_of(entry.second);
+            if (instrument_index != InstrumentTable::NOT_FOUND) {
+                instrument_table.feed_state(instrument_index).sequence.store(0, std::memory_order_relaxed);
+            }
+        }
+        if (snapshot_recovery_ != nullptr) {
+            snapshot_recovery_->request(tokens, "reconnect");
         }
-        
-        // Start heartbeat monitoring
-        start_heartbeat_monitor();
     }
 
     void on_message(websocketpp::connection_hdl hdl, tls_client::message_ptr msg) {
-        // No action needed here since we are not saving raw data
-    }
-
-    void on_close(websocketpp::connection_hdl hdl) {
-        std::cout << "Connection closed." << std::endl;
-        if (json_log_file_.is_open()) {
-            json_log_file_.close();
+        // Text frames only carry heartbeat replies and subscription errors
+        if (msg->get_opcode() != websocketpp::frame::opcode::binary) {
+            on_text_message(msg->get_payload());
+            return;
         }
 
-        // Signal the logging thread to stop
-        {
-            std::lock_guard<std::mutex> lock(log_mutex_);
-            stop_logging_ = true;
-        }
-        log_thread_.join();
+        const std::string& payload = msg->get_payload();
+        uint32_t token = frame_processor_.process(payload.data(), payload.size(), steady_now_ns());
 
-        stop_heartbeat_monitor();
+        if (token != 0 && !first_message_received_) {
+            first_message_received_ = true;
+            first_message_time_ = std::chrono::steady_clock::now();
+            log_event("First tick received for token {}", token);
+        }
     }
 
-    void on_error(websocketpp::connection_hdl hdl) {
-        if (!retry_in_progress) {
-            retry_in_progress = true;
-            handle_reconnection();
-            retry_in_progress = false;
+    void on_text_message(const std::string& payload) {
+        json message = json::parse(payload, nullptr, false);
+        if (!message.is_object() || !message.contains("errorCode")) {
+            return;
         }
+        std::string correlation_id = message.value("correlationID", "");
+        size_t rejected = subscriptions_.reject(correlation_id);
+        log_event("Stream error {} for request {} ({} tokens dropped): {}", message.value("errorCode", ""), correlation_id,
+                  rejected, message.value("errorMessage", ""));
     }
 
-    void on_pong(websocketpp::connection_hdl hdl, std::string payload) {
-        std::cout << "Received pong: " << payload << std::endl;
-        log_event("Heartbeat received.");
+    void on_close(websocketpp::connection_hdl hdl) {
+        if (!is_current(hdl)) {
+            return;
+        }
+        std::cout << "Shard " << shard_ << ": connection closed." << std::endl;
+        log_event("Shard {} closed. Ticks decoded: {}, decode errors: {}, unknown tokens: {}, ring occupancy: {}, ring drops: {}",
+                  shard_, frame_processor_.ticks_decoded(), frame_processor_.decode_errors(), frame_processor_.unknown_tokens(),
+                  frame_processor_.dispatcher().occupancy(), frame_processor_.dispatcher().dropped());
+        connection_lost("connection closed");
     }
 
-    void send_ping() {
-        websocketpp::lib::error_code ec;
-        ws_client_.ping(connection_hdl_, "ping", ec);
-        if (ec) {
-            std::cout << "Ping error: " << ec.message() << std::endl;
-        } else {
-            log_event("Heartbeat sent.");
-            std::cout << "Ping sent." << std::endl;
+    void on_fail(websocketpp::connection_hdl hdl) {
+        if (!is_current(hdl)) {
+            return;
         }
+        websocketpp::lib::error_code ec;
+        tls_client::connection_ptr con = ws_client_.get_con_from_hdl(hdl, ec);
+        log_event("Shard {} connection failed: {}", shard_, con ? con->get_ec().message() : ec.message());
+        connection_lost("connection failed");
     }
 
-    void send_tokens_to_server(const std::vector<std::string>& tokens, int exchange_type) {
-        const size_t chunk_size = 100;
+    // Forgets the current connection and retries on the backoff timer. The
+    // first failure of an outage starts its recovery clock.
+    void connection_lost(const char* reason) {
+        connected_ = false;
+        heartbeat_timer_->cancel();
+        connection_hdl_.reset();
+        if (down_since_ns_ == 0) {
+            down_since_ns_ = steady_now_ns();
+        }
 
-        for (size_t i = 0; i < tokens.size(); i += chunk_size) {
-            size_t end = std::min(i + chunk_size, tokens.size());
-            std::vector<std::string> chunk(tokens.begin() + i, tokens.begin() + end);
+        int delay_ms = backoff_.next_delay_ms();
+        retry_attempt_ = backoff_.attempt();
+        reconnects_.fetch_add(1, std::memory_order_relaxed);
+        state_ = ConnectionState::BACKOFF;
+        log_event("Shard {} {}; reconnect attempt {} in {} ms", shard_, reason, backoff_.attempt(), delay_ms);
+        if (stage_latency_ != nullptr) {
+            stage_latency_->mark("shard " + std::to_string(shard_) + " reconnect attempt " + std::to_string(backoff_.attempt()));
+        }
 
-            std::string unique_tokens = "";
-            for (size_t j = 0; j < chunk.size(); ++j) {
-                unique_tokens += "\"" + chunk[j] + "\"";
-                if (j < chunk.size() - 1) {
-                    unique_tokens += ", ";
-                }
+        reconnect_timer_->expires_after(std::chrono::milliseconds(delay_ms));
+        reconnect_timer_->async_wait([this](const websocketpp::lib::asio::error_code& ec) {
+            if (!ec) {
+                open_connection();
             }
+        });
+    }
 
-            std::string request = R"({
-                "correlationID": "abcde12345",
-                "action": 1,
-                "params": {
-                    "mode": 3,
-                    "tokenList": [
-                        {
-                            "exchangeType": )" + std::to_string(exchange_type) + R"(,
-                            "tokens": [)" + unique_tokens + R"(]
-                        }
-                    ]
-                }
-            })";
-
-            // Log the number of tokens in the chunk and the request format
-            std::string log_message = "Number of tokens sent to server with exchangeType " + std::to_string(exchange_type) + ": " + std::to_string(chunk.size());
-            log_event(log_message);
+    // Closes a connection that is open but unusable and reconnects without
+    // waiting for the close handshake
+    void drop_connection(const char* reason) {
+        websocketpp::lib::error_code ec;
+        ws_client_.close(connection_hdl_, websocketpp::close::status::going_away, reason, ec);
+        connection_lost(reason);
+    }
 
+    void send_subscriptions() {
+        if (state_.load() != ConnectionState::OPEN) {
+            return;
+        }
+        for (const SubscriptionRequest& request : subscriptions_.take_requests()) {
             websocketpp::lib::error_code ec;
-            ws_client_.send(connection_hdl_, request, websocketpp::frame::opcode::text, ec);
+            ws_client_.send(connection_hdl_, request.to_json(), websocketpp::frame::opcode::text, ec);
             if (ec) {
-                std::cout << "Send request error: " << ec.message() << std::endl;
+                subscriptions_.send_failed(request);
+                log_event("{} request {} failed: {}", request.action == SUBSCRIBE_ACTION ? "Subscribe" : "Unsubscribe",
+                          request.correlation_id, ec.message());
             } else {
-                std::cout << "Request sent." << std::endl;
+                log_event("{} request {}: {} tokens in mode {}", request.action == SUBSCRIBE_ACTION ? "Subscribe" : "Unsubscribe",
+                          request.correlation_id, request.token_count(), request.mode);
             }
         }
     }
 
+    // One timer serves the heartbeat: it fires every heartbeat interval to
+    // send a ping, and while the ping is unanswered it fires at the pong
+    // deadline instead
+    void arm_heartbeat(int delay_ms) {
+        heartbeat_timer_->expires_after(std::chrono::milliseconds(std::max(0, delay_ms)));
+        heartbeat_timer_->async_wait([this](const websocketpp::lib::asio::error_code& ec) {
+            // A handler already queued when the timer was re-armed is stale
+            if (!ec && heartbeat_timer_->expiry() <= std::chrono::steady_clock::now()) {
+                on_heartbeat_timer();
+            }
+        });
+    }
+
+    void on_heartbeat_timer() {
+        if (state_.load() != ConnectionState::OPEN) {
+            return;
+        }
+        if (ping_sent_ns_ != 0) {
+            log_event("Shard {} heartbeat unanswered for {} ms", shard_, (steady_now_ns() - ping_sent_ns_) / 1000000);
+            drop_connection("pong timeout");
+            return;
+        }
+
+        // Pings carry their steady-clock send time, which the pong echoes back
+        websocketpp::lib::error_code ec;
+        ping_sent_ns_ = steady_now_ns();
+        ws_client_.ping(connection_hdl_, std::to_string(ping_sent_ns_), ec);
+        if (ec) {
+            log_event("Shard {} heartbeat failed: {}", shard_, ec.message());
+            drop_connection("ping failed");
+            return;
+        }
+        arm_heartbeat(connection_settings_.pong_timeout_ms);
+    }
+
+    void on_pong(websocketpp::connection_hdl hdl, std::string payload) {
+        if (!is_current(hdl)) {
+            return;
+        }
+        char* end = nullptr;
+        long long sent_ns = std::strtoll(payload.c_str(), &end, 10);
+        if (end == payload.c_str() || *end != '\0' || sent_ns != ping_sent_ns_ || ping_sent_ns_ == 0) {
+            log_event("Shard {} ignored unexpected pong", shard_);
+            return;
+        }
+        int64_t rtt_ns = steady_now_ns() - sent_ns;
+        ping_rtt_.record(rtt_ns);
+        last_ping_rtt_ns_.store(rtt_ns, std::memory_order_relaxed);
+        log_event("Heartbeat received, round trip {} us", rtt_ns / 1000);
+
+        // Next ping one interval after the last was sent
+        ping_sent_ns_ = 0;
+        arm_heartbeat(connection_settings_.heartbeat_interval_ms - static_cast<int>(rtt_ns / 1000000));
+    }
+
     std::vector<std::string> filter_tokens_from_csv(const std::string& filename) {
         std::vector<std::string> tokens;
         std::ifstream file(filename);
@@ -341,134 +616,59 @@ private:
         }
 
         // Log the total number of tokens read from the file
-        log_event("Total tokens read from " + filename + ": " + std::to_string(tokens.size()));
+        log_event("Total tokens read from {}: {}", filename, tokens.size());
 
         return tokens;
     }
 
-    void log_event(const std::string& message) {
-        std::time_t t = std::time(nullptr);
-        std::tm tm = *std::localtime(&t);
-
-        std::stringstream time_stream;
-        time_stream << std::put_time(&tm, "%Y-%m-%d %H:%M:%S");
-
-        auto now = std::chrono::system_clock::now();
-        auto now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()) % 1000;
-
-        std::stringstream timestamp;
-        timestamp << time_stream.str() << '.' << std::setfill('0') << std::setw(3) << now_ms.count();
-
-        std::string log_entry = "{\n\t\"Source\" : \"AO\",\n\t\"message\" : \"" + message + "\",\n\t\"time\" : \"" + timestamp.str() + "\"\n}\n";
-
-        // Add the log entry to the queue
-        {
-            std::lock_guard<std::mutex> lock(log_mutex_);
-            log_queue_.push(log_entry);
+    std::vector<std::string> shard_tokens(const std::vector<std::string>& tokens) const {
+        if (shard_count_ == 1) {
+            return tokens;
         }
-    }
-
-    void log_worker() {
-        while (true) {
-            std::string log_entry;
-            {
-                std::lock_guard<std::mutex> lock(log_mutex_);
-                if (log_queue_.empty()) {
-                    if (stop_logging_) {
-                        break;
-                    }
-                    continue;
-                }
-                log_entry = log_queue_.front();
-                log_queue_.pop();
-            }
-            if (json_log_file_.is_open()) {
-                json_log_file_ << log_entry;
-                json_log_file_.flush();  // Ensure it is written to the file immediately
+        std::vector<std::string> mine;
+        for (const auto& token : tokens) {
+            if (shard_of_token(token, shard_count_) == static_cast<size_t>(shard_)) {
+                mine.push_back(token);
             }
         }
+        return mine;
     }
 
-    void handle_reconnection() {
-        if (current_retry_attempt < MAX_RETRY_ATTEMPT) {
-            current_retry_attempt++;
-            
-            // Calculate delay using exponential backoff
-            int delay = RETRY_DELAY * std::pow(RETRY_MULTIPLIER, current_retry_attempt - 1);
-            
-            log_event("Attempting to reconnect. Attempt " + std::to_string(current_retry_attempt));
-            
-            // Sleep for the calculated delay
-            std::this_thread::sleep_for(std::chrono::seconds(delay));
-            
-            // Close existing connection
-            if (ws_client_.get_con_from_hdl(connection_hdl_)->get_state() 
-                != websocketpp::session::state::closed) {
-                ws_client_.close(connection_hdl_, 
-                    websocketpp::close::status::normal, "Reconnecting");
-            }
-            
-            // Attempt reconnection
-            connect();
-        } else {
-            log_event("Max retry attempts reached. Connection closed.");
-        }
-    }
-
-    void resubscribe() {
-        for (const auto& [correlation_id, sub_data] : subscription_state) {
-            json request;
-            request["correlationID"] = correlation_id;
-            request["action"] = 1;  // SUBSCRIBE_ACTION
-            request["params"]["mode"] = sub_data.mode;
-            
-            json token_list = json::array();
-            for (const auto& [exchange_type, tokens] : sub_data.token_list) {
-                json exchange_data;
-                exchange_data["exchangeType"] = exchange_type;
-                exchange_data["tokens"] = tokens;
-                token_list.push_back(exchange_data);
-            }
-            request["params"]["tokenList"] = token_list;
-
-            websocketpp::lib::error_code ec;
-            ws_client_.send(connection_hdl_, request.dump(), 
-                websocketpp::frame::opcode::text, ec);
-            
-            if (ec) {
-                log_event("Resubscription failed: " + ec.message());
-            } else {
-                log_event("Resubscribed to tokens for mode: " + 
-                    std::to_string(sub_data.mode));
-            }
+    // Names the network thread after its shard and pins it if a core was given
+    void pin_network_thread() {
+        char name[16];
+        std::snprintf(name, sizeof(name), "ws-shard-%d", shard_);
+        pthread_setname_np(pthread_self(), name);
+        if (cpu_ < 0) {
+            return;
+        }
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu_, &cpus);
+        int result = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (result != 0) {
+            log_event("Shard {} could not pin its network thread to cpu {}: {}", shard_, cpu_, std::strerror(result));
         }
     }
 
-    void start_heartbeat_monitor() {
-        heartbeat_active = true;
-        heartbeat_thread = std::thread([this]() {
-            while (heartbeat_active) {
-                websocketpp::lib::error_code ec;
-                ws_client_.ping(connection_hdl_, "ping", ec);
-                
-                if (ec) {
-                    log_event("Heartbeat failed: " + ec.message());
-                    handle_reconnection();
-                }
-                
-                std::this_thread::sleep_for(
-                    std::chrono::seconds(HEARTBEAT_INTERVAL));
-            }
-        });
-        heartbeat_thread.detach();
+    // Formatting happens on the event log's writer thread; see event_log.hpp
+    template <typename... Args>
+    void log_event(const char* format, const Args&... args) {
+        event_log_.write(format, args...);
     }
-    
-    void stop_heartbeat_monitor() {
-        heartbeat_active = false;
-        if (heartbeat_thread.joinable()) {
-            heartbeat_thread.join();
-        }
+};
+
+// Mirrors consumed ticks into the shared-memory bus for other processes
+class ShmBusSink : public TickSink {
+public:
+    explicit ShmBusSink(ShmBusPublisher& publisher) : publisher_(publisher) {}
+
+    void on_tick(const Tick& tick, int32_t instrument_index) override {
+        publisher_.publish(tick, instrument_index);
     }
+
+private:
+    ShmBusPublisher& publisher_;
 };
 
 std::map<std::string, std::string> parse_ini_file(const std::string& filename) {
@@ -501,24 +701,1014 @@ std::map<std::string, std::string> parse_env_file(const std::string& filename) {
     return config;
 }
 
-int main() {
-    // Pre-process CSV data into the global map
+// Builds SnapQuote frames for every known token, used when no capture is given
+std::vector<std::string> synthesize_frames(size_t count) {
+    std::vector<std::string> frames;
+    std::vector<uint32_t> tokens;
+    for (const auto& instrument : instrument_table.instruments()) {
+        tokens.push_back(instrument.token);
+    }
+    if (tokens.empty()) {
+        tokens.push_back(99919000);
+    }
+
+    Tick tick{};
+    tick.mode = MODE_SNAP_QUOTE;
+    char buffer[MAX_PACKET_SIZE];
+    for (size_t i = 0; i < count; ++i) {
+        tick.token = tokens[i % tokens.size()];
+        const Instrument* instrument = instrument_table.find(tick.token);
+        tick.exchange_type = instrument ? instrument->exchange_type : static_cast<uint8_t>(BSE_CM);
+        tick.sequence = static_cast<int64_t>(i);
+        tick.exchange_timestamp = 1734061500000 + static_cast<int64_t>(i);
+        tick.ltp = 8000000 + static_cast<int64_t>(i % 5000);
+        tick.volume = static_cast<int64_t>(i) * 10;
+        tick.open_interest = 100000 + static_cast<int64_t>(i % 777);
+        for (int level = 0; level < DEPTH_LEVELS; ++level) {
+            tick.bids[level] = DepthLevel{tick.ltp - 5 * (level + 1), 10 * (level + 1), level + 1, 0};
+            tick.asks[level] = DepthLevel{tick.ltp + 5 * (level + 1), 10 * (level + 1), level + 1, 0};
+        }
+        size_t size = encode_tick(tick, buffer);
+        frames.emplace_back(buffer, size);
+    }
+    return frames;
+}
+
+// Decode microbenchmark over a capture file (or synthetic SnapQuotes)
+int run_decode_benchmark(const std::string& capture_file) {
+    std::vector<std::string> frames;
+    if (!capture_file.empty()) {
+        if (!read_capture_file(capture_file, frames)) {
+            std::cerr << "Error opening capture file: " << capture_file << std::endl;
+            return 1;
+        }
+    } else {
+        frames = synthesize_frames(100000);
+    }
+    if (frames.empty()) {
+        std::cerr << "No frames to decode." << std::endl;
+        return 1;
+    }
+
+    const int rounds = 50;
+    uint64_t checksum = 0;
+    uint64_t decoded = 0;
+    Tick tick;
+
+    // Warm-up pass so page faults and cold caches are not measured
+    for (const auto& frame : frames) {
+        checksum += decode_tick(frame.data(), frame.size(), tick) ? tick.ltp : 0;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; ++round) {
+        for (const auto& frame : frames) {
+            if (decode_tick(frame.data(), frame.size(), tick)) {
+                checksum += static_cast<uint64_t>(tick.ltp) ^ tick.token;
+                ++decoded;
+            }
+        }
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    size_t total = frames.size() * rounds;
+    std::cout << "Frames: " << frames.size() << " x " << rounds << " rounds, decoded: " << decoded << std::endl;
+    std::cout << "Decode: " << std::fixed << std::setprecision(1) << elapsed / total << " ns/frame, "
+              << std::setprecision(0) << total / (elapsed / 1e9) << " frames/sec" << std::endl;
+    std::cout << "Checksum: " << checksum << std::endl;
+    return 0;
+}
+
+// Call-site cost of EventLog::write with a few arguments, from one or more threads
+int run_event_log_benchmark(size_t events, int threads) {
+    EventLogSettings settings;
+    settings.format = EventLogFormat::BINARY;
+    settings.path = "/dev/null";
+    settings.ring_capacity = 1 << 16;
+    EventLog event_log;
+    std::string error;
+    if (!event_log.start(settings, error)) {
+        std::cerr << "Event log: " << error << std::endl;
+        return 1;
+    }
+
+    std::vector<double> ns_per_event(threads);
+    std::vector<std::thread> writers;
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < threads; ++t) {
+        writers.emplace_back([&, t]() {
+            // About a million events a second per thread, in bursts well
+            // inside the ring, which is far above what the feed logs
+            const size_t burst = 1024;
+            double elapsed_ns = 0;
+            for (size_t done = 0; done < events; done += burst) {
+                auto burst_start = std::chrono::steady_clock::now();
+                for (size_t i = done; i < std::min(events, done + burst); ++i) {
+                    event_log.write("Bench event {} for token {} at {}", i, 99919000u, 1.5);
+                }
+                elapsed_ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - burst_start).count();
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            ns_per_event[t] = elapsed_ns / events;
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    event_log.stop();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    uint64_t dropped = event_log.dropped();
+
+    double total = 0;
+    for (double value : ns_per_event) {
+        total += value;
+    }
+    uint64_t written = events * threads - dropped;
+    std::cout << "Event log: " << events << " events x " << threads << " threads, "
+              << std::fixed << std::setprecision(1) << total / threads << " ns/event at the call site, "
+              << written / seconds / 1e6 << "M events/s written, "
+              << dropped << " dropped" << std::endl;
+    return 0;
+}
+
+// Batch IV and Greeks over a synthetic SENSEX-like chain priced at known
+// volatilities, checked against the scalar reference
+int run_greeks_benchmark(size_t contracts) {
+    const double rate = 0.065;
+    std::vector<double> spot(contracts, 80000.0), strike(contracts), years(contracts), sign(contracts), price(contracts);
+    std::vector<double> vol(contracts), iv(contracts), delta(contracts), gamma(contracts), vega(contracts), theta(contracts);
+    uint64_t seed = 88172645463325252ull;
+    auto uniform = [&seed]() {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        return (seed >> 11) * (1.0 / 9007199254740992.0);
+    };
+    for (size_t i = 0; i < contracts; ++i) {
+        strike[i] = std::round(spot[i] * (0.85 + 0.3 * uniform()) / 100) * 100;
+        years[i] = (0.2 + 40 * uniform()) / BS_DAYS_PER_YEAR;
+        sign[i] = uniform() < 0.5 ? 1.0 : -1.0;
+        vol[i] = 0.08 + 0.5 * uniform();
+        price[i] = bs_scalar(spot[i], strike[i], years[i], sign[i], vol[i], rate).price;
+    }
+
+    BsInputs in{spot.data(), strike.data(), years.data(), sign.data(), price.data()};
+    BsOutputs out{iv.data(), delta.data(), gamma.data(), vega.data(), theta.data()};
+    const int rounds = 20;
+    size_t failed = bs_solve_batch(in, out, contracts, rate);
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; ++round) {
+        failed = bs_solve_batch(in, out, contracts, rate);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Only prices with a tick of time value say anything about volatility
+    double iv_error = 0, delta_error = 0, vega_error = 0;
+    size_t checked = 0;
+    for (size_t i = 0; i < contracts; ++i) {
+        double intrinsic = std::max(sign[i] * (spot[i] - strike[i] * std::exp(-rate * years[i])), 0.0);
+        if (std::isnan(iv[i]) || price[i] - intrinsic < 0.05) {
+            continue;
+        }
+        BsScalarResult reference = bs_scalar(spot[i], strike[i], years[i], sign[i], vol[i], rate);
+        iv_error = std::max(iv_error, std::fabs(iv[i] - vol[i]));
+        delta_error = std::max(delta_error, std::fabs(delta[i] - reference.delta));
+        vega_error = std::max(vega_error, std::fabs(vega[i] - reference.vega));
+        ++checked;
+    }
+    std::cout << "Greeks: " << contracts << " contracts x " << rounds << " rounds, " << failed << " without IV" << std::endl;
+    std::cout << "Solve: " << std::fixed << std::setprecision(0) << contracts * rounds / seconds << " contracts/sec, "
+              << std::setprecision(1) << seconds * 1e9 / (contracts * rounds) << " ns/contract" << std::endl;
+    std::cout << "Max error over " << checked << " with time value: " << std::scientific << std::setprecision(2)
+              << "iv " << iv_error << ", delta " << delta_error << ", vega " << vega_error << std::endl;
+    return 0;
+}
+
+// Produces synthetic ticks and bars through KafkaSink and checks that every
+// message is acknowledged by the broker. Without brokers, librdkafka's
+// built-in mock cluster stands in for one. The linger is far longer than the
+// run, so most messages are still queued when stop() is called and are only
+// delivered by its flush.
+int run_kafka_check(size_t count, const std::string& brokers) {
+    KafkaSettings settings;
+    settings.brokers = brokers;
+    settings.tick_topic = "bse.ticks.check";
+    settings.bar_topic = "bse.bars.check";
+    settings.linger_ms = "2000";
+    settings.stats_interval_s = 0;
+    if (brokers.empty()) {
+        settings.extra_properties.emplace_back("test.mock.num.brokers", "1");
+    }
+
+    std::vector<std::string> frames = synthesize_frames(count);
+    KafkaSink sink;
+    std::string error;
+    if (!sink.start(settings, error)) {
+        std::cerr << "Kafka producer failed to start: " << error << std::endl;
+        return 1;
+    }
+
+    Tick tick;
+    size_t bars = 0;
+    for (const auto& frame : frames) {
+        if (!decode_tick(frame.data(), frame.size(), tick)) {
+            continue;
+        }
+        sink.on_tick(tick, -1);
+        if (tick.sequence % 100 == 0) {
+            Bar bar{};
+            bar.token = tick.token;
+            bar.interval_s = 60;
+            bar.start_ms = tick.exchange_timestamp;
+            bar.open = bar.high = bar.low = bar.close = tick.ltp;
+            sink.on_bar(bar, -1);
+            ++bars;
+        }
+    }
+    int undelivered = sink.stop();
+
+    bool passed = undelivered == 0;
+    const size_t expected[] = {frames.size(), bars};
+    for (size_t i = 0; i < sink.topics().size(); ++i) {
+        const KafkaTopicStats& stats = *sink.topics()[i];
+        passed = passed && stats.produced == expected[i] && stats.delivered == expected[i]
+            && stats.delivery_failed == 0 && stats.queue_full == 0 && stats.produce_errors == 0;
+    }
+    std::cout << "Kafka check " << (passed ? "passed" : "FAILED") << ": " << frames.size() << " ticks and "
+              << bars << " bars to " << (brokers.empty() ? "the mock cluster" : brokers) << std::endl;
+    return passed ? 0 : 1;
+}
+
+// Measures how long consumed ticks waited after being handed to the pipeline
+class ReplayLatencySink : public TickSink {
+public:
+    void on_tick(const Tick& tick, int32_t instrument_index) override {
+        uint64_t latency = static_cast<uint64_t>(steady_now_ns() - tick.receive_ns);
+        latency_sum_ns_.fetch_add(latency, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        if (latency > latency_max_ns_.load(std::memory_order_relaxed)) {
+            latency_max_ns_.store(latency, std::memory_order_relaxed);
+        }
+    }
+
+    uint64_t count() const { return count_.load(); }
+    double average_us() const { return count_.load() ? latency_sum_ns_.load() / 1e3 / count_.load() : 0.0; }
+    double max_us() const { return latency_max_ns_.load() / 1e3; }
+
+private:
+    std::atomic<uint64_t> latency_sum_ns_{0};
+    std::atomic<uint64_t> latency_max_ns_{0};
+    std::atomic<uint64_t> count_{0};
+};
+
+// Client side of a load test against the local mock stream, which stamps its
+// wall-clock send time into last_traded_timestamp. Reports throughput and
+// latency percentiles every interval: end to end (mock send to consumer) and
+// in-process (socket receipt to consumer).
+class LoadReportSink : public TickSink {
+public:
+    ~LoadReportSink() override {
+        stop();
+    }
+
+    void on_tick(const Tick& tick, int32_t instrument_index) override {
+        int64_t now_ns = steady_now_ns();
+        end_to_end_.record(wall_now_ns() - tick.last_traded_timestamp);
+        pipeline_.record(now_ns - tick.receive_ns);
+    }
+
+    void start(int interval_s, const TickDispatcher& dispatcher) {
+        running_ = true;
+        report_thread_ = std::thread([this, interval_s, &dispatcher]() {
+            LatencyHistogram::Snapshot last_end_to_end = end_to_end_.snapshot();
+            LatencyHistogram::Snapshot last_pipeline = pipeline_.snapshot();
+            uint64_t last_dropped = dispatcher.dropped();
+            auto last = std::chrono::steady_clock::now();
+            while (running_.load()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                auto now = std::chrono::steady_clock::now();
+                double elapsed = std::chrono::duration<double>(now - last).count();
+                if (elapsed < interval_s) {
+                    continue;
+                }
+                LatencyHistogram::Snapshot end_to_end = end_to_end_.snapshot();
+                LatencyHistogram::Snapshot pipeline = pipeline_.snapshot();
+                LatencyHistogram::Snapshot interval = end_to_end.since(last_end_to_end);
+                uint64_t dropped = dispatcher.dropped();
+                std::cout << std::fixed << std::setprecision(0)
+                          << "Load: " << interval.total / elapsed << " msg/s, ring drops " << dropped - last_dropped << std::endl
+                          << "  end to end: " << interval.summary() << std::endl
+                          << "  in process: " << pipeline.since(last_pipeline).summary() << std::endl;
+                last_end_to_end = end_to_end;
+                last_pipeline = pipeline;
+                last_dropped = dropped;
+                last = now;
+            }
+            std::cout << "Load total end to end: " << end_to_end_.snapshot().summary() << std::endl
+                      << "Load total in process: " << pipeline_.snapshot().summary() << std::endl;
+        });
+    }
+
+    void stop() {
+        if (running_.exchange(false)) {
+            report_thread_.join();
+        }
+    }
+
+private:
+    LatencyHistogram end_to_end_;
+    LatencyHistogram pipeline_;
+    std::thread report_thread_;
+    std::atomic<bool> running_{false};
+};
+
+struct ReplayFrame {
+    const char* data;
+    size_t size;
+};
+
+// Replays a capture or journal through FrameProcessor. Frames keep their
+// recorded order; with a speed above zero they are paced by exchange
+// timestamp (speed 1 = real time), otherwise fed as fast as possible.
+int run_replay(const std::string& filename, double speed, FrameProcessor& frame_processor, ReplayLatencySink& latency_sink) {
+    std::vector<std::string> capture;
+    TickJournalReader journal;
+    std::vector<ReplayFrame> frames;
+
+    bool is_journal = filename.size() > 3 && filename.compare(filename.size() - 3, 3, ".tj") == 0;
+    if (is_journal) {
+        std::string error;
+        if (!journal.open(filename, error)) {
+            std::cerr << "Error opening journal: " << error << std::endl;
+            return 1;
+        }
+        TickJournalReader::Record record;
+        while (journal.next(record)) {
+            if (record.header->type == JOURNAL_RECORD_TICK) {
+                frames.push_back(ReplayFrame{record.payload, record.header->payload_size});
+            }
+        }
+    } else {
+        if (!read_capture_file(filename, capture)) {
+            std::cerr << "Error opening capture file: " << filename << std::endl;
+            return 1;
+        }
+        for (const auto& frame : capture) {
+            frames.push_back(ReplayFrame{frame.data(), frame.size()});
+        }
+    }
+    std::cout << "Replaying " << frames.size() << " frames from " << filename
+              << (speed > 0 ? " at " + std::to_string(speed) + "x" : std::string(" as fast as possible")) << std::endl;
+
+    FrameProcessor::StageTimes stage_times;
+    frame_processor.enable_stage_times(&stage_times);
+
+    int64_t first_exchange_ms = -1;
+    auto start = std::chrono::steady_clock::now();
+    for (const auto& frame : frames) {
+        if (speed > 0 && frame.size >= 43) {
+            int64_t exchange_ms = load_le<int64_t>(frame.data + 35);
+            if (first_exchange_ms < 0) {
+                first_exchange_ms = exchange_ms;
+            }
+            auto due = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double, std::milli>((exchange_ms - first_exchange_ms) / speed));
+            if (due > std::chrono::steady_clock::now()) {
+                std::this_thread::sleep_until(due);
+            }
+        }
+        frame_processor.process(frame.data, frame.size, steady_now_ns());
+    }
+    auto fed = std::chrono::steady_clock::now();
+
+    // Let the consumers drain before reporting
+    TickDispatcher& dispatcher = frame_processor.dispatcher();
+    while (dispatcher.consumed() + dispatcher.dropped() < dispatcher.published()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    auto drained = std::chrono::steady_clock::now();
+    frame_processor.enable_stage_times(nullptr);
+
+    double feed_s = std::chrono::duration<double>(fed - start).count();
+    double total_s = std::chrono::duration<double>(drained - start).count();
+    uint64_t published = stage_times.frames;
+    std::cout << std::fixed << std::setprecision(1)
+              << "Frames: " << frames.size() << ", published: " << published
+              << ", decode errors: " << frame_processor.decode_errors()
+              << ", unknown tokens: " << frame_processor.unknown_tokens()
+              << ", ring drops: " << dispatcher.dropped() << std::endl
+              << "Sustained: " << (total_s > 0 ? published / total_s : 0.0) << " msg/s end to end, "
+              << (feed_s > 0 ? frames.size() / feed_s : 0.0) << " msg/s fed" << std::endl
+              << "Decode: " << (published ? static_cast<double>(stage_times.decode_ns) / published : 0.0) << " ns/msg, "
+              << "publish: " << (published ? static_cast<double>(stage_times.publish_ns) / published : 0.0) << " ns/msg, "
+              << "consumer latency: avg " << latency_sink.average_us() << " us, max " << latency_sink.max_us() << " us" << std::endl;
+    return 0;
+}
+
+// Everything the metrics endpoint reports; runs on the metrics thread
+void collect_ws_metrics(MetricsSnapshot& out, const std::vector<std::unique_ptr<FrameProcessor>>& frame_processors,
+                        const std::vector<std::unique_ptr<WebSocketClient>>& ws_clients, const StageLatencySink& stage_latency,
+                        const EventLog& event_log, const StrikeWindow& strike_window, const SnapshotRecovery* recovery,
+                        const BarEngine& bar_engine, const GreeksEngine& greeks_engine, const OptionChainBook* option_chains) {
+    MetricFamily& messages = out.counter("ws_messages_total", "Binary frames received, by shard and exchange type", true);
+    MetricFamily& bytes = out.counter("ws_bytes_total", "Binary frame bytes received, by shard and exchange type", true);
+    MetricFamily& ticks_decoded = out.counter("ws_ticks_decoded_total", "Frames decoded into ticks", true);
+    MetricFamily& decode_errors = out.counter("ws_decode_errors_total", "Frames that failed to decode");
+    MetricFamily& unknown_tokens = out.counter("ws_unknown_tokens_total", "Decoded ticks for tokens missing from the instrument table");
+    MetricFamily& sequence_gaps = out.counter("ws_sequence_gaps_total", "Ticks whose sequence number showed a gap in the token's stream");
+    for (size_t shard = 0; shard < frame_processors.size(); ++shard) {
+        FrameProcessor& frame_processor = *frame_processors[shard];
+        std::string shard_label = metric_label("shard", std::to_string(shard));
+        for (size_t slot = 0; slot < FrameProcessor::EXCHANGE_TYPE_SLOTS; ++slot) {
+            if (frame_processor.messages(slot) == 0) {
+                continue;
+            }
+            std::string labels = shard_label + "," + metric_label("exchange_type", slot == 0 ? "other" : std::to_string(slot));
+            messages.add(labels, frame_processor.messages(slot));
+            bytes.add(labels, frame_processor.bytes(slot));
+        }
+        ticks_decoded.add(shard_label, frame_processor.ticks_decoded());
+        decode_errors.add(shard_label, frame_processor.decode_errors());
+        unknown_tokens.add(shard_label, frame_processor.unknown_tokens());
+        sequence_gaps.add(shard_label, frame_processor.sequence_gaps());
+    }
+
+    // A token is only ever received by the shard it hashes to
+    MetricFamily& token_ticks = out.counter("ws_token_ticks_total", "Ticks published per instrument");
+    const auto& instruments = instrument_table.instruments();
+    for (size_t i = 0; i < instruments.size(); ++i) {
+        uint64_t ticks = 0;
+        for (const auto& frame_processor : frame_processors) {
+            ticks += frame_processor->token_ticks(static_cast<int32_t>(i));
+        }
+        token_ticks.add(metric_label("token", std::to_string(instruments[i].token)) + "," + metric_label("symbol", instruments[i].symbol), ticks);
+    }
+
+    TickDispatcher& dispatcher = frame_processors.front()->dispatcher();
+    out.gauge("ws_ring_occupancy", "Ticks waiting in the consumer rings").add(dispatcher.occupancy());
+    out.gauge("ws_ring_capacity", "Total capacity of the consumer rings").add(dispatcher.ring_capacity() * dispatcher.consumer_count());
+    out.counter("ws_ring_published_total", "Ticks published to the consumer rings", true).add(dispatcher.published());
+    out.counter("ws_ring_dropped_total", "Ticks dropped by full consumer rings").add(dispatcher.dropped());
+    out.counter("ws_ring_consumed_total", "Ticks handed to the sinks").add(dispatcher.consumed());
+
+    MetricFamily& connected = out.gauge("ws_connected", "1 while the shard's websocket is open");
+    MetricFamily& state = out.gauge("ws_connection_state", "Shard connection state: 0 disconnected, 1 connecting, 2 open, 3 backoff");
+    MetricFamily& last_recovery = out.gauge("ws_last_recovery_seconds", "Time from the shard's last drop until it reopened");
+    MetricFamily& reconnects = out.counter("ws_reconnects_total", "Reconnection attempts");
+    MetricFamily& retry_attempt = out.gauge("ws_retry_attempt", "Current reconnection attempt, 0 once connected");
+    MetricFamily& desired = out.gauge("ws_subscriptions_desired", "Tokens the shard wants subscribed");
+    MetricFamily& acknowledged = out.gauge("ws_subscriptions_acknowledged", "Tokens subscribed on the shard's current connection");
+    MetricFamily& last_rtt = out.gauge("ws_ping_rtt_seconds", "Round trip of the last answered ping");
+    std::vector<LatencyHistogram::Snapshot> ping_rtts;
+    std::vector<LatencyHistogram::Snapshot> recoveries;
+    for (const auto& ws_client : ws_clients) {
+        std::string shard_label = metric_label("shard", std::to_string(ws_client->shard()));
+        connected.add(shard_label, ws_client->connected() ? 1 : 0);
+        state.add(shard_label, static_cast<int>(ws_client->state()));
+        int64_t last_recovery_ns = ws_client->last_recovery_ns();
+        if (last_recovery_ns >= 0) {
+            last_recovery.add(shard_label, last_recovery_ns / 1e9);
+        }
+        reconnects.add(shard_label, ws_client->reconnects());
+        retry_attempt.add(shard_label, ws_client->retry_attempt());
+        desired.add(shard_label, ws_client->subscriptions().desired_count());
+        acknowledged.add(shard_label, ws_client->subscriptions().acknowledged_count());
+        int64_t last_rtt_ns = ws_client->last_ping_rtt_ns();
+        if (last_rtt_ns >= 0) {
+            last_rtt.add(shard_label, last_rtt_ns / 1e9);
+        }
+        ping_rtts.push_back(ws_client->ping_rtt());
+        recoveries.push_back(ws_client->recovery());
+    }
+
+    const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+    MetricFamily& ping_quantiles = out.gauge("ws_ping_rtt_quantile_seconds", "Ping round trip percentiles since start");
+    MetricFamily& recovery_quantiles = out.gauge("ws_recovery_quantile_seconds", "Time-to-recover percentiles over the shard's outages");
+    MetricFamily& stage_quantiles = out.gauge("ws_tick_latency_seconds", "Tick latency percentiles per pipeline stage since start");
+    for (double quantile : quantiles) {
+        char quantile_text[16];
+        std::snprintf(quantile_text, sizeof(quantile_text), "%g", quantile);
+        std::string label = metric_label("quantile", quantile_text);
+        for (size_t shard = 0; shard < ping_rtts.size(); ++shard) {
+            if (ping_rtts[shard].total > 0) {
+                ping_quantiles.add(metric_label("shard", std::to_string(shard)) + "," + label, ping_rtts[shard].percentile(quantile * 100) / 1e9);
+            }
+            if (recoveries[shard].total > 0) {
+                recovery_quantiles.add(metric_label("shard", std::to_string(shard)) + "," + label, recoveries[shard].percentile(quantile * 100) / 1e9);
+            }
+        }
+        for (int stage = 0; stage < TICK_STAGE_COUNT; ++stage) {
+            LatencyHistogram::Snapshot snap = stage_latency.snapshot(static_cast<TickStage>(stage));
+            if (snap.total > 0) {
+                stage_quantiles.add(metric_label("stage", tick_stage_name(stage)) + "," + label, snap.percentile(quantile * 100) / 1e9);
+            }
+        }
+    }
+
+    out.counter("ws_event_log_dropped_total", "Log events dropped by full rings").add(event_log.dropped());
+
+    if (recovery != nullptr) {
+        out.counter("ws_snapshot_requested_total", "Tokens queued for a REST snapshot").add(recovery->requested());
+        out.counter("ws_snapshot_recovered_total", "Snapshots published as ticks").add(recovery->recovered());
+        out.counter("ws_snapshot_superseded_total", "Snapshots dropped as older than the live stream").add(recovery->superseded());
+        out.counter("ws_snapshot_undated_total", "Snapshots dropped for a missing or unreadable exchFeedTime").add(recovery->undated());
+        out.counter("ws_snapshot_failed_total", "Tokens given up on after snapshot_timeout_ms").add(recovery->failed());
+        out.counter("ws_snapshot_http_requests_total", "Quote requests sent").add(recovery->http_requests());
+        out.gauge("ws_snapshot_pending", "Tokens waiting for a snapshot").add(recovery->pending());
+        LatencyHistogram::Snapshot recovery_time = recovery->recovery_time();
+        if (recovery_time.total > 0) {
+            MetricFamily& recovery_quantiles = out.gauge("ws_snapshot_latency_seconds", "Time from a snapshot request until its tick was published");
+            for (double quantile : quantiles) {
+                char quantile_text[16];
+                std::snprintf(quantile_text, sizeof(quantile_text), "%g", quantile);
+                recovery_quantiles.add(metric_label("quantile", quantile_text), recovery_time.percentile(quantile * 100) / 1e9);
+            }
+        }
+    }
+
+    if (bar_engine.enabled()) {
+        MetricFamily& bars_closed = out.counter("ws_bars_closed_total", "OHLCV bars closed, by interval");
+        for (size_t i = 0; i < bar_engine.interval_count(); ++i) {
+            bars_closed.add(metric_label("interval", std::to_string(bar_engine.interval_s(i)) + "s"), bar_engine.bars_closed(i));
+        }
+        out.counter("ws_bar_late_ticks_total", "Ticks for bars that had already closed").add(bar_engine.late_ticks());
+        out.counter("ws_bar_out_of_session_ticks_total", "Ticks outside the 09:15-15:30 session or on a holiday").add(bar_engine.out_of_session_ticks());
+    }
+
+    if (greeks_engine.enabled()) {
+        out.gauge("ws_greeks_contracts", "Options with an index to solve against").add(greeks_engine.contracts());
+        out.counter("ws_greeks_passes_total", "Greeks passes run").add(greeks_engine.passes());
+        out.counter("ws_greeks_solved_total", "Options re-solved because their price or index moved").add(greeks_engine.solved());
+        out.counter("ws_greeks_failed_total", "Options whose price had no implied volatility").add(greeks_engine.failed());
+        out.gauge("ws_greeks_pass_seconds", "Duration of the last Greeks pass").add(greeks_engine.last_pass_ns() / 1e9);
+    }
+
+    if (option_chains) {
+        MetricFamily& pcr_oi = out.gauge("ws_chain_pcr_oi", "Put/call ratio by open interest");
+        MetricFamily& pcr_volume = out.gauge("ws_chain_pcr_volume", "Put/call ratio by day volume");
+        MetricFamily& open_interest = out.gauge("ws_chain_open_interest", "Open interest across the chain, by side");
+        MetricFamily& oi_change = out.gauge("ws_chain_oi_change", "Open interest change since the previous close, by side");
+        MetricFamily& max_pain = out.gauge("ws_chain_max_pain_strike", "Strike with the least payout to option holders, 0 without OI");
+        MetricFamily& straddle = out.gauge("ws_chain_atm_straddle", "ATM CE + PE last price in rupees, 0 before the first index tick");
+        for (size_t i = 0; i < option_chains->chain_count(); ++i) {
+            ChainSummary chain = option_chains->summary(i);
+            std::string label = metric_label("underlying", chain.name) + "," + metric_label("expiry", std::to_string(chain.expiry));
+            pcr_oi.add(label, chain.pcr_oi);
+            pcr_volume.add(label, chain.pcr_volume);
+            open_interest.add(label + "," + metric_label("side", "call"), chain.call_oi);
+            open_interest.add(label + "," + metric_label("side", "put"), chain.put_oi);
+            oi_change.add(label + "," + metric_label("side", "call"), chain.call_oi_change);
+            oi_change.add(label + "," + metric_label("side", "put"), chain.put_oi_change);
+            max_pain.add(label, chain.max_pain);
+            straddle.add(label, chain.atm_straddle);
+        }
+    }
+
+    if (strike_window.enabled()) {
+        MetricFamily& index_price = out.gauge("ws_strike_window_index_price", "Last index price driving the strike window");
+        MetricFamily& atm = out.gauge("ws_strike_window_atm_strike", "Strike the window is centred on, 0 before the first index tick");
+        MetricFamily& window_tokens = out.gauge("ws_strike_window_tokens", "Option tokens inside the strike window");
+        MetricFamily& recentres = out.counter("ws_strike_window_recentres_total", "Times the strike window moved");
+        for (const auto& status : strike_window.status()) {
+            std::string label = metric_label("index", status.name);
+            index_price.add(label, status.index_price);
+            atm.add(label, status.atm_strike);
+            window_tokens.add(label, status.window_tokens);
+            recentres.add(label, status.recentres);
+        }
+    }
+}
+
+std::string get_setting(const std::map<std::string, std::string>& settings, const std::string& key, const std::string& default_value) {
+    auto it = settings.find(key);
+    return it == settings.end() || it->second.empty() ? default_value : it->second;
+}
+
+// "2,3,5" -> {2, 3, 5}; anything that is not a non-negative number is skipped
+std::vector<int> parse_int_list(const std::string& text) {
+    std::vector<int> cpus;
+    std::istringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        char* end = nullptr;
+        long cpu = std::strtol(item.c_str(), &end, 10);
+        if (end != item.c_str() && cpu >= 0) {
+            cpus.push_back(static_cast<int>(cpu));
+        }
+    }
+    return cpus;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 2 && std::string(argv[1]) == "--decode-log") {
+        return decode_event_log(argv[2], std::cout) ? 0 : 1;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-log") {
+        size_t events = argc > 2 ? std::stoul(argv[2]) : 1000000;
+        int threads = argc > 3 ? std::stoi(argv[3]) : 1;
+        return run_event_log_benchmark(events, std::max(1, threads));
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-greeks") {
+        return run_greeks_benchmark(argc > 2 ? std::stoul(argv[2]) : 100000);
+    }
+
+    // Pre-process CSV data into the global instrument table
     preprocess_csv_data();
 
-    // Read credentials from config files
-    auto auth_config = parse_ini_file("config/AuthTokens.ini");
-    auto env_config = parse_env_file("config/Credentials.env");
+    if (argc > 1 && std::string(argv[1]) == "--bench-decode") {
+        return run_decode_benchmark(argc > 2 ? argv[2] : "");
+    }
+    if (argc > 1 && std::string(argv[1]) == "--check-kafka") {
+        return run_kafka_check(argc > 2 ? std::stoul(argv[2]) : 100000, argc > 3 ? argv[3] : "");
+    }
+    if (argc > 2 && std::string(argv[1]) == "--write-capture") {
+        size_t count = argc > 3 ? std::stoul(argv[3]) : 100000;
+        return write_capture_file(argv[2], synthesize_frames(count)) ? 0 : 1;
+    }
+
+    std::string replay_file;
+    double replay_speed = 0;
+    std::string endpoint_override;
+    int load_report_interval = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--replay" && i + 1 < argc) {
+            replay_file = argv[++i];
+        } else if (arg == "--speed" && i + 1 < argc) {
+            std::string value = argv[++i];
+            replay_speed = value == "max" ? 0 : std::stod(value);
+        } else if (arg == "--endpoint" && i + 1 < argc) {
+            endpoint_override = argv[++i];
+        } else if (arg == "--load-report" && i + 1 < argc) {
+            load_report_interval = std::stoi(argv[++i]);
+        }
+    }
+    bool replaying = !replay_file.empty();
+
+    // A live session ends on SIGINT/SIGTERM. They are blocked here, before any
+    // thread starts, and taken by one thread below so reports are written first.
+    sigset_t shutdown_signals;
+    sigemptyset(&shutdown_signals);
+    sigaddset(&shutdown_signals, SIGINT);
+    sigaddset(&shutdown_signals, SIGTERM);
+    if (!replaying) {
+        pthread_sigmask(SIG_BLOCK, &shutdown_signals, nullptr);
+    }
+
+    // Start the consumer side of the tick pipeline. Replay never drops ticks,
+    // so two runs over the same input produce the same output.
+    auto ws_settings = parse_ini_file("config/settings/Websocket.ini");
+    TickDispatcherSettings dispatcher_settings;
+    dispatcher_settings.ring_capacity = std::stoul(get_setting(ws_settings, "ring_capacity", "65536"));
+    dispatcher_settings.consumer_threads = std::stoul(get_setting(ws_settings, "consumer_threads", "1"));
+    dispatcher_settings.overflow = replaying ? OverflowPolicy::BLOCK : parse_overflow_policy(get_setting(ws_settings, "ring_overflow", "drop_oldest"));
+    TickDispatcher dispatcher(dispatcher_settings);
+
+    // One connection per shard, each decoding on its own network thread into
+    // the shared consumer rings. Replay reads a single capture.
+    size_t shard_count = replaying ? 1 : std::max(1, std::stoi(get_setting(ws_settings, "shards", "1")));
+    std::vector<int> shard_cpus = parse_int_list(get_setting(ws_settings, "shard_cpus", ""));
+    std::vector<std::unique_ptr<FrameProcessor>> frame_processors;
+    for (size_t shard = 0; shard < shard_count; ++shard) {
+        frame_processors.emplace_back(new FrameProcessor(dispatcher));
+    }
 
-    std::string auth_token = auth_config["AuthToken"];
-    std::string feed_token = auth_config["feedToken"];
+    // Per-stage latency; registered first so consumer time is taken at dequeue
+    StageLatencySink stage_latency(dispatcher, !replaying);
+    dispatcher.add_sink(&stage_latency);
+    stage_latency.start(replaying ? 0 : std::stoi(get_setting(ws_settings, "latency_report_interval", "60")));
+
+    // Optional shared-memory publisher, one latest-quote slot per instrument.
+    // A replay never publishes: the bus and Kafka topics are the live feed's.
+    ShmBusPublisher shm_publisher;
+    ShmBusSink shm_sink(shm_publisher);
+    std::string shm_name = get_setting(ws_settings, "shm_bus", "");
+    if (!shm_name.empty() && !replaying) {
+        std::vector<uint32_t> tokens;
+        for (const auto& instrument : instrument_table.instruments()) {
+            tokens.push_back(instrument.token);
+        }
+        std::string error;
+        size_t shm_ring_capacity = std::stoul(get_setting(ws_settings, "shm_ring_capacity", "65536"));
+        if (shm_publisher.create(shm_name, tokens, shm_ring_capacity, error)) {
+            dispatcher.add_sink(&shm_sink);
+            std::cout << "Shared-memory bus " << shm_name << ": " << shm_publisher.size_bytes() << " bytes" << std::endl;
+        } else {
+            std::cerr << "Shared-memory bus disabled: " << error << std::endl;
+        }
+    }
+
+    // Optional Kafka producer for the decoded stream
+    KafkaSink kafka_sink;
+    KafkaSettings kafka_settings;
+    kafka_settings.brokers = get_setting(ws_settings, "kafka_brokers", "");
+    if (!kafka_settings.brokers.empty() && !replaying) {
+        kafka_settings.tick_topic = get_setting(ws_settings, "kafka_topic", kafka_settings.tick_topic);
+        kafka_settings.bar_topic = get_setting(ws_settings, "kafka_bar_topic", "");
+        kafka_settings.linger_ms = get_setting(ws_settings, "kafka_linger_ms", kafka_settings.linger_ms);
+        kafka_settings.batch_size = get_setting(ws_settings, "kafka_batch_size", kafka_settings.batch_size);
+        kafka_settings.compression = get_setting(ws_settings, "kafka_compression", kafka_settings.compression);
+        kafka_settings.acks = get_setting(ws_settings, "kafka_acks", kafka_settings.acks);
+        kafka_settings.queue_max_messages = get_setting(ws_settings, "kafka_queue_max_messages", kafka_settings.queue_max_messages);
+        kafka_settings.stats_interval_s = std::stoi(get_setting(ws_settings, "kafka_stats_interval", "60"));
+
+        std::string error;
+        if (kafka_sink.start(kafka_settings, error)) {
+            dispatcher.add_sink(&kafka_sink);
+            std::cout << "Kafka producer started for topic " << kafka_settings.tick_topic << std::endl;
+        } else {
+            std::cerr << "Kafka producer disabled: " << error << std::endl;
+        }
+    }
+
+    // Optional binary journal of every consumed tick
+    std::unique_ptr<TickJournalWriter> journal;
+    std::string journal_dir = get_setting(ws_settings, "journal_dir", "");
+    if (!journal_dir.empty() && !replaying) {
+        size_t chunk_mb = std::stoul(get_setting(ws_settings, "journal_chunk_mb", "256"));
+        journal.reset(new TickJournalWriter(journal_dir, chunk_mb << 20));
+        dispatcher.add_sink(journal.get());
+        std::cout << "Journaling ticks to " << journal_dir << std::endl;
+    }
+
+    ReplayLatencySink replay_latency_sink;
+    if (replaying) {
+        dispatcher.add_sink(&replay_latency_sink);
+    }
+
+    // Subscriptions are sent as deltas against what each shard's connection already has
+    ShardedSubscriptions subscriptions(shard_count, std::stoul(get_setting(ws_settings, "subscription_batch", "1000")));
+    int subscription_mode = std::stoi(get_setting(ws_settings, "subscription_mode", std::to_string(MODE_SNAP_QUOTE)));
+
+    // Optional ATM strike window following the index ticks
+    StrikeWindowSettings strike_window_settings;
+    strike_window_settings.strikes = replaying ? 0 : std::stoi(get_setting(ws_settings, "strike_window", "0"));
+    strike_window_settings.hysteresis = std::stod(get_setting(ws_settings, "strike_window_hysteresis", "0.25"));
+    strike_window_settings.mode = subscription_mode;
+    // IST date as YYYYMMDD, comparable with Instrument::expiry whatever the host TZ
+    strike_window_settings.min_expiry = ist_date(wall_now_ns() / 1000000);
+    StrikeWindow strike_window(instrument_table, subscriptions, strike_window_settings);
+    if (strike_window.enabled()) {
+        dispatcher.add_sink(&strike_window);
+    }
+
+    // OHLCV bars on exchange time, published to the sinks above
+    TradingCalendar calendar;
+    if (!calendar.load("config/settings/Holiday.ini")) {
+        std::cerr << "No holiday calendar, bars only skip weekends" << std::endl;
+    }
+    BarEngineSettings bar_settings;
+    bar_settings.intervals_s = parse_int_list(get_setting(ws_settings, "bar_intervals", "1,60,300"));
+    bar_settings.grace_ms = std::stoll(get_setting(ws_settings, "bar_grace_ms", "500"));
+    bar_settings.wall_clock_close = !replaying;
+    BarEngine bar_engine(instrument_table, calendar, dispatcher, bar_settings);
+    if (bar_engine.enabled()) {
+        dispatcher.add_sink(&bar_engine);
+    }
+
+    // Strike-indexed CE/PE matrix per underlying and expiry
+    OptionChainBook option_chains(instrument_table);
+    bool option_chains_enabled = get_setting(ws_settings, "option_chains", "1") != "0" && option_chains.chain_count() > 0;
+    if (option_chains_enabled) {
+        dispatcher.add_sink(&option_chains);
+    }
+
+    // Implied volatility and Greeks for options whose index is subscribed
+    GreeksSettings greeks_settings;
+    greeks_settings.interval_ms = std::stoi(get_setting(ws_settings, "greeks_interval_ms", "0"));
+    greeks_settings.rate = std::stod(get_setting(ws_settings, "greeks_rate", "0.065"));
+    GreeksEngine greeks_engine(instrument_table, greeks_settings);
+    if (greeks_engine.enabled()) {
+        dispatcher.add_sink(&greeks_engine);
+        greeks_engine.start();
+    }
+
+    // Throughput and latency report when load testing against the mock stream
+    LoadReportSink load_report_sink;
+    if (load_report_interval > 0 && !replaying) {
+        dispatcher.add_sink(&load_report_sink);
+    }
+
+    dispatcher.start();
+
+    if (replaying) {
+        int result = run_replay(replay_file, replay_speed, *frame_processors.front(), replay_latency_sink);
+        dispatcher.stop();
+        if (bar_engine.enabled()) {
+            bar_engine.flush();
+            std::cout << "Bars closed:";
+            for (size_t i = 0; i < bar_engine.interval_count(); ++i) {
+                std::cout << " " << bar_engine.bars_closed(i) << " x " << bar_engine.interval_s(i) << "s";
+            }
+            std::cout << ", late ticks: " << bar_engine.late_ticks()
+                      << ", out of session: " << bar_engine.out_of_session_ticks() << std::endl;
+        }
+        if (greeks_engine.enabled()) {
+            greeks_engine.stop();
+            greeks_engine.pass(greeks_engine.exchange_clock_ms());
+            std::cout << "Greeks: " << greeks_engine.passes() << " passes over " << greeks_engine.contracts()
+                      << " options, " << greeks_engine.solved() << " solved, " << greeks_engine.failed() << " without IV" << std::endl;
+        }
+        for (size_t i = 0; option_chains_enabled && i < option_chains.chain_count(); ++i) {
+            ChainSummary chain = option_chains.summary(i);
+            std::cout << "Chain " << chain.name << " " << chain.expiry << ": " << chain.strikes << " strikes, PCR OI "
+                      << std::fixed << std::setprecision(2) << chain.pcr_oi << ", PCR volume " << chain.pcr_volume
+                      << ", max pain " << chain.max_pain << ", ATM " << chain.atm_strike << " straddle " << chain.atm_straddle
+                      << std::endl;
+        }
+        stage_latency.stop();
+        return result;
+    }
+
+    // Session tokens: reuse, refresh or log in the way bin/auth does, then
+    // keep them renewed so a reconnect never presents an expired JWT
+    auto env_config = parse_env_file("config/Credentials.env");
+    auto auth_settings_config = parse_ini_file("config/settings/Auth.ini");
+    AuthSettings auth_settings;
+    auth_settings.baseUrl = get_setting(auth_settings_config, "base_url", auth_settings.baseUrl);
+    auth_settings.refreshMarginS = std::stoi(get_setting(auth_settings_config, "refresh_margin_s", "3600"));
+    auth_settings.retryS = std::stoi(get_setting(auth_settings_config, "retry_s", "60"));
+    auth_settings.timeoutMs = std::stol(get_setting(auth_settings_config, "timeout_ms", "10000"));
+    TokenManager token_manager(auth_settings, env_config);
+    bool refreshing_tokens = get_setting(ws_settings, "token_refresh", "1") != "0";
+    if (refreshing_tokens) {
+        curl_global_init(CURL_GLOBAL_DEFAULT);
+        std::string error;
+        if (token_manager.ensureValid(error)) {
+            std::cout << "Session " << token_manager.lastAction() << std::endl;
+        } else {
+            std::cerr << "Session check failed, using " << auth_settings.tokenFile << " as is: " << error << std::endl;
+        }
+    }
+    SessionTokens session = refreshing_tokens ? token_manager.tokens() : TokenManager::readTokenFile(auth_settings.tokenFile);
+    // The bare JWT: the stream takes it as is, REST calls behind "Bearer "
+    std::string auth_token = TokenManager::stripBearer(session.jwtToken);
+    std::string feed_token = session.feedToken;
     std::string client_code = env_config["clientcode"];
     std::string api_key = env_config["API_KEY"];
 
-    // Initialize the WebSocket client
-    WebSocketClient ws_client(auth_token, api_key, client_code, feed_token);
+    std::string endpoint = endpoint_override.empty()
+        ? get_setting(ws_settings, "stream_url", "wss://smartapisocket.angelone.in/smart-stream")
+        : endpoint_override;
+    if (load_report_interval > 0) {
+        load_report_sink.start(load_report_interval, dispatcher);
+    }
+
+    // Event log: NDJSON lines in logs/controller.json, or binary records for ws --decode-log
+    EventLogSettings event_log_settings;
+    event_log_settings.format = parse_event_log_format(get_setting(ws_settings, "event_log", "ndjson"));
+    event_log_settings.path = get_setting(ws_settings, "event_log_path",
+        event_log_settings.format == EventLogFormat::BINARY ? "logs/ws_events.bin" : "logs/controller.json");
+    event_log_settings.ring_capacity = std::stoul(get_setting(ws_settings, "event_log_ring", "4096"));
+    event_log_settings.flush_interval_ms = std::stoi(get_setting(ws_settings, "event_log_flush_ms", "5"));
+    EventLog event_log;
+    std::string event_log_error;
+    if (!event_log.start(event_log_settings, event_log_error)) {
+        std::cerr << "Event log disabled: " << event_log_error << std::endl;
+    }
 
-    // Connect to the server
-    ws_client.connect();
+    std::thread([&]() {
+        int signal_number = 0;
+        sigwait(&shutdown_signals, &signal_number);
+        std::cout << "Shutting down on signal " << signal_number << std::endl;
+        // Drain the rings into the sinks first, close the bars still open,
+        // then let the sinks finish: Kafka flushes its queue, the journal
+        // commits and saves its index
+        dispatcher.stop();
+        if (bar_engine.enabled()) {
+            bar_engine.flush();
+        }
+        if (greeks_engine.enabled()) {
+            greeks_engine.stop();
+        }
+        kafka_sink.stop();
+        journal.reset();
+        load_report_sink.stop();
+        stage_latency.stop();
+        event_log.stop();
+        std::_Exit(0);
+    }).detach();
+
+    // Reconnect backoff and heartbeat timing, shared by every shard
+    ConnectionSettings connection_settings;
+    connection_settings.reconnect_initial_ms = std::stoi(get_setting(ws_settings, "reconnect_initial_ms", "100"));
+    connection_settings.reconnect_max_ms = std::stoi(get_setting(ws_settings, "reconnect_max_ms", "30000"));
+    connection_settings.heartbeat_interval_ms = std::stoi(get_setting(ws_settings, "heartbeat_interval_ms", "10000"));
+    connection_settings.pong_timeout_ms = std::stoi(get_setting(ws_settings, "pong_timeout_ms", "5000"));
+
+    // REST snapshots for tokens whose stream had a gap: everything a shard
+    // had subscribed when it dropped, and tokens whose sequence went back
+    SnapshotRecoverySettings recovery_settings;
+    recovery_settings.quote_url = get_setting(ws_settings, "snapshot_quote_url", recovery_settings.quote_url);
+    recovery_settings.batch_size = std::stoul(get_setting(ws_settings, "snapshot_batch", "50"));
+    recovery_settings.requests_per_second = std::stod(get_setting(ws_settings, "snapshot_rate", "10"));
+    recovery_settings.timeout_ms = std::stoi(get_setting(ws_settings, "snapshot_timeout_ms", "10000"));
+    int64_t max_sequence_jump = std::stoll(get_setting(ws_settings, "max_sequence_jump", "0"));
+    SnapshotRecovery snapshot_recovery(instrument_table, dispatcher, event_log);
+    bool recovering = get_setting(ws_settings, "snapshot_recovery", "1") != "0";
+    if (recovering) {
+        curl_global_init(CURL_GLOBAL_DEFAULT);
+        std::vector<std::string> headers = {
+            "Authorization: Bearer " + auth_token,
+            "X-PrivateKey: " + api_key,
+            "Accept: application/json",
+            "Content-Type: application/json",
+            "X-UserType: USER",
+            "X-SourceID: WEB",
+            "X-ClientLocalIP: CLIENT_LOCAL_IP",
+            "X-ClientPublicIP: CLIENT_PUBLIC_IP",
+            "X-MACAddress: MAC_ADDRESS"
+        };
+        std::string error;
+        if (!snapshot_recovery.start(recovery_settings, headers, error)) {
+            std::cerr << "Snapshot recovery disabled: " << error << std::endl;
+            recovering = false;
+        }
+    }
+    for (auto& frame_processor : frame_processors) {
+        frame_processor->set_recovery(recovering ? &snapshot_recovery : nullptr, max_sequence_jump);
+    }
+
+    // Initialize one WebSocket client per shard
+    std::vector<std::unique_ptr<WebSocketClient>> ws_clients;
+    for (size_t shard = 0; shard < shard_count; ++shard) {
+        ws_clients.emplace_back(new WebSocketClient(endpoint, auth_token, api_key, client_code, feed_token, *frame_processors[shard],
+                                                    event_log, subscriptions.shard(shard), connection_settings));
+        WebSocketClient& ws_client = *ws_clients.back();
+        ws_client.set_shard(static_cast<int>(shard), shard_count, shard_cpus.empty() ? -1 : shard_cpus[shard % shard_cpus.size()]);
+        ws_client.load_universe(subscription_mode);
+        ws_client.set_stage_latency(&stage_latency);
+        ws_client.set_snapshot_recovery(recovering ? &snapshot_recovery : nullptr);
+    }
+
+    if (refreshing_tokens) {
+        token_manager.setOnRenew([&](const SessionTokens& tokens) {
+            event_log.write("Session token renewed ({}), valid until {}", token_manager.lastAction(), tokens.expiresAt);
+            std::string jwt = TokenManager::stripBearer(tokens.jwtToken);
+            for (auto& ws_client : ws_clients) {
+                ws_client->set_tokens(jwt, tokens.feedToken);
+            }
+            if (recovering) {
+                snapshot_recovery.set_authorization("Authorization: Bearer " + jwt);
+            }
+        });
+        token_manager.start();
+    }
+
+    // The window's options wait for the first index tick to centre it
+    if (strike_window.enabled()) {
+        subscriptions.remove(subscription_mode, BSE_FO, strike_window.managed_tokens());
+        strike_window.set_on_recentre([&](const std::string& name, double atm_strike, size_t added, size_t removed) {
+            event_log.write("Strike window for {} centred on {}: {} tokens added, {} removed", name, atm_strike, added, removed);
+            for (auto& ws_client : ws_clients) {
+                ws_client->flush_subscriptions();
+            }
+        });
+        for (const auto& status : strike_window.status()) {
+            std::cout << "Strike window for " << status.name << ": +/-" << strike_window_settings.strikes << " of "
+                      << status.chain_strikes << " strikes, expiry " << status.expiry << std::endl;
+        }
+    }
+
+    // Optional Prometheus endpoint and/or snapshot file
+    MetricsSettings metrics_settings;
+    metrics_settings.port = std::stoi(get_setting(ws_settings, "metrics_port", "0"));
+    metrics_settings.bind_address = get_setting(ws_settings, "metrics_bind", metrics_settings.bind_address);
+    metrics_settings.file = get_setting(ws_settings, "metrics_file", "");
+    metrics_settings.interval_s = std::stoi(get_setting(ws_settings, "metrics_interval", "5"));
+    MetricsServer metrics_server;
+    if (metrics_settings.port > 0 || !metrics_settings.file.empty()) {
+        std::string error;
+        auto collector = [&](MetricsSnapshot& out) {
+            collect_ws_metrics(out, frame_processors, ws_clients, stage_latency, event_log, strike_window,
+                               recovering ? &snapshot_recovery : nullptr, bar_engine, greeks_engine,
+                               option_chains_enabled ? &option_chains : nullptr);
+        };
+        if (metrics_server.start(metrics_settings, collector, error)) {
+            if (metrics_settings.port > 0) {
+                std::cout << "Metrics on http://" << metrics_settings.bind_address << ":" << metrics_settings.port << "/metrics" << std::endl;
+            }
+        } else {
+            std::cerr << "Metrics disabled: " << error << std::endl;
+        }
+    }
+
+    if (shard_count > 1) {
+        for (size_t shard = 0; shard < shard_count; ++shard) {
+            std::cout << "Shard " << shard << ": " << subscriptions.shard(shard).desired_count() << " tokens" << std::endl;
+        }
+    }
+
+    // Connect every shard. Each shard's thread is its network thread and
+    // reconnects on its own timers without stalling the others.
+    std::vector<std::thread> shard_threads;
+    for (auto& ws_client : ws_clients) {
+        shard_threads.emplace_back([&ws_client]() { ws_client->connect(); });
+    }
+    for (auto& shard_thread : shard_threads) {
+        shard_thread.join();
+    }
+    token_manager.stop();
 
     return 0;
 }
\ No newline at end of file